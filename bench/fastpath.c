@@ -0,0 +1,357 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ***************************************************************************
+ * This file contains benchmark of the fast path against D-Bus round trips *
+ ***************************************************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dbus/dbus.h>
+
+#include <appdb/fastpath.h>
+
+#include "common.h"
+
+/* Looks up and searches applications of the running daemon, one call at a time with
+ * GetEntries and FuzzySearch on the session bus, then with LOOKUP and SEARCH requests on
+ * the fast path socket, WINDOW of them sent before reading the responses. The daemon is
+ * started by D-Bus activation if it is not running. */
+
+#define CALLS 10000
+#define WINDOW 32
+#define K 20
+#define TIMEOUT 5000            /* of D-Bus calls, in milliseconds */
+
+static DBusConnection * g_connection;
+static char ** g_names;
+static size_t g_names_count;
+static char g_queries[CALLS][4];
+static char g_buffer[APPDB_FASTPATH_MAX_PACKET];
+
+static double bench_now(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+static DBusMessage * bench_call(const char * method, int first_arg_type, ...)
+{
+  DBusMessage * request_ptr;
+  DBusMessage * reply_ptr;
+  DBusError error;
+  va_list ap;
+
+  request_ptr = dbus_message_new_method_call(APPDB_DBUS_SERVICE_NAME, APPDB_DBUS_OBJECT_PATH, APPDB_DBUS_IFACE, method);
+  if (request_ptr == NULL)
+  {
+    printf("dbus_message_new_method_call() failed\n");
+    return NULL;
+  }
+
+  va_start(ap, first_arg_type);
+  if (!dbus_message_append_args_valist(request_ptr, first_arg_type, ap))
+  {
+    va_end(ap);
+    printf("dbus_message_append_args_valist() failed\n");
+    dbus_message_unref(request_ptr);
+    return NULL;
+  }
+  va_end(ap);
+
+  dbus_error_init(&error);
+  reply_ptr = dbus_connection_send_with_reply_and_block(g_connection, request_ptr, TIMEOUT, &error);
+  dbus_message_unref(request_ptr);
+  if (reply_ptr == NULL)
+  {
+    printf("%s() failed: %s\n", method, error.message);
+    dbus_error_free(&error);
+    return NULL;
+  }
+
+  return reply_ptr;
+}
+
+static bool bench_wait_ready(void)
+{
+  DBusMessage * reply_ptr;
+  dbus_bool_t ready;
+  unsigned int i;
+
+  for (i = 0; i < 100; i++)
+  {
+    reply_ptr = bench_call("IsReady", DBUS_TYPE_INVALID);
+    if (reply_ptr == NULL)
+    {
+      return false;
+    }
+
+    if (!dbus_message_get_args(reply_ptr, NULL, DBUS_TYPE_BOOLEAN, &ready, DBUS_TYPE_INVALID))
+    {
+      ready = false;
+    }
+
+    dbus_message_unref(reply_ptr);
+
+    if (ready)
+    {
+      return true;
+    }
+
+    usleep(100000);
+  }
+
+  printf("database is not loaded in 10 seconds\n");
+  return false;
+}
+
+/* names of the applications and queries made of their ASCII letters, D-Bus needs valid UTF-8 */
+static bool bench_get_names(void)
+{
+  DBusMessage * reply_ptr;
+  const char * field;
+  char ** names;
+  int count;
+  size_t i;
+  size_t j;
+  size_t len;
+  char c;
+
+  field = "name";
+  reply_ptr = bench_call("GetSorted", DBUS_TYPE_STRING, &field, DBUS_TYPE_INVALID);
+  if (reply_ptr == NULL)
+  {
+    return false;
+  }
+
+  if (!dbus_message_get_args(reply_ptr, NULL, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names, &count, DBUS_TYPE_INVALID))
+  {
+    printf("invalid reply of GetSorted()\n");
+    dbus_message_unref(reply_ptr);
+    return false;
+  }
+
+  dbus_message_unref(reply_ptr);
+
+  if (count == 0)
+  {
+    printf("there are no applications\n");
+    dbus_free_string_array(names);
+    return false;
+  }
+
+  g_names = names;
+  g_names_count = count;
+
+  for (i = 0; i < CALLS; i++)
+  {
+    len = 0;
+    for (j = 0; g_names[i % g_names_count][j] != 0 && len < 3; j++)
+    {
+      c = g_names[i % g_names_count][j];
+      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+      {
+        g_queries[i][len++] = c;
+      }
+    }
+
+    if (len == 0)
+    {
+      g_queries[i][len++] = 'a';
+    }
+
+    g_queries[i][len] = 0;
+  }
+
+  return true;
+}
+
+static bool bench_dbus_lookup(size_t i)
+{
+  DBusMessage * reply_ptr;
+  const char * names[1];
+  const char ** names_ptr;
+
+  names[0] = g_names[i % g_names_count];
+  names_ptr = names;
+
+  reply_ptr = bench_call("GetEntries", DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names_ptr, 1, DBUS_TYPE_INVALID);
+  if (reply_ptr == NULL)
+  {
+    return false;
+  }
+
+  dbus_message_unref(reply_ptr);
+  return true;
+}
+
+static bool bench_dbus_search(size_t i)
+{
+  DBusMessage * reply_ptr;
+  const char * query;
+  dbus_uint32_t k;
+
+  query = g_queries[i];
+  k = K;
+
+  reply_ptr = bench_call("FuzzySearch", DBUS_TYPE_STRING, &query, DBUS_TYPE_UINT32, &k, DBUS_TYPE_INVALID);
+  if (reply_ptr == NULL)
+  {
+    return false;
+  }
+
+  dbus_message_unref(reply_ptr);
+  return true;
+}
+
+static bool bench_fastpath_send(int fd, uint16_t code, size_t i)
+{
+  if (code == APPDB_FASTPATH_LOOKUP)
+  {
+    return appdb_fastpath_lookup(fd, i, g_names[i % g_names_count]);
+  }
+
+  return appdb_fastpath_search(fd, i, g_queries[i], K);
+}
+
+static bool bench_fastpath_receive(int fd, size_t i)
+{
+  const struct appdb_fastpath_header * header_ptr;
+
+  if (!appdb_fastpath_receive(fd, g_buffer))
+  {
+    printf("receive of fast path response failed\n");
+    return false;
+  }
+
+  header_ptr = (const struct appdb_fastpath_header *)g_buffer;
+  if (header_ptr->id != i || header_ptr->code != APPDB_FASTPATH_OK)
+  {
+    printf("fast path response %u has code %u, expected %zu with code 0\n", header_ptr->id, header_ptr->code, i);
+    return false;
+  }
+
+  return true;
+}
+
+static bool bench_dbus(const char * name, bool (* call)(size_t i))
+{
+  double start;
+  size_t i;
+
+  start = bench_now();
+  for (i = 0; i < CALLS; i++)
+  {
+    if (!call(i))
+    {
+      return false;
+    }
+  }
+
+  printf("%-12s D-Bus:     %8.2f us per call\n", name, (bench_now() - start) / CALLS);
+  return true;
+}
+
+static bool bench_fastpath(const char * name, int fd, uint16_t code)
+{
+  double start;
+  size_t i;
+  size_t j;
+
+  start = bench_now();
+  for (i = 0; i < CALLS; i += WINDOW)
+  {
+    for (j = i; j < i + WINDOW && j < CALLS; j++)
+    {
+      if (!bench_fastpath_send(fd, code, j))
+      {
+        printf("send of fast path request failed\n");
+        return false;
+      }
+    }
+
+    for (j = i; j < i + WINDOW && j < CALLS; j++)
+    {
+      if (!bench_fastpath_receive(fd, j))
+      {
+        return false;
+      }
+    }
+  }
+
+  printf("%-12s fast path: %8.2f us per call, %u in flight\n", name, (bench_now() - start) / CALLS, WINDOW);
+  return true;
+}
+
+int main(void)
+{
+  DBusMessage * reply_ptr;
+  DBusError error;
+  const char * path;
+  int fd;
+  int ret;
+
+  ret = EXIT_FAILURE;
+  fd = -1;
+
+  dbus_error_init(&error);
+  g_connection = dbus_bus_get(DBUS_BUS_SESSION, &error);
+  if (g_connection == NULL)
+  {
+    printf("Cannot connect to D-Bus session bus: %s\n", error.message);
+    dbus_error_free(&error);
+    return EXIT_FAILURE;
+  }
+
+  if (!bench_wait_ready() || !bench_get_names())
+  {
+    goto unref_connection;
+  }
+
+  reply_ptr = bench_call("GetFastPathSocket", DBUS_TYPE_INVALID);
+  if (reply_ptr == NULL)
+  {
+    goto free_names;
+  }
+
+  if (dbus_message_get_args(reply_ptr, NULL, DBUS_TYPE_STRING, &path, DBUS_TYPE_INVALID) && path[0] != 0)
+  {
+    fd = appdb_fastpath_connect(path);
+  }
+
+  dbus_message_unref(reply_ptr);
+
+  if (fd == -1)
+  {
+    printf("fast path is not available\n");
+    goto free_names;
+  }
+
+  printf("%zu applications, %u calls of each method\n", g_names_count, CALLS);
+
+  if (bench_dbus("GetEntries", bench_dbus_lookup) &&
+      bench_fastpath("LOOKUP", fd, APPDB_FASTPATH_LOOKUP) &&
+      bench_dbus("FuzzySearch", bench_dbus_search) &&
+      bench_fastpath("SEARCH", fd, APPDB_FASTPATH_SEARCH))
+  {
+    ret = EXIT_SUCCESS;
+  }
+
+  close(fd);
+free_names:
+  dbus_free_string_array(g_names);
+unref_connection:
+  dbus_connection_unref(g_connection);
+  return ret;
+}
@@ -0,0 +1,342 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *****************************************************
+ * This file contains benchmark of the fuzzy matcher *
+ *****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <time.h>
+
+#include "common.h"
+#include "fuzzy.h"
+
+/* Searches synthetic names with the matcher of the daemon, checks the results against
+ * a brute force subsequence test and fails if median latency of a query exceeds the
+ * budget for the database size. The largest size is split to threads by the matcher. */
+
+#define QUERIES 1000
+#define K 20
+
+struct bench_size
+{
+  size_t count;
+  double budget_us;             /* median latency of a query */
+};
+
+static const struct bench_size g_sizes[] =
+{
+  {300, 50},
+  {3000, 250},
+  {30000, 2500},
+  {100000, 8000},
+};
+
+static const char * g_syllables[] =
+{
+  "ar", "dour", "in", "gen", "hy", "dro", "gen", "qtr", "ack", "jam", "in", "cal", "f", "mu", "se",
+  "au", "da", "ci", "ty", "lmms", "sy", "nth", "pa", "ter", "mi", "nal", "fi", "re", "fox", "é", "lan",
+  "kr", "ita", "gi", "mp", "ink", "sca", "pe", "vlc", "mpv", "ob", "s", "to", "tem", "Ö", "ko",
+};
+
+static uint64_t g_random = 88172645463325252ULL;
+
+static unsigned int bench_random(unsigned int limit)
+{
+  /* xorshift, so each run searches same names */
+  g_random ^= g_random << 13;
+  g_random ^= g_random >> 7;
+  g_random ^= g_random << 17;
+
+  return g_random % limit;
+}
+
+static char * bench_name(void)
+{
+  char name[128];
+  size_t len;
+  size_t word;
+  unsigned int words;
+  unsigned int syllables;
+  const char * syllable;
+
+  len = 0;
+  for (words = 1 + bench_random(3); words > 0; words--)
+  {
+    word = len;
+    for (syllables = 1 + bench_random(3); syllables > 0; syllables--)
+    {
+      syllable = g_syllables[bench_random(sizeof(g_syllables) / sizeof(g_syllables[0]))];
+      memcpy(name + len, syllable, strlen(syllable));
+      len += strlen(syllable);
+    }
+
+    /* words start with capital letter, when it is an ASCII one */
+    if (name[word] >= 'a' && name[word] <= 'z')
+    {
+      name[word] -= 'a' - 'A';
+    }
+
+    if (words > 1)
+    {
+      name[len++] = ' ';
+    }
+  }
+
+  name[len] = 0;
+
+  return strdup(name);
+}
+
+/* query is characters picked from a name, in order, so most queries match something */
+static void bench_query(struct appdb_entry ** entries, size_t count, char * query)
+{
+  const char * name;
+  size_t len;
+  size_t i;
+
+  name = entries[bench_random(count)]->name;
+  len = 0;
+  for (i = 0; name[i] != 0 && len < 4; i++)
+  {
+    if (name[i] != ' ' && bench_random(3) == 0)
+    {
+      query[len++] = name[i];
+    }
+  }
+
+  if (len == 0)
+  {
+    query[len++] = name[0];
+  }
+
+  query[len] = 0;
+}
+
+/* strings are case folded */
+static bool bench_is_subsequence(const char * name, const char * query)
+{
+  for (; *name != 0 && *query != 0; name++)
+  {
+    if (*name == *query)
+    {
+      query++;
+    }
+  }
+
+  return *query == 0;
+}
+
+static int bench_compare_double(const void * a, const void * b)
+{
+  return *(const double *)a < *(const double *)b ? -1 : *(const double *)a > *(const double *)b;
+}
+
+static bool bench_size(const struct bench_size * size_ptr)
+{
+  struct list_head appdb;
+  struct appdb_entry ** entries;
+  struct appdb_fuzzy * fuzzy_ptr;
+  struct appdb_fuzzy_match matches[K];
+  struct timespec start;
+  struct timespec end;
+  double times[QUERIES];
+  char query[8];
+  char ** folded;
+  char * folded_name;
+  char * folded_query;
+  size_t count;
+  size_t expected;
+  size_t i;
+  size_t j;
+  bool match;
+  bool ret;
+
+  ret = false;
+
+  INIT_LIST_HEAD(&appdb);
+
+  entries = calloc(size_ptr->count, sizeof(struct appdb_entry *));
+  folded = calloc(size_ptr->count, sizeof(char *));
+  if (entries == NULL || folded == NULL)
+  {
+    free(entries);
+    free(folded);
+    return false;
+  }
+
+  for (i = 0; i < size_ptr->count; i++)
+  {
+    entries[i] = calloc(1, sizeof(struct appdb_entry));
+    if (entries[i] == NULL)
+    {
+      goto free_entries;
+    }
+
+    list_add_tail(&entries[i]->siblings, &appdb);
+
+    entries[i]->name = bench_name();
+    if (entries[i]->name == NULL)
+    {
+      goto free_entries;
+    }
+
+    /* for checking of the results */
+    folded[i] = appdb_casefold(entries[i]->name);
+    if (folded[i] == NULL)
+    {
+      goto free_entries;
+    }
+  }
+
+  fuzzy_ptr = appdb_fuzzy_new(&appdb);
+  if (fuzzy_ptr == NULL)
+  {
+    goto free_entries;
+  }
+
+  for (i = 0; i < QUERIES; i++)
+  {
+    bench_query(entries, size_ptr->count, query);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!appdb_fuzzy_search(fuzzy_ptr, query, matches, K, &count))
+    {
+      printf("search for \"%s\" failed\n", query);
+      goto destroy_fuzzy;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    times[i] = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+
+    /* results are checked outside of the timed part */
+    folded_query = appdb_casefold(query);
+    if (folded_query == NULL)
+    {
+      goto destroy_fuzzy;
+    }
+
+    expected = 0;
+    for (j = 0; j < size_ptr->count; j++)
+    {
+      if (bench_is_subsequence(folded[j], folded_query))
+      {
+        expected++;
+      }
+    }
+
+    free(folded_query);
+
+    if (count != (expected < K ? expected : K))
+    {
+      printf("\"%s\" has %zu matches, %zu expected\n", query, count, expected < K ? expected : K);
+      goto destroy_fuzzy;
+    }
+
+    for (j = 0; j < count; j++)
+    {
+      folded_name = appdb_casefold(matches[j].entry_ptr->name);
+      folded_query = appdb_casefold(query);
+      match = folded_name != NULL && folded_query != NULL && bench_is_subsequence(folded_name, folded_query);
+      free(folded_name);
+      free(folded_query);
+
+      if (!match || (j > 0 && matches[j].score > matches[j - 1].score))
+      {
+        printf("\"%s\" is not a valid match of \"%s\"\n", matches[j].entry_ptr->name, query);
+        goto destroy_fuzzy;
+      }
+    }
+  }
+
+  qsort(times, QUERIES, sizeof(double), bench_compare_double);
+
+  ret = times[QUERIES / 2] <= size_ptr->budget_us;
+
+  printf(
+    "%6zu names: median %8.1f us, p99 %8.1f us, budget %8.1f us %s\n",
+    size_ptr->count,
+    times[QUERIES / 2],
+    times[QUERIES * 99 / 100],
+    size_ptr->budget_us,
+    ret ? "ok" : "EXCEEDED");
+
+destroy_fuzzy:
+  appdb_fuzzy_destroy(fuzzy_ptr);
+free_entries:
+  appdb_free(&appdb);
+  for (i = 0; i < size_ptr->count; i++)
+  {
+    free(folded[i]);
+  }
+
+  free(folded);
+  free(entries);
+  return ret;
+}
+
+/* case folding of non-ASCII letters, needs UTF-8 locale */
+static bool bench_check_casefold(void)
+{
+  struct list_head appdb;
+  struct appdb_entry entry;
+  struct appdb_fuzzy * fuzzy_ptr;
+  struct appdb_fuzzy_match match;
+  size_t count;
+
+  INIT_LIST_HEAD(&appdb);
+  memset(&entry, 0, sizeof(entry));
+  entry.name = "Élan";
+  list_add_tail(&entry.siblings, &appdb);
+
+  fuzzy_ptr = appdb_fuzzy_new(&appdb);
+  if (fuzzy_ptr == NULL)
+  {
+    return false;
+  }
+
+  if (!appdb_fuzzy_search(fuzzy_ptr, "élan", &match, 1, &count))
+  {
+    count = 0;
+  }
+
+  appdb_fuzzy_destroy(fuzzy_ptr);
+
+  printf("\"élan\" %s \"Élan\"\n", count == 1 ? "matches" : "DOES NOT MATCH");
+
+  return count == 1;
+}
+
+int main(void)
+{
+  size_t i;
+  bool ret;
+
+  /* as the daemon does */
+  if (setlocale(LC_CTYPE, "") == NULL || MB_CUR_MAX == 1)
+  {
+    setlocale(LC_CTYPE, "C.UTF-8");
+  }
+
+  /* info messages of the matcher would be in the timed part */
+  appdb_log_configure("error");
+
+  ret = MB_CUR_MAX == 1 || bench_check_casefold();
+
+  for (i = 0; i < sizeof(g_sizes) / sizeof(g_sizes[0]); i++)
+  {
+    if (!bench_size(g_sizes + i))
+    {
+      ret = false;
+    }
+  }
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -12,8 +12,67 @@
 #ifndef APPDB_H__4839D031_68EF_43F5_BDE2_2317C6B956A9__INCLUDED
 #define APPDB_H__4839D031_68EF_43F5_BDE2_2317C6B956A9__INCLUDED
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
 #include "klist.h"
 
+/* marks functions exported by libappdb, everything else in the library has hidden visibility */
+#if defined(__GNUC__)
+# define APPDB_API __attribute__((visibility("default")))
+#else
+# define APPDB_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* field identifiers for appdb_entry_get() */
+#define APPDB_FIELD_NAME          0
+#define APPDB_FIELD_GENERIC_NAME  1
+#define APPDB_FIELD_COMMENT       2
+#define APPDB_FIELD_ICON          3
+#define APPDB_FIELD_EXEC          4
+#define APPDB_FIELD_PATH          5
+#define APPDB_FIELD_TRY_EXEC      6
+#define APPDB_FIELD_COUNT         7
+
+/* memory accounting categories for appdb_entry_memory(), the APPDB_FIELD_xxx strings come first */
+#define APPDB_MEMORY_ENTRY        (APPDB_FIELD_COUNT + 0)  /* appdb_entry struct and state of lazy loading */
+#define APPDB_MEMORY_FILE_PATH    (APPDB_FIELD_COUNT + 1)  /* file_path and desktop_id */
+#define APPDB_MEMORY_EXEC_ARGV    (APPDB_FIELD_COUNT + 2)
+#define APPDB_MEMORY_MIME_TYPES   (APPDB_FIELD_COUNT + 3)
+#define APPDB_MEMORY_CATEGORIES   (APPDB_FIELD_COUNT + 4)
+#define APPDB_MEMORY_SESSION      (APPDB_FIELD_COUNT + 5)  /* lash_class and nsm_exec */
+#define APPDB_MEMORY_ACTIONS      (APPDB_FIELD_COUNT + 6)
+#define APPDB_MEMORY_SHOW_IN      (APPDB_FIELD_COUNT + 7)  /* only_show_in and not_show_in */
+#define APPDB_MEMORY_COUNT        (APPDB_FIELD_COUNT + 8)
+
+/* session management protocols, bits of appdb_entry::session_protocols */
+#define APPDB_SESSION_LASH  1   /* LASH/LADISH, X-LASH or LASHCLASS key */
+#define APPDB_SESSION_NSM   2   /* Non Session Manager, X-NSM-Capable key */
+
+/* appdb_load_stream() events */
+#define APPDB_STREAM_ADD      0   /* entry was accepted and added to the list */
+#define APPDB_STREAM_RETRACT  1   /* entry passed before with APPDB_STREAM_ADD is dropped, it is freed after the callback returns */
+
+/* appdb_load_ex() flags */
+#define APPDB_LOAD_LAZY  1  /* read only name, icon, try_exec and the flags at load time, rest is read by appdb_entry_get() on demand */
+
+struct appdb_entry_lazy;
+
+/* additional way to start the application, from a "Desktop Action" group */
+struct appdb_action
+{
+  char * id;      /* Action identifier, as listed in the Actions key */
+  char * name;    /* Label of the action, for example "New Window" */
+  char * icon;    /* Icon, can be NULL */
+  char * exec;    /* Program to execute, possibly with arguments, can be NULL */
+};
+
 /* all strings except name can be not present (NULL) */
 /* all strings are utf-8 */
 struct appdb_entry
@@ -26,17 +85,322 @@ struct appdb_entry
   char * exec;    /* Program to execute, possibly with arguments. */
   char * path;    /* The working directory to run the program in. */
   bool terminal;    /* Wheter to run application in terminal */
+  char * file_path;  /* Absolute path of the .desktop file the entry was loaded from */
+  char ** exec_argv;  /* exec split to arguments, field codes not expanded. NULL if exec is not present (or not read yet) or invalid */
+  char * desktop_id;  /* Desktop file ID, for example "org.ardour.Ardour8.desktop" */
+  char ** mime_types;  /* NULL terminated list of MIME types from the MimeType key, NULL if not present */
+  char ** categories;  /* NULL terminated list of categories from the Categories key, NULL if not present */
+  unsigned int session_protocols;  /* APPDB_SESSION_xxx bits, 0 if application does not support session management */
+  char * lash_class;  /* Value of the LASHCLASS key, JACK client class of LASH applications */
+  char * nsm_exec;  /* Value of the X-NSM-Exec key, executable to start under NSM, if different from exec */
+  struct appdb_action * actions;  /* Actions in order of the Actions key, NULL if there are none */
+  size_t actions_count;
+  char * try_exec;  /* Executable used to check whether the application is installed */
+  bool hidden;    /* Entry is deleted, as if it did not exist */
+  bool no_display;  /* Entry should not be shown in menus */
+  char ** only_show_in;  /* NULL terminated list of desktop environments the entry should be shown in, NULL if not present */
+  char ** not_show_in;  /* NULL terminated list of desktop environments the entry should not be shown in, NULL if not present */
+  uint64_t content_hash;  /* 64-bit hash of contents of the .desktop file */
+  struct appdb_entry_lazy * lazy;  /* Private to the library, non-NULL when fields are still to be read on demand */
 };
 
 /* parses .desktop entries in suitable XDG directories and returns list of appdb_entry structs in appdb parameter */
 /* returns success status */
+APPDB_API
 bool
 appdb_load(
   struct list_head * appdb);
 
+/* same as appdb_load() but with APPDB_LOAD_xxx flags */
+/* with APPDB_LOAD_LAZY, string fields other than name, icon and try_exec are NULL until read through appdb_entry_get() */
+APPDB_API
+bool
+appdb_load_ex(
+  struct list_head * appdb,
+  unsigned int flags);
+
+typedef void (* appdb_stream_callback)(void * ctx, unsigned int event, struct appdb_entry * entry_ptr);
+
+/* same as appdb_load_ex() but callback is called for each entry as soon as it is parsed, */
+/* before rest of the directories are scanned */
+/* directories are scanned in order of precedence, so shadowed files are never passed to the callback; */
+/* if loading fails, entries passed so far are retracted before the list is freed */
+APPDB_API
+bool
+appdb_load_stream(
+  struct list_head * appdb,
+  unsigned int flags,
+  appdb_stream_callback callback,
+  void * ctx);
+
+/* scan the directories again and update list loaded by one of the appdb_load functions */
+/* entries of files with same contents as before are kept as they are, without parsing the files again */
+/* callback is called with APPDB_STREAM_RETRACT for entries that were removed or changed, */
+/* and then with APPDB_STREAM_ADD for the new and changed ones; unchanged entries are not reported */
+/* on failure, the list is empty and all entries that were in it are retracted */
+APPDB_API
+bool
+appdb_reload(
+  struct list_head * appdb,
+  unsigned int flags,
+  appdb_stream_callback callback,
+  void * ctx);
+
+/* save the list to the snapshot file at path, to be loaded with appdb_snapshot_load() */
+/* scan_time is when the scan of the directories that produced the list started; */
+/* if a directory or a .desktop file changed since then, the list can be stale and nothing is saved */
+/* entries loaded with APPDB_LOAD_LAZY are read completely */
+APPDB_API
+bool
+appdb_snapshot_save(
+  struct list_head * appdb,
+  time_t scan_time,
+  const char * path);
+
+/* load list saved by appdb_snapshot_save(), without scanning the .desktop files */
+/* it fails when the applications directories or the .desktop files in them are not same */
+/* as when the snapshot was saved, then appdb_load() is to be used; the entries are not lazy */
+APPDB_API
+bool
+appdb_snapshot_load(
+  struct list_head * appdb,
+  const char * path);
+
+/* returns value of APPDB_FIELD_xxx string field, NULL if not present */
+/* for entries loaded with APPDB_LOAD_LAZY, the value is read from the .desktop file on first access and then cached; */
+/* if the file was modified since the scan, it is parsed again */
+APPDB_API
+const char *
+appdb_entry_get(
+  struct appdb_entry * entry_ptr,
+  unsigned int field);
+
+/* expand field codes in exec of an entry, returns NULL terminated argument list to be freed with appdb_argv_free() */
+/* %f and %u expand to first of the URIs, %F and %U to all of them; file:// URIs are converted to paths for %f and %F */
+/* when terminal is set, argument list starts with $TERMINAL (or xterm) and -e */
+APPDB_API
+char **
+appdb_entry_expand_exec(
+  struct appdb_entry * entry_ptr,
+  const char * const * uris,
+  size_t uris_count);
+
+APPDB_API
+void
+appdb_argv_free(
+  char ** argv);
+
+/* start the application with posix_spawn(), in the working directory from path */
+/* if exec takes single file or URI, one process is started per URI, so pids must have room for max(uris_count, 1) elements */
+APPDB_API
+bool
+appdb_entry_launch(
+  struct appdb_entry * entry_ptr,
+  const char * const * uris,
+  size_t uris_count,
+  pid_t * pids,
+  size_t * pids_count_ptr);
+
+struct appdb_mime_index;
+
+/* build index of applications that handle MIME types, for entries in the appdb list */
+/* besides the MimeType keys, mimeinfo.cache files in the applications directories and */
+/* mimeapps.list files in XDG config and data directories are read, if present */
+/* the index references the entries, so it must be destroyed before appdb_free() */
+APPDB_API
+struct appdb_mime_index *
+appdb_mime_index_new(
+  struct list_head * appdb);
+
+APPDB_API
+void
+appdb_mime_index_destroy(
+  struct appdb_mime_index * index_ptr);
+
+/* returns array of entries that handle the MIME type, in order of preference, */
+/* the default application (if any) is first; NULL with count 0 if there are none */
+/* returned array is owned by the index */
+APPDB_API
+struct appdb_entry * const *
+appdb_mime_index_lookup(
+  struct appdb_mime_index * index_ptr,
+  const char * mime_type,
+  size_t * count_ptr);
+
+struct appdb_category_index;
+
+/* build index of entries in the appdb list by category */
+/* the index references the entries, so it must be destroyed before appdb_free() */
+APPDB_API
+struct appdb_category_index *
+appdb_category_index_new(
+  struct list_head * appdb);
+
+APPDB_API
+void
+appdb_category_index_destroy(
+  struct appdb_category_index * index_ptr);
+
+/* returns NULL terminated array of the known category names, owned by the index */
+APPDB_API
+const char * const *
+appdb_category_index_get_names(
+  struct appdb_category_index * index_ptr);
+
+/* number of entries in the category, 0 for unknown categories */
+APPDB_API
+size_t
+appdb_category_index_count(
+  struct appdb_category_index * index_ptr,
+  const char * category);
+
+/* find entries that are in all categories of the "all" list, */
+/* in at least one category of the "any" list and in none of the "none" list */
+/* lists are NULL terminated, NULL or empty list is no constraint */
+/* returns array of the matching entries in appdb list order, to be freed with free() */
+/* NULL is returned only on failure */
+APPDB_API
+struct appdb_entry **
+appdb_category_index_query(
+  struct appdb_category_index * index_ptr,
+  const char * const * all,
+  const char * const * any,
+  const char * const * none,
+  size_t * count_ptr);
+
+struct appdb_complete_index;
+
+/* build index for completion of name, generic name and executable name prefixes */
+/* the index references the entries, so it must be destroyed before appdb_free(), */
+/* or kept up to date with appdb_complete_index_add() and appdb_complete_index_remove() */
+APPDB_API
+struct appdb_complete_index *
+appdb_complete_index_new(
+  struct list_head * appdb);
+
+APPDB_API
+void
+appdb_complete_index_destroy(
+  struct appdb_complete_index * index_ptr);
+
+/* add entry, for example from APPDB_STREAM_ADD event of appdb_reload() */
+APPDB_API
+bool
+appdb_complete_index_add(
+  struct appdb_complete_index * index_ptr,
+  struct appdb_entry * entry_ptr);
+
+/* remove entry, for example from APPDB_STREAM_RETRACT event of appdb_reload() */
+APPDB_API
+void
+appdb_complete_index_remove(
+  struct appdb_complete_index * index_ptr,
+  struct appdb_entry * entry_ptr);
+
+/* find entries with name, generic name or executable name starting with prefix, ignoring case as appdb_casefold() does */
+/* entries are ordered by the matching key, at most limit of them are returned, 0 is no limit */
+/* returns array to be freed with free(), NULL is returned only on failure */
+APPDB_API
+struct appdb_entry **
+appdb_complete_index_query(
+  struct appdb_complete_index * index_ptr,
+  const char * prefix,
+  size_t limit,
+  size_t * count_ptr);
+
+/* lowercase form of the string, according to LC_CTYPE of the current locale, to be freed with free() */
+/* bytes that are not valid in the locale charset are kept as they are, so in the C locale only ASCII letters are folded */
+APPDB_API
+char *
+appdb_casefold(
+  const char * string);
+
+struct appdb_sorted_view;
+
+/* build array of entries in the appdb list, ordered by APPDB_FIELD_xxx field according to LC_COLLATE */
+/* of the current locale; entries without the field are at the end, ordered by name */
+/* the view references the entries, so it must be destroyed before appdb_free(), */
+/* or kept up to date with appdb_sorted_view_add() and appdb_sorted_view_remove() */
+APPDB_API
+struct appdb_sorted_view *
+appdb_sorted_view_new(
+  struct list_head * appdb,
+  unsigned int field);
+
+APPDB_API
+void
+appdb_sorted_view_destroy(
+  struct appdb_sorted_view * view_ptr);
+
+APPDB_API
+bool
+appdb_sorted_view_add(
+  struct appdb_sorted_view * view_ptr,
+  struct appdb_entry * entry_ptr);
+
+APPDB_API
+void
+appdb_sorted_view_remove(
+  struct appdb_sorted_view * view_ptr,
+  struct appdb_entry * entry_ptr);
+
+/* returns NULL terminated array of the entries, in order, owned by the view and valid until it is changed */
+APPDB_API
+struct appdb_entry * const *
+appdb_sorted_view_get(
+  struct appdb_sorted_view * view_ptr,
+  size_t * count_ptr);
+
+/* memory accounting, all sizes are in bytes of heap blocks, as reported by malloc_usable_size() */
+
+/* add memory used by the entry to usage, array of APPDB_MEMORY_COUNT elements indexed by */
+/* APPDB_FIELD_xxx and APPDB_MEMORY_xxx, and return the total */
+APPDB_API
+size_t
+appdb_entry_memory(
+  struct appdb_entry * entry_ptr,
+  size_t * usage);
+
+/* name of APPDB_FIELD_xxx or APPDB_MEMORY_xxx category, like "generic_name" or "exec_argv" */
+APPDB_API
+const char *
+appdb_memory_category_name(
+  unsigned int category);
+
+APPDB_API
+size_t
+appdb_mime_index_memory(
+  struct appdb_mime_index * index_ptr);
+
+APPDB_API
+size_t
+appdb_category_index_memory(
+  struct appdb_category_index * index_ptr);
+
+APPDB_API
+size_t
+appdb_complete_index_memory(
+  struct appdb_complete_index * index_ptr);
+
+APPDB_API
+size_t
+appdb_sorted_view_memory(
+  struct appdb_sorted_view * view_ptr);
+
+/* size of the largest buffer used for contents of a .desktop file, since start of the process; */
+/* the buffers are freed when parsing of the file is finished */
+APPDB_API
+size_t
+appdb_parser_buffer_peak(void);
+
 /* free list of appdb_entry structs, as returned by appdb_load() */
+APPDB_API
 void
 appdb_free(
   struct list_head * appdb);
 
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif /* #ifndef APPDB_H__4839D031_68EF_43F5_BDE2_2317C6B956A9__INCLUDED */
@@ -0,0 +1,229 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *****************************************************************
+ * This file contains the fast path protocol and a client for it *
+ *****************************************************************/
+
+#ifndef FASTPATH_H__6A1E93C7_25D8_4B0F_8E4A_C3F71B2D905E__INCLUDED
+#define FASTPATH_H__6A1E93C7_25D8_4B0F_8E4A_C3F71B2D905E__INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The daemon listens on a SOCK_SEQPACKET unix socket, path of which is returned by the
+ * GetFastPathSocket D-Bus method. Each request and each response is one packet, a header
+ * followed by the payload. Numbers are in host byte order, strings are a uint16_t length
+ * followed by that many bytes, without terminating zero. Requests are answered in order,
+ * so more of them can be sent before reading the responses; the id of a request is copied
+ * to its response. Client that does not read its responses is disconnected. */
+
+#define APPDB_FASTPATH_MAX_PACKET 65536
+
+/* request codes */
+#define APPDB_FASTPATH_LOOKUP  1  /* payload is name; response has the APPDB_FIELD_xxx strings of the application, empty if not set */
+#define APPDB_FASTPATH_SEARCH  2  /* payload is uint32_t k and the query; response has up to k matches, uint32_t score and name, best first */
+#define APPDB_FASTPATH_LIST    3  /* payload is uint32_t position and uint32_t fields bitmask, 0 for all; response has uint32_t total */
+                                  /* and as many applications, ordered by name, as fit, each with strings of the fields */
+
+/* response codes */
+#define APPDB_FASTPATH_OK         0
+#define APPDB_FASTPATH_NOT_FOUND  1
+#define APPDB_FASTPATH_INVALID    2  /* unknown request code or malformed payload */
+#define APPDB_FASTPATH_LOADING    3  /* database is not loaded yet */
+#define APPDB_FASTPATH_FAILED     4
+
+struct appdb_fastpath_header
+{
+  uint32_t id;        /* chosen by the client */
+  uint16_t code;      /* APPDB_FASTPATH_xxx request or response code */
+  uint16_t count;     /* number of records (fields, matches or applications) in the response */
+  uint32_t length;    /* of the payload */
+};
+
+/* returns connected socket, or -1 on failure */
+static inline
+int
+appdb_fastpath_connect(
+  const char * path)
+{
+  struct sockaddr_un address;
+  int fd;
+
+  if (strlen(path) >= sizeof(address.sun_path))
+  {
+    return -1;
+  }
+
+  fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+  {
+    return -1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static inline
+bool
+appdb_fastpath_send(
+  int fd,
+  uint32_t id,
+  uint16_t code,
+  const void * payload1,
+  size_t length1,
+  const void * payload2,
+  size_t length2)
+{
+  struct appdb_fastpath_header header;
+  struct iovec iov[3];
+  struct msghdr message;
+
+  header.id = id;
+  header.code = code;
+  header.count = 0;
+  header.length = length1 + length2;
+
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = (void *)payload1;
+  iov[1].iov_len = length1;
+  iov[2].iov_base = (void *)payload2;
+  iov[2].iov_len = length2;
+
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = iov;
+  message.msg_iovlen = 3;
+
+  return sendmsg(fd, &message, MSG_NOSIGNAL) == (ssize_t)(sizeof(header) + length1 + length2);
+}
+
+static inline
+bool
+appdb_fastpath_lookup(
+  int fd,
+  uint32_t id,
+  const char * name)
+{
+  return appdb_fastpath_send(fd, id, APPDB_FASTPATH_LOOKUP, name, strlen(name), NULL, 0);
+}
+
+static inline
+bool
+appdb_fastpath_search(
+  int fd,
+  uint32_t id,
+  const char * query,
+  uint32_t k)
+{
+  return appdb_fastpath_send(fd, id, APPDB_FASTPATH_SEARCH, &k, sizeof(k), query, strlen(query));
+}
+
+static inline
+bool
+appdb_fastpath_list(
+  int fd,
+  uint32_t id,
+  uint32_t position,
+  uint32_t fields)
+{
+  uint32_t payload[2];
+
+  payload[0] = position;
+  payload[1] = fields;
+
+  return appdb_fastpath_send(fd, id, APPDB_FASTPATH_LIST, payload, sizeof(payload), NULL, 0);
+}
+
+/* receive next response into buffer of APPDB_FASTPATH_MAX_PACKET bytes, it starts with the header */
+static inline
+bool
+appdb_fastpath_receive(
+  int fd,
+  void * buffer)
+{
+  ssize_t ret;
+
+  ret = recv(fd, buffer, APPDB_FASTPATH_MAX_PACKET, 0);
+
+  return ret >= (ssize_t)sizeof(struct appdb_fastpath_header) &&
+    ((struct appdb_fastpath_header *)buffer)->length == ret - sizeof(struct appdb_fastpath_header);
+}
+
+/* read number from payload at *data_ptr, and advance it; false if payload ends before it */
+static inline
+bool
+appdb_fastpath_read_uint32(
+  const char ** data_ptr,
+  const char * end,
+  uint32_t * value_ptr)
+{
+  if (end - *data_ptr < (ptrdiff_t)sizeof(uint32_t))
+  {
+    return false;
+  }
+
+  memcpy(value_ptr, *data_ptr, sizeof(uint32_t));
+  *data_ptr += sizeof(uint32_t);
+
+  return true;
+}
+
+/* string is not zero terminated */
+static inline
+bool
+appdb_fastpath_read_string(
+  const char ** data_ptr,
+  const char * end,
+  const char ** string_ptr,
+  size_t * length_ptr)
+{
+  uint16_t length;
+
+  if (end - *data_ptr < (ptrdiff_t)sizeof(uint16_t))
+  {
+    return false;
+  }
+
+  memcpy(&length, *data_ptr, sizeof(uint16_t));
+  if (end - *data_ptr - (ptrdiff_t)sizeof(uint16_t) < length)
+  {
+    return false;
+  }
+
+  *string_ptr = *data_ptr + sizeof(uint16_t);
+  *length_ptr = length;
+  *data_ptr += sizeof(uint16_t) + length;
+
+  return true;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* #ifndef FASTPATH_H__6A1E93C7_25D8_4B0F_8E4A_C3F71B2D905E__INCLUDED */
@@ -28,7 +28,7 @@
  *
  */
 #define container_of(ptr, type, member) ({      \
-        const typeof( ((type *)0)->member ) *__mptr = (ptr);  \
+        const __typeof__( ((type *)0)->member ) *__mptr = (ptr);  \
         (type *)( (char *)__mptr - offsetof(type,member) );})
 
 #define prefetch(x) (x = x)
@@ -72,40 +72,40 @@ static inline void INIT_LIST_HEAD(struct list_head *list)
  * This is only for internal list manipulation where we know
  * the prev/next entries already!
  */
-static inline void __list_add(struct list_head *new,
+static inline void __list_add(struct list_head *entry,
             struct list_head *prev,
             struct list_head *next)
 {
-  next->prev = new;
-  new->next = next;
-  new->prev = prev;
-  prev->next = new;
+  next->prev = entry;
+  entry->next = next;
+  entry->prev = prev;
+  prev->next = entry;
 }
 
 /**
  * list_add - add a new entry
- * @new: new entry to be added
+ * @entry: new entry to be added
  * @head: list head to add it after
  *
  * Insert a new entry after the specified head.
  * This is good for implementing stacks.
  */
-static inline void list_add(struct list_head *new, struct list_head *head)
+static inline void list_add(struct list_head *entry, struct list_head *head)
 {
-  __list_add(new, head, head->next);
+  __list_add(entry, head, head->next);
 }
 
 /**
  * list_add_tail - add a new entry
- * @new: new entry to be added
+ * @entry: new entry to be added
  * @head: list head to add it before
  *
  * Insert a new entry before the specified head.
  * This is useful for implementing queues.
  */
-static inline void list_add_tail(struct list_head *new, struct list_head *head)
+static inline void list_add_tail(struct list_head *entry, struct list_head *head)
 {
-  __list_add(new, head->prev, head);
+  __list_add(entry, head->prev, head);
 }
 
 /*
@@ -114,19 +114,19 @@ static inline void list_add_tail(struct list_head *new, struct list_head *head)
  * This is only for internal list manipulation where we know
  * the prev/next entries already!
  */
-static inline void __list_add_rcu(struct list_head * new,
+static inline void __list_add_rcu(struct list_head * entry,
     struct list_head * prev, struct list_head * next)
 {
-  new->next = next;
-  new->prev = prev;
+  entry->next = next;
+  entry->prev = prev;
 //  smp_wmb();
-  next->prev = new;
-  prev->next = new;
+  next->prev = entry;
+  prev->next = entry;
 }
 
 /**
  * list_add_rcu - add a new entry to rcu-protected list
- * @new: new entry to be added
+ * @entry: new entry to be added
  * @head: list head to add it after
  *
  * Insert a new entry after the specified head.
@@ -140,14 +140,14 @@ static inline void __list_add_rcu(struct list_head * new,
  * the _rcu list-traversal primitives, such as
  * list_for_each_entry_rcu().
  */
-static inline void list_add_rcu(struct list_head *new, struct list_head *head)
+static inline void list_add_rcu(struct list_head *entry, struct list_head *head)
 {
-  __list_add_rcu(new, head, head->next);
+  __list_add_rcu(entry, head, head->next);
 }
 
 /**
  * list_add_tail_rcu - add a new entry to rcu-protected list
- * @new: new entry to be added
+ * @entry: new entry to be added
  * @head: list head to add it before
  *
  * Insert a new entry before the specified head.
@@ -161,10 +161,10 @@ static inline void list_add_rcu(struct list_head *new, struct list_head *head)
  * the _rcu list-traversal primitives, such as
  * list_for_each_entry_rcu().
  */
-static inline void list_add_tail_rcu(struct list_head *new,
+static inline void list_add_tail_rcu(struct list_head *entry,
           struct list_head *head)
 {
-  __list_add_rcu(new, head->prev, head);
+  __list_add_rcu(entry, head->prev, head);
 }
 
 /*
@@ -189,8 +189,8 @@ static inline void __list_del(struct list_head * prev, struct list_head * next)
 static inline void list_del(struct list_head *entry)
 {
   __list_del(entry->prev, entry->next);
-  entry->next = LIST_POISON1;
-  entry->prev = LIST_POISON2;
+  entry->next = (struct list_head *)LIST_POISON1;
+  entry->prev = (struct list_head *)LIST_POISON2;
 }
 
 /**
@@ -220,25 +220,25 @@ static inline void list_del(struct list_head *entry)
 static inline void list_del_rcu(struct list_head *entry)
 {
   __list_del(entry->prev, entry->next);
-  entry->prev = LIST_POISON2;
+  entry->prev = (struct list_head *)LIST_POISON2;
 }
 
 /*
  * list_replace_rcu - replace old entry by new one
  * @old : the element to be replaced
- * @new : the new element to insert
+ * @entry : the new element to insert
  *
  * The old entry will be replaced with the new entry atomically.
  */
 static inline void list_replace_rcu(struct list_head *old,
-        struct list_head *new)
+        struct list_head *entry)
 {
-  new->next = old->next;
-  new->prev = old->prev;
+  entry->next = old->next;
+  entry->prev = old->prev;
 //  smp_wmb();
-  new->next->prev = new;
-  new->prev->next = new;
-  old->prev = LIST_POISON2;
+  entry->next->prev = entry;
+  entry->prev->next = entry;
+  old->prev = (struct list_head *)LIST_POISON2;
 }
 
 /**
@@ -399,9 +399,9 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_for_each_entry(pos, head, member)        \
-  for (pos = list_entry((head)->next, typeof(*pos), member);  \
+  for (pos = list_entry((head)->next, __typeof__(*pos), member);  \
        prefetch(pos->member.next), &pos->member != (head);  \
-       pos = list_entry(pos->member.next, typeof(*pos), member))
+       pos = list_entry(pos->member.next, __typeof__(*pos), member))
 
 /**
  * list_for_each_entry_reverse - iterate backwards over list of given type.
@@ -410,9 +410,9 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_for_each_entry_reverse(pos, head, member)      \
-  for (pos = list_entry((head)->prev, typeof(*pos), member);  \
+  for (pos = list_entry((head)->prev, __typeof__(*pos), member);  \
        prefetch(pos->member.prev), &pos->member != (head);  \
-       pos = list_entry(pos->member.prev, typeof(*pos), member))
+       pos = list_entry(pos->member.prev, __typeof__(*pos), member))
 
 /**
  * list_prepare_entry - prepare a pos entry for use as a start point in
@@ -422,7 +422,7 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_prepare_entry(pos, head, member) \
-  ((pos) ? : list_entry(head, typeof(*pos), member))
+  ((pos) ? : list_entry(head, __typeof__(*pos), member))
 
 /**
  * list_for_each_entry_continue - iterate over list of given type
@@ -432,9 +432,9 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_for_each_entry_continue(pos, head, member)     \
-  for (pos = list_entry(pos->member.next, typeof(*pos), member);  \
+  for (pos = list_entry(pos->member.next, __typeof__(*pos), member);  \
        prefetch(pos->member.next), &pos->member != (head);  \
-       pos = list_entry(pos->member.next, typeof(*pos), member))
+       pos = list_entry(pos->member.next, __typeof__(*pos), member))
 
 /**
  * list_for_each_entry_from - iterate over list of given type
@@ -445,7 +445,7 @@ static inline void list_splice_init(struct list_head *list,
  */
 #define list_for_each_entry_from(pos, head, member)       \
   for (; prefetch(pos->member.next), &pos->member != (head);  \
-       pos = list_entry(pos->member.next, typeof(*pos), member))
+       pos = list_entry(pos->member.next, __typeof__(*pos), member))
 
 /**
  * list_for_each_entry_safe - iterate over list of given type safe against removal of list entry
@@ -455,10 +455,10 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_for_each_entry_safe(pos, n, head, member)      \
-  for (pos = list_entry((head)->next, typeof(*pos), member),  \
-    n = list_entry(pos->member.next, typeof(*pos), member); \
+  for (pos = list_entry((head)->next, __typeof__(*pos), member),  \
+    n = list_entry(pos->member.next, __typeof__(*pos), member); \
        &pos->member != (head);          \
-       pos = n, n = list_entry(n->member.next, typeof(*n), member))
+       pos = n, n = list_entry(n->member.next, __typeof__(*n), member))
 
 /**
  * list_for_each_entry_safe_continue -  iterate over list of given type
@@ -469,10 +469,10 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_for_each_entry_safe_continue(pos, n, head, member)     \
-  for (pos = list_entry(pos->member.next, typeof(*pos), member),    \
-    n = list_entry(pos->member.next, typeof(*pos), member);   \
+  for (pos = list_entry(pos->member.next, __typeof__(*pos), member),    \
+    n = list_entry(pos->member.next, __typeof__(*pos), member);   \
        &pos->member != (head);            \
-       pos = n, n = list_entry(n->member.next, typeof(*n), member))
+       pos = n, n = list_entry(n->member.next, __typeof__(*n), member))
 
 /**
  * list_for_each_entry_safe_from - iterate over list of given type
@@ -483,9 +483,9 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_for_each_entry_safe_from(pos, n, head, member)       \
-  for (n = list_entry(pos->member.next, typeof(*pos), member);    \
+  for (n = list_entry(pos->member.next, __typeof__(*pos), member);    \
        &pos->member != (head);            \
-       pos = n, n = list_entry(n->member.next, typeof(*n), member))
+       pos = n, n = list_entry(n->member.next, __typeof__(*n), member))
 
 /**
  * list_for_each_entry_safe_reverse - iterate backwards over list of given type safe against
@@ -496,10 +496,10 @@ static inline void list_splice_init(struct list_head *list,
  * @member: the name of the list_struct within the struct.
  */
 #define list_for_each_entry_safe_reverse(pos, n, head, member)    \
-  for (pos = list_entry((head)->prev, typeof(*pos), member),  \
-    n = list_entry(pos->member.prev, typeof(*pos), member); \
+  for (pos = list_entry((head)->prev, __typeof__(*pos), member),  \
+    n = list_entry(pos->member.prev, __typeof__(*pos), member); \
        &pos->member != (head);          \
-       pos = n, n = list_entry(n->member.prev, typeof(*n), member))
+       pos = n, n = list_entry(n->member.prev, __typeof__(*n), member))
 
 /**
  * list_for_each_rcu  - iterate over an rcu-protected list
@@ -547,10 +547,10 @@ static inline void list_splice_init(struct list_head *list,
  * as long as the traversal is guarded by rcu_read_lock().
  */
 #define list_for_each_entry_rcu(pos, head, member) \
-  for (pos = list_entry((head)->next, typeof(*pos), member); \
+  for (pos = list_entry((head)->next, __typeof__(*pos), member); \
     prefetch(rcu_dereference(pos)->member.next), \
       &pos->member != (head); \
-    pos = list_entry(pos->member.next, typeof(*pos), member))
+    pos = list_entry(pos->member.next, __typeof__(*pos), member))
 
 
 /**
@@ -614,8 +614,8 @@ static inline void __hlist_del(struct hlist_node *n)
 static inline void hlist_del(struct hlist_node *n)
 {
   __hlist_del(n);
-  n->next = LIST_POISON1;
-  n->pprev = LIST_POISON2;
+  n->next = (struct hlist_node *)LIST_POISON1;
+  n->pprev = (struct hlist_node **)LIST_POISON2;
 }
 
 /**
@@ -640,7 +640,7 @@ static inline void hlist_del(struct hlist_node *n)
 static inline void hlist_del_rcu(struct hlist_node *n)
 {
   __hlist_del(n);
-  n->pprev = LIST_POISON2;
+  n->pprev = (struct hlist_node **)LIST_POISON2;
 }
 
 static inline void hlist_del_init(struct hlist_node *n)
@@ -654,22 +654,22 @@ static inline void hlist_del_init(struct hlist_node *n)
 /*
  * hlist_replace_rcu - replace old entry by new one
  * @old : the element to be replaced
- * @new : the new element to insert
+ * @entry : the new element to insert
  *
  * The old entry will be replaced with the new entry atomically.
  */
 static inline void hlist_replace_rcu(struct hlist_node *old,
-          struct hlist_node *new)
+          struct hlist_node *entry)
 {
   struct hlist_node *next = old->next;
 
-  new->next = next;
-  new->pprev = old->pprev;
+  entry->next = next;
+  entry->pprev = old->pprev;
 //  smp_wmb();
   if (next)
-    new->next->pprev = &new->next;
-  *new->pprev = new;
-  old->pprev = LIST_POISON2;
+    entry->next->pprev = &entry->next;
+  *entry->pprev = entry;
+  old->pprev = (struct hlist_node **)LIST_POISON2;
 }
 
 static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
@@ -803,7 +803,7 @@ static inline void hlist_add_after_rcu(struct hlist_node *prev,
 #define hlist_for_each_entry(tpos, pos, head, member)      \
   for (pos = (head)->first;          \
        pos && ({ prefetch(pos->next); 1;}) &&      \
-    ({ tpos = hlist_entry(pos, typeof(*tpos), member); 1;}); \
+    ({ tpos = hlist_entry(pos, __typeof__(*tpos), member); 1;}); \
        pos = pos->next)
 
 /**
@@ -815,7 +815,7 @@ static inline void hlist_add_after_rcu(struct hlist_node *prev,
 #define hlist_for_each_entry_continue(tpos, pos, member)     \
   for (pos = (pos)->next;            \
        pos && ({ prefetch(pos->next); 1;}) &&      \
-    ({ tpos = hlist_entry(pos, typeof(*tpos), member); 1;}); \
+    ({ tpos = hlist_entry(pos, __typeof__(*tpos), member); 1;}); \
        pos = pos->next)
 
 /**
@@ -826,7 +826,7 @@ static inline void hlist_add_after_rcu(struct hlist_node *prev,
  */
 #define hlist_for_each_entry_from(tpos, pos, member)       \
   for (; pos && ({ prefetch(pos->next); 1;}) &&      \
-    ({ tpos = hlist_entry(pos, typeof(*tpos), member); 1;}); \
+    ({ tpos = hlist_entry(pos, __typeof__(*tpos), member); 1;}); \
        pos = pos->next)
 
 /**
@@ -840,7 +840,7 @@ static inline void hlist_add_after_rcu(struct hlist_node *prev,
 #define hlist_for_each_entry_safe(tpos, pos, n, head, member)      \
   for (pos = (head)->first;          \
        pos && ({ n = pos->next; 1; }) &&         \
-    ({ tpos = hlist_entry(pos, typeof(*tpos), member); 1;}); \
+    ({ tpos = hlist_entry(pos, __typeof__(*tpos), member); 1;}); \
        pos = n)
 
 /**
@@ -857,7 +857,7 @@ static inline void hlist_add_after_rcu(struct hlist_node *prev,
 #define hlist_for_each_entry_rcu(tpos, pos, head, member)    \
   for (pos = (head)->first;          \
        rcu_dereference(pos) && ({ prefetch(pos->next); 1;}) &&   \
-    ({ tpos = hlist_entry(pos, typeof(*tpos), member); 1;}); \
+    ({ tpos = hlist_entry(pos, __typeof__(*tpos), member); 1;}); \
        pos = pos->next)
 
 #endif
@@ -9,10 +9,16 @@
  * This file contains code of the application database *
  *******************************************************/
 
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
 
 #include "common.h"
@@ -20,12 +26,22 @@
 #include "log.h"
 #include "catdup.h"
 #include "assert.h"
+#include "exec.h"
+#include "strlist.h"
+#include "hash.h"
+#include "digest.h"
+#include "probes.h"
+
+#define log_parser(fmt, args...) log_subsystem(LOG_SUBSYSTEM_PARSER, LOG_LEVEL_DEBUG, fmt, ## args)
 
 static
 void
 appdb_free_entry(
   struct appdb_entry * entry_ptr);
 
+/* largest file buffer so far, written by the thread that loads and read by any thread */
+static size_t g_appdb_parser_buffer_peak;
+
 #define MAP_TYPE_STRING  0
 #define MAP_TYPE_BOOL    1
 
@@ -34,6 +50,8 @@ struct appdb_map
   const char * key;
   unsigned int type;
   size_t offset;
+  unsigned int field;           /* APPDB_FIELD_xxx, for MAP_TYPE_STRING */
+  bool lazy;                    /* whether reading of value is deferred with APPDB_LOAD_LAZY */
 };
 
 static struct appdb_map g_appdb_entry_map[] =
@@ -41,37 +59,72 @@ static struct appdb_map g_appdb_entry_map[] =
   {
     .key = "Name",
     .type = MAP_TYPE_STRING,
-    .offset = offsetof(struct appdb_entry, name)
+    .offset = offsetof(struct appdb_entry, name),
+    .field = APPDB_FIELD_NAME,
+    .lazy = false
   },
   {
     .key = "GenericName",
     .type = MAP_TYPE_STRING,
-    .offset = offsetof(struct appdb_entry, generic_name)
+    .offset = offsetof(struct appdb_entry, generic_name),
+    .field = APPDB_FIELD_GENERIC_NAME,
+    .lazy = true
   },
   {
     .key = "Comment",
     .type = MAP_TYPE_STRING,
-    .offset = offsetof(struct appdb_entry, comment)
+    .offset = offsetof(struct appdb_entry, comment),
+    .field = APPDB_FIELD_COMMENT,
+    .lazy = true
   },
   {
     .key = "Icon",
     .type = MAP_TYPE_STRING,
-    .offset = offsetof(struct appdb_entry, icon)
+    .offset = offsetof(struct appdb_entry, icon),
+    .field = APPDB_FIELD_ICON,
+    .lazy = false
   },
   {
     .key = "Exec",
     .type = MAP_TYPE_STRING,
-    .offset = offsetof(struct appdb_entry, exec)
+    .offset = offsetof(struct appdb_entry, exec),
+    .field = APPDB_FIELD_EXEC,
+    .lazy = true
   },
   {
     .key = "Path",
     .type = MAP_TYPE_STRING,
-    .offset = offsetof(struct appdb_entry, path)
+    .offset = offsetof(struct appdb_entry, path),
+    .field = APPDB_FIELD_PATH,
+    .lazy = true
   },
   {
     .key = "Terminal",
     .type = MAP_TYPE_BOOL,
-    .offset = offsetof(struct appdb_entry, terminal)
+    .offset = offsetof(struct appdb_entry, terminal),
+    .field = APPDB_FIELD_COUNT,
+    .lazy = false
+  },
+  {
+    .key = "TryExec",
+    .type = MAP_TYPE_STRING,
+    .offset = offsetof(struct appdb_entry, try_exec),
+    .field = APPDB_FIELD_TRY_EXEC,
+    .lazy = false
+  },
+  {
+    .key = "Hidden",
+    .type = MAP_TYPE_BOOL,
+    .offset = offsetof(struct appdb_entry, hidden),
+    .field = APPDB_FIELD_COUNT,
+    .lazy = false
+  },
+  {
+    .key = "NoDisplay",
+    .type = MAP_TYPE_BOOL,
+    .offset = offsetof(struct appdb_entry, no_display),
+    .field = APPDB_FIELD_COUNT,
+    .lazy = false
   },
   {
     .key = NULL,
@@ -84,7 +137,42 @@ struct appdb_kv_entry
   const char * value;
 };
 
+/* where in the .desktop file are values of fields that are not read yet */
+struct appdb_entry_lazy
+{
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  unsigned int pending;         /* bitmask of (1 << APPDB_FIELD_xxx) */
+  struct
+  {
+    off_t offset;               /* -1 if key is not present */
+    size_t length;
+  } values[APPDB_FIELD_COUNT];
+};
+
+/* keys of a group in the parsed .desktop file */
+struct appdb_kv_group
+{
+  const char * action;          /* action identifier, for the "Desktop Action" groups */
+  size_t first;                 /* index of the first key of the group */
+  size_t count;
+};
+
+struct appdb_load_context
+{
+  struct list_head * appdb;
+  unsigned int flags;           /* APPDB_LOAD_xxx */
+  appdb_stream_callback callback; /* NULL when not streaming */
+  void * callback_ctx;
+  struct appdb_hash * contents; /* content hash (hex) -> entry, for skipping of byte-identical files */
+  struct appdb_hash * previous; /* file path -> entry of the list being reloaded, NULL if not reloading */
+  struct appdb_hash * kept;     /* file path -> entry of the list being reloaded that was not changed */
+};
+
 #define MAX_ENTRIES 1000
+#define MAX_ACTIONS 64
 
 static
 const char *
@@ -134,7 +222,8 @@ static
 bool
 appdb_load_file_data(
   const char * file_path,
-  char ** data_ptr_ptr)
+  char ** data_ptr_ptr,
+  struct stat * st_ptr)
 {
   FILE * file;
   long size;
@@ -151,6 +240,12 @@ appdb_load_file_data(
     goto exit;
   }
 
+  if (fstat(fileno(file), st_ptr) != 0)
+  {
+    log_error("fstat('%s') failed", file_path);
+    goto exit_close;
+  }
+
   if (fseek(file, 0, SEEK_END) == -1)
   {
     log_error("fseek('%s') failed", file_path);
@@ -175,10 +270,11 @@ appdb_load_file_data(
   if (fseek(file, 0, SEEK_SET) == -1)
   {
     log_error("fseek('%s') failed", file_path);
-    goto exit_close;
+    goto exit_free_data;
   }
 
-  if (fread(data_ptr, size, 1, file) != 1)
+  /* files are often empty for a moment when they are being created */
+  if (size > 0 && fread(data_ptr, size, 1, file) != 1)
   {
     log_error("Failed to read %ld bytes of data from file '%s'", size, file_path);
     goto exit_free_data;
@@ -186,6 +282,11 @@ appdb_load_file_data(
 
   data_ptr[size] = 0;
 
+  if (malloc_usable_size(data_ptr) > __atomic_load_n(&g_appdb_parser_buffer_peak, __ATOMIC_RELAXED))
+  {
+    __atomic_store_n(&g_appdb_parser_buffer_peak, malloc_usable_size(data_ptr), __ATOMIC_RELAXED);
+  }
+
   *data_ptr_ptr = data_ptr;
 
   ret = true;
@@ -225,42 +326,58 @@ appdb_strrstrip(char * string)
   {
     temp--;
 
-    if (*temp == ' ' || *temp == '\t')
+    if (*temp != ' ' && *temp != '\t')
     {
-      *temp = 0;
+      break;
     }
+
+    *temp = 0;
   }
 }
 
+/* parse all groups of the .desktop file in one pass, in place */
+/* keys of the "Desktop Entry" group are first *count_ptr elements of entries_array, */
+/* keys of the "Desktop Action" groups follow them, as described by actions array */
+/* other groups are skipped */
 static
 bool
 appdb_parse_file_data(
   char * data,
   struct appdb_kv_entry * entries_array,
   size_t max_count,
-  size_t * count_ptr)
+  size_t * count_ptr,
+  struct appdb_kv_group * actions,
+  size_t max_actions,
+  size_t * actions_count_ptr)
 {
   char * line;
   char * next_line;
   char * value;
+  char * end;
   bool group_found;
+  bool skip;
   size_t count;
+  size_t actions_count;
+  struct appdb_kv_group * group_ptr;
 
   group_found = false;
+  skip = false;
   line = data;
   count = 0;
+  actions_count = 0;
+  group_ptr = NULL;             /* NULL while in the "Desktop Entry" group */
+  *count_ptr = 0;
 
   do
   {
     next_line = strchr(line, '\n');
     if (next_line != NULL)
     {
-      //log_info("there is next line");
       *next_line = 0;
       next_line++;
     }
 
-    //log_info("Line '%s'", line);
+    log_parser("Line '%s'", line);
 
     /* skip comments (and empty lines) */
     if (*line == 0 || *line == '#')
@@ -280,10 +397,62 @@ appdb_parse_file_data(
       continue;
     }
 
+    if (*line == '[')
+    {
+      if (skip)
+      {
+        skip = false;
+      }
+      else if (group_ptr == NULL)
+      {
+        *count_ptr = count;
+      }
+      else
+      {
+        group_ptr->count = count - group_ptr->first;
+      }
+
+      appdb_strrstrip(line);
+      end = line + strlen(line) - 1;
+
+      if (strncmp(line, "[Desktop Action ", 16) == 0 && *end == ']' && actions_count < max_actions)
+      {
+        *end = 0;
+        group_ptr = actions + actions_count++;
+        group_ptr->action = line + 16;
+        group_ptr->first = count;
+        group_ptr->count = 0;
+        log_parser("  Action '%s'", group_ptr->action);
+        continue;
+      }
+
+      log_parser("  Skipping group %s", line);
+
+      /* skip to the next group header without looking at the keys */
+      while (next_line != NULL && *next_line != '[')
+      {
+        next_line = strstr(next_line, "\n[");
+        if (next_line != NULL)
+        {
+          next_line++;
+        }
+      }
+
+      /* a group header is expected now, but don't attach anything else to the previous group */
+      skip = true;
+      continue;
+    }
+
+    if (skip)
+    {
+      continue;
+    }
+
     value = strchr(line, '=');
     if (value == NULL)
     {
-      goto exit;
+      log_parser("    Ignoring line without '='");
+      continue;
     }
 
     *value = 0;
@@ -293,8 +462,8 @@ appdb_parse_file_data(
     appdb_strrstrip(line);
     value = appdb_strlstrip(value);
 
-    //log_info("    Key=%s", line);
-    //log_info("    Value=%s", value);
+    log_parser("    Key=%s", line);
+    log_parser("    Value=%s", value);
 
     if (count + 1 == max_count)
     {
@@ -309,8 +478,16 @@ appdb_parse_file_data(
   }
   while ((line = next_line) != NULL);
 
-exit:
-  *count_ptr = count;
+  if (!skip && group_ptr == NULL)
+  {
+    *count_ptr = count;
+  }
+  else if (!skip)
+  {
+    group_ptr->count = count - group_ptr->first;
+  }
+
+  *actions_count_ptr = actions_count;
 
   return group_found;
 }
@@ -335,188 +512,640 @@ appdb_find_key(
   return NULL;
 }
 
+static
+void
+appdb_lazy_set_identity(
+  struct appdb_entry_lazy * lazy_ptr,
+  const struct stat * st_ptr)
+{
+  lazy_ptr->dev = st_ptr->st_dev;
+  lazy_ptr->ino = st_ptr->st_ino;
+  lazy_ptr->size = st_ptr->st_size;
+  lazy_ptr->mtime = st_ptr->st_mtim;
+}
+
 static
 bool
-appdb_load_file(
-  struct list_head * appdb,
-  const char * file_path)
+appdb_lazy_identity_match(
+  const struct appdb_entry_lazy * lazy_ptr,
+  const struct stat * st_ptr)
+{
+  return
+    lazy_ptr->dev == st_ptr->st_dev &&
+    lazy_ptr->ino == st_ptr->st_ino &&
+    lazy_ptr->size == st_ptr->st_size &&
+    lazy_ptr->mtime.tv_sec == st_ptr->st_mtim.tv_sec &&
+    lazy_ptr->mtime.tv_nsec == st_ptr->st_mtim.tv_nsec;
+}
+
+/* data is the (parsed in place) file contents, value points inside it or is NULL */
+static
+void
+appdb_lazy_set_value(
+  struct appdb_entry_lazy * lazy_ptr,
+  unsigned int field,
+  const char * data,
+  const char * value)
+{
+  if (value == NULL)
+  {
+    lazy_ptr->values[field].offset = -1;
+    lazy_ptr->values[field].length = 0;
+    return;
+  }
+
+  lazy_ptr->values[field].offset = value - data;
+  lazy_ptr->values[field].length = strlen(value);
+}
+
+static
+bool
+appdb_is_true(
+  const char * value)
+{
+  return value != NULL && (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+}
+
+/* session management keys: X-LASH and LASHCLASS for LASH/LADISH, X-NSM-Capable and X-NSM-Exec for NSM */
+static
+bool
+appdb_load_session_keys(
+  struct appdb_entry * entry_ptr,
+  struct appdb_kv_entry * entries,
+  size_t entries_count)
 {
-  char * data;
-  bool ret;
-  struct appdb_kv_entry entries[MAX_ENTRIES];
-  size_t entries_count;
-  const char * value;
-  const char * name;
   const char * xlash;
-  struct list_head * node_ptr;
-  struct appdb_entry * entry_ptr;
-  struct appdb_map * map_ptr;
-  char ** str_ptr_ptr;
-  bool * bool_ptr;
+  const char * lash_class;
+  const char * nsm_exec;
 
-  //log_info("=========================");
-  //log_info("Desktop entry '%s'", file_path);
+  xlash = appdb_find_key(entries, entries_count, "X-LASH");
+  lash_class = appdb_find_key(entries, entries_count, "LASHCLASS");
 
-  ret = true;
+  /* X-LASH is usually "true", presence of LASHCLASS implies LASH support too */
+  if ((xlash != NULL && strcmp(xlash, "false") != 0) || lash_class != NULL)
+  {
+    entry_ptr->session_protocols |= APPDB_SESSION_LASH;
+  }
 
-  if (!appdb_load_file_data(file_path, &data))
+  if (appdb_is_true(appdb_find_key(entries, entries_count, "X-NSM-Capable")))
   {
-    ret = false;
-    goto exit;
+    entry_ptr->session_protocols |= APPDB_SESSION_NSM;
   }
 
-  if (data == NULL)
+  if (lash_class != NULL)
   {
-    goto exit;
+    entry_ptr->lash_class = strdup(lash_class);
+    if (entry_ptr->lash_class == NULL)
+    {
+      log_error("strdup() failed");
+      return false;
+    }
   }
 
-  if (!appdb_parse_file_data(data, entries, MAX_ENTRIES, &entries_count))
+  nsm_exec = appdb_find_key(entries, entries_count, "X-NSM-Exec");
+  if (nsm_exec != NULL && (entry_ptr->session_protocols & APPDB_SESSION_NSM) != 0)
   {
-    goto exit_free_data;
+    entry_ptr->nsm_exec = strdup(nsm_exec);
+    if (entry_ptr->nsm_exec == NULL)
+    {
+      log_error("strdup() failed");
+      return false;
+    }
   }
 
-  //log_info("%llu entries", (unsigned long long)entries_count);
+  return true;
+}
 
-  /* check whether entry is of "Application" type */
-  value = appdb_find_key(entries, entries_count, "Type");
-  if (value == NULL || strcmp(value, "Application") != 0)
+static
+const struct appdb_kv_group *
+appdb_find_action(
+  const struct appdb_kv_group * actions,
+  size_t actions_count,
+  const char * id)
+{
+  size_t i;
+
+  for (i = 0; i < actions_count; i++)
   {
-    goto exit_free_data;
+    if (strcmp(actions[i].action, id) == 0)
+    {
+      return actions + i;
+    }
   }
 
-  /* check whether "Name" is preset, it is required */
-  name = appdb_find_key(entries, entries_count, "Name");
-  if (name == NULL)
+  return NULL;
+}
+
+static
+char *
+appdb_action_copy_string(
+  char ** dst_ptr_ptr,
+  const char * value)
+{
+  char * copy;
+  size_t len;
+
+  if (value == NULL)
   {
-    goto exit_free_data;
+    return NULL;
   }
 
-  /* check whether entry has LIBLASH or LASHCLASS key */
-  xlash = appdb_find_key(entries, entries_count, "X-LASH");
-  if (xlash == NULL)
+  len = strlen(value) + 1;
+  copy = *dst_ptr_ptr;
+  memcpy(copy, value, len);
+  *dst_ptr_ptr += len;
+
+  return copy;
+}
+
+/* attach actions listed in the Actions key, the array and the strings are allocated as one block */
+/* actions without group or without name are ignored, as the specification requires */
+static
+bool
+appdb_load_actions(
+  struct appdb_entry * entry_ptr,
+  struct appdb_kv_entry * entries,
+  const char * actions_value,
+  const struct appdb_kv_group * actions,
+  size_t actions_count)
+{
+  char ** ids;
+  char ** id_ptr;
+  const struct appdb_kv_group * group_ptr;
+  const char * name;
+  const char * icon;
+  const char * exec;
+  size_t count;
+  size_t size;
+  struct appdb_action * action_ptr;
+  char * strings;
+  bool ret;
+
+  ids = appdb_strlist_split(actions_value);
+  if (ids == NULL)
   {
-    //goto exit_free_data;
+    return false;
   }
 
-  /* check whether entry already exists (first found entries have priority according to XDG Base Directory Specification) */
-  list_for_each(node_ptr, appdb)
+  /* first pass calculates the size */
+  count = 0;
+  size = 0;
+  for (id_ptr = ids; *id_ptr != NULL; id_ptr++)
   {
-    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+    group_ptr = appdb_find_action(actions, actions_count, *id_ptr);
+    if (group_ptr == NULL)
+    {
+      log_debug("No group for action '%s' of '%s'", *id_ptr, entry_ptr->name);
+      continue;
+    }
 
-    if (strcmp(entry_ptr->name, name) == 0)
+    name = appdb_find_key(entries + group_ptr->first, group_ptr->count, "Name");
+    if (name == NULL)
     {
-      goto exit_free_data;
+      log_debug("Action '%s' of '%s' has no name", *id_ptr, entry_ptr->name);
+      continue;
     }
+
+    icon = appdb_find_key(entries + group_ptr->first, group_ptr->count, "Icon");
+    exec = appdb_find_key(entries + group_ptr->first, group_ptr->count, "Exec");
+
+    count++;
+    size += sizeof(struct appdb_action) + strlen(*id_ptr) + 1 + strlen(name) + 1;
+    size += icon != NULL ? strlen(icon) + 1 : 0;
+    size += exec != NULL ? strlen(exec) + 1 : 0;
   }
 
-  log_info("Application '%s' found", name);
+  ret = true;
 
-  /* allocate new entry */
-  entry_ptr = malloc(sizeof(struct appdb_entry));
-  if (entry_ptr == NULL)
+  if (count == 0)
   {
-    log_error("malloc() failed");
-    goto fail_free_data;
+    goto exit;
   }
 
-  memset(entry_ptr, 0, sizeof(struct appdb_entry));
+  entry_ptr->actions = malloc(size);
+  if (entry_ptr->actions == NULL)
+  {
+    log_error("malloc() failed");
+    ret = false;
+    goto exit;
+  }
 
-  /* fill the entry */
-  map_ptr = g_appdb_entry_map;
-  while (map_ptr->key != NULL)
+  /* second pass fills the block */
+  action_ptr = entry_ptr->actions;
+  strings = (char *)(entry_ptr->actions + count);
+  for (id_ptr = ids; *id_ptr != NULL; id_ptr++)
   {
-    value = appdb_find_key(entries, entries_count, map_ptr->key);
-    if (value == NULL)
+    group_ptr = appdb_find_action(actions, actions_count, *id_ptr);
+    if (group_ptr == NULL)
     {
-      ASSERT(strcmp(map_ptr->key, "Name") != 0); /* name is required and we already checked this */
-      map_ptr++;  
       continue;
     }
 
-    //log_info("mapping key '%s' to '%s'", map_ptr->key, value);
-
-    if (map_ptr->type == MAP_TYPE_STRING)
-    {
-      str_ptr_ptr = (char **)((char *)entry_ptr + map_ptr->offset);
-      *str_ptr_ptr = strdup(value);
-      if (*str_ptr_ptr == NULL)
-      {
-        log_error("strdup() failed");
-        goto fail_free_entry;
-      }
-    }
-    else if (map_ptr->type == MAP_TYPE_BOOL)
-    {
-      bool_ptr = (bool *)((char *)entry_ptr + map_ptr->offset);
-      if (strcmp(value, "true") == 0)
-      {
-        *bool_ptr = true;
-      }
-      else if (strcmp(value, "false") == 0)
-      {
-        *bool_ptr = false;
-      }
-      else
-      {
-        log_error("Ignoring %s:%s bool with wrong value '%s'", name, map_ptr->key, value);
-      }
-    }
-    else
+    name = appdb_find_key(entries + group_ptr->first, group_ptr->count, "Name");
+    if (name == NULL)
     {
-      ASSERT_NO_PASS;
-      goto fail_free_entry;
+      continue;
     }
 
-    map_ptr++;
+    action_ptr->id = appdb_action_copy_string(&strings, *id_ptr);
+    action_ptr->name = appdb_action_copy_string(&strings, name);
+    action_ptr->icon = appdb_action_copy_string(&strings, appdb_find_key(entries + group_ptr->first, group_ptr->count, "Icon"));
+    action_ptr->exec = appdb_action_copy_string(&strings, appdb_find_key(entries + group_ptr->first, group_ptr->count, "Exec"));
+    action_ptr++;
   }
 
-  /* add entry to appdb list */
-  list_add_tail(&entry_ptr->siblings, appdb);
-
-  goto exit_free_data;
-
-fail_free_entry:
-  appdb_free_entry(entry_ptr);
-
-fail_free_data:
-  ret = false;
-
-exit_free_data:
-  free(data);
+  entry_ptr->actions_count = count;
 
 exit:
+  free(ids);
   return ret;
 }
 
 static
 bool
-appdb_load_dir(
+appdb_name_exists(
   struct list_head * appdb,
-  const char * base_directory)
+  const char * name)
 {
-  char * directory_path;
-  bool ret;
-  DIR * dir;
-  struct dirent * dentry_ptr;
-  char * file_path;
-
-  //log_info("appdb_load_dir() called for '%s'.", base_directory);
-
-  ret = false;
+  struct list_head * node_ptr;
 
-  directory_path = catdup(base_directory, "/applications/");
-  if (directory_path == NULL)
+  list_for_each(node_ptr, appdb)
   {
-    log_error("catdup() failed to compose the appdb dir path");
-    goto fail;
+    if (strcmp(list_entry(node_ptr, struct appdb_entry, siblings)->name, name) == 0)
+    {
+      return true;
+    }
   }
 
-  //log_info("Scanning directory '%s'", directory_path);
+  return false;
+}
 
-  dir = opendir(directory_path);
-  if (dir != NULL)
-  {
-    while ((dentry_ptr = readdir(dir)) != NULL)
+static
+void
+appdb_content_key(
+  char * key,
+  uint64_t content_hash)
+{
+  sprintf(key, "%016llx", (unsigned long long)content_hash);
+}
+
+/* when reloading, reuse entry of unchanged file; returns true if file was handled */
+static
+bool
+appdb_load_file_unchanged(
+  struct appdb_load_context * ctx_ptr,
+  const char * file_path,
+  uint64_t content_hash,
+  const struct stat * st_ptr)
+{
+  struct appdb_entry * entry_ptr;
+  char key[17];
+
+  if (ctx_ptr->previous == NULL)
+  {
+    return false;
+  }
+
+  entry_ptr = appdb_hash_get(ctx_ptr->previous, file_path);
+  if (entry_ptr == NULL || entry_ptr->content_hash != content_hash)
+  {
+    return false;
+  }
+
+  log_debug("'%s' is not changed", file_path);
+
+  /* file can be shadowed now, by new file in directory of higher precedence */
+  if (appdb_name_exists(ctx_ptr->appdb, entry_ptr->name))
+  {
+    return true;
+  }
+
+  appdb_hash_remove(ctx_ptr->previous, file_path);
+  if (!appdb_hash_set(ctx_ptr->kept, file_path, entry_ptr))
+  {
+    /* entry is still in the old list, it will be reported as removed */
+    return true;
+  }
+
+  list_move_tail(&entry_ptr->siblings, ctx_ptr->appdb);
+
+  if (entry_ptr->lazy != NULL)
+  {
+    /* offsets of the values are still valid */
+    appdb_lazy_set_identity(entry_ptr->lazy, st_ptr);
+  }
+
+  appdb_content_key(key, content_hash);
+  appdb_hash_set(ctx_ptr->contents, key, entry_ptr);
+
+  return true;
+}
+
+static
+bool
+appdb_load_file(
+  struct appdb_load_context * ctx_ptr,
+  const char * file_path)
+{
+  char * data;
+  struct stat st;
+  bool ret;
+  struct appdb_kv_entry entries[MAX_ENTRIES];
+  size_t entries_count;
+  struct appdb_kv_group actions[MAX_ACTIONS];
+  size_t actions_count;
+  const char * value;
+  const char * name;
+  struct appdb_entry * entry_ptr;
+  struct appdb_map * map_ptr;
+  char ** str_ptr_ptr;
+  bool * bool_ptr;
+  bool lazy;
+  uint64_t content_hash;
+  char content_key[17];
+  off_t size;
+
+  log_debug("Desktop entry '%s'", file_path);
+
+  ret = true;
+  size = -1;
+
+  /* file that can't be read (for example because it was just deleted) is skipped */
+  if (!appdb_load_file_data(file_path, &data, &st))
+  {
+    goto exit;
+  }
+
+  size = st.st_size;
+
+  if (data == NULL)
+  {
+    goto exit;
+  }
+
+  content_hash = appdb_digest64(data, strlen(data), 0);
+
+  if (appdb_load_file_unchanged(ctx_ptr, file_path, content_hash, &st))
+  {
+    goto exit_free_data;
+  }
+
+  /* byte-identical copy of already loaded file would be rejected as duplicate, so don't parse it */
+  appdb_content_key(content_key, content_hash);
+  entry_ptr = appdb_hash_get(ctx_ptr->contents, content_key);
+  if (entry_ptr != NULL)
+  {
+    log_debug("'%s' is same as '%s'", file_path, entry_ptr->file_path);
+    APPDB_PROBE2(dedupe__content, file_path, entry_ptr->file_path);
+    goto exit_free_data;
+  }
+
+  if (!appdb_parse_file_data(data, entries, MAX_ENTRIES, &entries_count, actions, MAX_ACTIONS, &actions_count))
+  {
+    APPDB_PROBE2(parse__error, file_path, "invalid desktop entry");
+    goto exit_free_data;
+  }
+
+  log_parser("%zu keys", entries_count);
+
+  /* check whether entry is of "Application" type */
+  value = appdb_find_key(entries, entries_count, "Type");
+  if (value == NULL || strcmp(value, "Application") != 0)
+  {
+    goto exit_free_data;
+  }
+
+  /* check whether "Name" is preset, it is required */
+  name = appdb_find_key(entries, entries_count, "Name");
+  if (name == NULL)
+  {
+    goto exit_free_data;
+  }
+
+  /* check whether entry already exists (first found entries have priority according to XDG Base Directory Specification) */
+  if (appdb_name_exists(ctx_ptr->appdb, name))
+  {
+    APPDB_PROBE2(dedupe__name, file_path, name);
+    goto exit_free_data;
+  }
+
+  log_info("Application '%s' found", name);
+
+  /* allocate new entry */
+  entry_ptr = malloc(sizeof(struct appdb_entry));
+  if (entry_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    goto fail_free_data;
+  }
+
+  memset(entry_ptr, 0, sizeof(struct appdb_entry));
+  entry_ptr->content_hash = content_hash;
+
+  entry_ptr->file_path = strdup(file_path);
+  if (entry_ptr->file_path == NULL)
+  {
+    log_error("strdup() failed");
+    goto fail_free_entry;
+  }
+
+  /* desktop file ID, the name relative to the applications directory */
+  entry_ptr->desktop_id = strdup(strrchr(file_path, '/') + 1);
+  if (entry_ptr->desktop_id == NULL)
+  {
+    log_error("strdup() failed");
+    goto fail_free_entry;
+  }
+
+  lazy = (ctx_ptr->flags & APPDB_LOAD_LAZY) != 0;
+  if (lazy)
+  {
+    entry_ptr->lazy = malloc(sizeof(struct appdb_entry_lazy));
+    if (entry_ptr->lazy == NULL)
+    {
+      log_error("malloc() failed");
+      goto fail_free_entry;
+    }
+
+    appdb_lazy_set_identity(entry_ptr->lazy, &st);
+    entry_ptr->lazy->pending = 0;
+  }
+
+  /* fill the entry */
+  map_ptr = g_appdb_entry_map;
+  while (map_ptr->key != NULL)
+  {
+    value = appdb_find_key(entries, entries_count, map_ptr->key);
+
+    if (lazy && map_ptr->lazy)
+    {
+      /* remember where the value is, it will be read by appdb_entry_get() */
+      appdb_lazy_set_value(entry_ptr->lazy, map_ptr->field, data, value);
+      entry_ptr->lazy->pending |= 1U << map_ptr->field;
+      map_ptr++;
+      continue;
+    }
+
+    if (value == NULL)
+    {
+      ASSERT(strcmp(map_ptr->key, "Name") != 0); /* name is required and we already checked this */
+      map_ptr++;
+      continue;
+    }
+
+    log_parser("mapping key '%s' to '%s'", map_ptr->key, value);
+
+    if (map_ptr->type == MAP_TYPE_STRING)
+    {
+      str_ptr_ptr = (char **)((char *)entry_ptr + map_ptr->offset);
+      *str_ptr_ptr = strdup(value);
+      if (*str_ptr_ptr == NULL)
+      {
+        log_error("strdup() failed");
+        goto fail_free_entry;
+      }
+    }
+    else if (map_ptr->type == MAP_TYPE_BOOL)
+    {
+      bool_ptr = (bool *)((char *)entry_ptr + map_ptr->offset);
+      if (strcmp(value, "true") == 0)
+      {
+        *bool_ptr = true;
+      }
+      else if (strcmp(value, "false") == 0)
+      {
+        *bool_ptr = false;
+      }
+      else
+      {
+        log_error("Ignoring %s:%s bool with wrong value '%s'", name, map_ptr->key, value);
+        APPDB_PROBE2(parse__error, file_path, "invalid boolean value");
+      }
+    }
+    else
+    {
+      ASSERT_NO_PASS;
+      goto fail_free_entry;
+    }
+
+    map_ptr++;
+  }
+
+  if (entry_ptr->exec != NULL)
+  {
+    /* failure is logged, entry without valid exec is still useful for listing */
+    entry_ptr->exec_argv = appdb_exec_tokenize(entry_ptr->exec);
+  }
+
+  if (!appdb_load_session_keys(entry_ptr, entries, entries_count))
+  {
+    goto fail_free_entry;
+  }
+
+  value = appdb_find_key(entries, entries_count, "Actions");
+  if (value != NULL && !appdb_load_actions(entry_ptr, entries, value, actions, actions_count))
+  {
+    goto fail_free_entry;
+  }
+
+  /* categories and mime types are needed for building of the indexes, so they are never lazy */
+  value = appdb_find_key(entries, entries_count, "Categories");
+  if (value != NULL)
+  {
+    entry_ptr->categories = appdb_strlist_split(value);
+    if (entry_ptr->categories == NULL)
+    {
+      goto fail_free_entry;
+    }
+  }
+
+  value = appdb_find_key(entries, entries_count, "MimeType");
+  if (value != NULL)
+  {
+    entry_ptr->mime_types = appdb_strlist_split(value);
+    if (entry_ptr->mime_types == NULL)
+    {
+      goto fail_free_entry;
+    }
+  }
+
+  value = appdb_find_key(entries, entries_count, "OnlyShowIn");
+  if (value != NULL)
+  {
+    entry_ptr->only_show_in = appdb_strlist_split(value);
+    if (entry_ptr->only_show_in == NULL)
+    {
+      goto fail_free_entry;
+    }
+  }
+
+  value = appdb_find_key(entries, entries_count, "NotShowIn");
+  if (value != NULL)
+  {
+    entry_ptr->not_show_in = appdb_strlist_split(value);
+    if (entry_ptr->not_show_in == NULL)
+    {
+      goto fail_free_entry;
+    }
+  }
+
+  /* add entry to appdb list */
+  list_add_tail(&entry_ptr->siblings, ctx_ptr->appdb);
+
+  if (!appdb_hash_set(ctx_ptr->contents, content_key, entry_ptr))
+  {
+    ret = false;
+  }
+
+  if (ctx_ptr->callback != NULL)
+  {
+    ctx_ptr->callback(ctx_ptr->callback_ctx, APPDB_STREAM_ADD, entry_ptr);
+  }
+
+  goto exit_free_data;
+
+fail_free_entry:
+  appdb_free_entry(entry_ptr);
+
+fail_free_data:
+  ret = false;
+
+exit_free_data:
+  free(data);
+
+exit:
+  APPDB_PROBE3(load__file, file_path, size, ret);
+  return ret;
+}
+
+static
+bool
+appdb_load_dir(
+  struct appdb_load_context * ctx_ptr,
+  const char * base_directory)
+{
+  char * directory_path;
+  bool ret;
+  DIR * dir;
+  struct dirent * dentry_ptr;
+  char * file_path;
+
+  ret = false;
+
+  directory_path = catdup(base_directory, "/applications/");
+  if (directory_path == NULL)
+  {
+    log_error("catdup() failed to compose the appdb dir path");
+    goto fail;
+  }
+
+  log_debug("Scanning directory '%s'", directory_path);
+  APPDB_PROBE1(load__dir__start, directory_path);
+
+  dir = opendir(directory_path);
+  if (dir != NULL)
+  {
+    while ((dentry_ptr = readdir(dir)) != NULL)
     {
       if (dentry_ptr->d_type != DT_REG)
       {
@@ -535,7 +1164,7 @@ appdb_load_dir(
       }
       else
       {
-        if (!appdb_load_file(appdb, file_path))
+        if (!appdb_load_file(ctx_ptr, file_path))
         {
           free(file_path);
           goto fail_free_path;
@@ -549,21 +1178,23 @@ appdb_load_dir(
   }
   else
   {
-    //log_info("failed to open directory '%s'", directory_path);
+    log_debug("failed to open directory '%s'", directory_path);
   }
 
   ret = true;
 
 fail_free_path:
+  APPDB_PROBE2(load__dir__done, directory_path, ret);
   free(directory_path);
 
 fail:
   return ret;
 }
 
+static
 bool
 appdb_load_dirs(
-  struct list_head * appdb,
+  struct appdb_load_context * ctx_ptr,
   const char * base_directories)
 {
   char * limiter;
@@ -587,7 +1218,7 @@ appdb_load_dirs(
       *limiter = 0;
     }
 
-    if (!appdb_load_dir(appdb, directory))
+    if (!appdb_load_dir(ctx_ptr, directory))
     {
       free(directories);
       return false;
@@ -605,6 +1236,23 @@ appdb_load_dirs(
 bool
 appdb_load(
   struct list_head * appdb)
+{
+  return appdb_load_ex(appdb, 0);
+}
+
+bool
+appdb_load_ex(
+  struct list_head * appdb,
+  unsigned int flags)
+{
+  return appdb_load_stream(appdb, flags, NULL, NULL);
+}
+
+/* scan the XDG data directories, ctx_ptr->appdb list is expected to be initialized */
+static
+bool
+appdb_load_scan(
+  struct appdb_load_context * ctx_ptr)
 {
   const char * data_home;
   char * data_home_default;
@@ -614,34 +1262,38 @@ appdb_load(
 
   ret = false;
 
-  INIT_LIST_HEAD(appdb);
+  APPDB_PROBE2(load__start, ctx_ptr->flags, ctx_ptr->previous != NULL);
 
-  //log_info("appdb_load() called.");
+  ctx_ptr->contents = appdb_hash_new(NULL);
+  if (ctx_ptr->contents == NULL)
+  {
+    goto fail;
+  }
 
   home_dir = getenv("HOME");
   if (home_dir == NULL)
   {
     log_error("HOME environment variable is not set.");
-    goto fail;
+    goto fail_destroy_contents;
   }
 
   data_home_default = catdup(home_dir, "/.local/share");
   if (data_home_default == NULL)
   {
     log_error("catdup failed to compose data_home_default");
-    goto fail;
+    goto fail_destroy_contents;
   }
 
   data_home = appdb_get_xdg_var("XDG_DATA_HOME", data_home_default);
 
-  if (!appdb_load_dir(appdb, data_home))
+  if (!appdb_load_dir(ctx_ptr, data_home))
   {
     goto fail_free_data_home_default;
   }
 
   data_dirs = appdb_get_xdg_var("XDG_DATA_DIRS", "/usr/local/share/:/usr/share/");
 
-  if (!appdb_load_dirs(appdb, data_dirs))
+  if (!appdb_load_dirs(ctx_ptr, data_dirs))
   {
     goto fail_free_data_home_default;
   }
@@ -651,22 +1303,386 @@ appdb_load(
 fail_free_data_home_default:
   free(data_home_default);
 
+fail_destroy_contents:
+  appdb_hash_destroy(ctx_ptr->contents);
+  ctx_ptr->contents = NULL;
+
 fail:
+  APPDB_PROBE1(load__done, ret);
+  return ret;
+}
+
+static
+void
+appdb_retract_all(
+  struct list_head * appdb,
+  appdb_stream_callback callback,
+  void * callback_ctx)
+{
+  struct list_head * node_ptr;
+
+  if (callback == NULL)
+  {
+    return;
+  }
+
+  list_for_each(node_ptr, appdb)
+  {
+    callback(callback_ctx, APPDB_STREAM_RETRACT, list_entry(node_ptr, struct appdb_entry, siblings));
+  }
+}
+
+bool
+appdb_load_stream(
+  struct list_head * appdb,
+  unsigned int flags,
+  appdb_stream_callback callback,
+  void * callback_ctx)
+{
+  struct appdb_load_context ctx;
+
+  INIT_LIST_HEAD(appdb);
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.appdb = appdb;
+  ctx.flags = flags;
+  ctx.callback = callback;
+  ctx.callback_ctx = callback_ctx;
+
+  if (!appdb_load_scan(&ctx))
+  {
+    appdb_retract_all(appdb, callback, callback_ctx);
+    appdb_free(appdb);
+    return false;
+  }
+
+  return true;
+}
+
+bool
+appdb_reload(
+  struct list_head * appdb,
+  unsigned int flags,
+  appdb_stream_callback callback,
+  void * callback_ctx)
+{
+  struct appdb_load_context ctx;
+  struct list_head old;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  bool ret;
+
+  ret = false;
+
+  INIT_LIST_HEAD(&old);
+  list_splice_init(appdb, &old);
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.appdb = appdb;
+  ctx.flags = flags;
+
+  ctx.previous = appdb_hash_new(NULL);
+  ctx.kept = appdb_hash_new(NULL);
+  if (ctx.previous == NULL || ctx.kept == NULL)
+  {
+    goto exit;
+  }
+
+  list_for_each(node_ptr, &old)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+    if (!appdb_hash_set(ctx.previous, entry_ptr->file_path, entry_ptr))
+    {
+      goto exit;
+    }
+  }
+
+  ret = appdb_load_scan(&ctx);
+
+exit:
   if (!ret)
   {
+    /* everything that was reported before is removed, entries not reported yet are just freed */
+    appdb_retract_all(&old, callback, callback_ctx);
+
+    list_for_each(node_ptr, appdb)
+    {
+      entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+      if (callback != NULL && appdb_hash_get(ctx.kept, entry_ptr->file_path) == entry_ptr)
+      {
+        callback(callback_ctx, APPDB_STREAM_RETRACT, entry_ptr);
+      }
+    }
+
     appdb_free(appdb);
+    appdb_free(&old);
+    goto destroy_hashes;
   }
 
+  /* removals are reported first, so a changed entry is reported as removed and then added */
+  appdb_retract_all(&old, callback, callback_ctx);
+  appdb_free(&old);
+
+  if (callback != NULL)
+  {
+    list_for_each(node_ptr, appdb)
+    {
+      entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+      if (appdb_hash_get(ctx.kept, entry_ptr->file_path) != entry_ptr)
+      {
+        callback(callback_ctx, APPDB_STREAM_ADD, entry_ptr);
+      }
+    }
+  }
+
+destroy_hashes:
+  appdb_hash_destroy(ctx.previous);
+  appdb_hash_destroy(ctx.kept);
+  return ret;
+}
+
+/* called when the .desktop file changed after the scan, to refresh location of the pending values */
+static
+bool
+appdb_entry_rescan(
+  struct appdb_entry * entry_ptr)
+{
+  char * data;
+  struct stat st;
+  struct appdb_kv_entry entries[MAX_ENTRIES];
+  size_t entries_count;
+  struct appdb_kv_group actions[MAX_ACTIONS];
+  size_t actions_count;
+  const struct appdb_map * map_ptr;
+  bool ret;
+
+  log_debug("'%s' changed since it was scanned", entry_ptr->file_path);
+
+  if (!appdb_load_file_data(entry_ptr->file_path, &data, &st))
+  {
+    return false;
+  }
+
+  ret = appdb_parse_file_data(data, entries, MAX_ENTRIES, &entries_count, actions, MAX_ACTIONS, &actions_count);
+  if (!ret)
+  {
+    log_error("'%s' is not a desktop entry anymore", entry_ptr->file_path);
+    goto exit;
+  }
+
+  appdb_lazy_set_identity(entry_ptr->lazy, &st);
+
+  for (map_ptr = g_appdb_entry_map; map_ptr->key != NULL; map_ptr++)
+  {
+    if (map_ptr->lazy)
+    {
+      appdb_lazy_set_value(
+        entry_ptr->lazy,
+        map_ptr->field,
+        data,
+        appdb_find_key(entries, entries_count, map_ptr->key));
+    }
+  }
+
+exit:
+  free(data);
+  return ret;
+}
+
+static
+bool
+appdb_entry_read_field(
+  struct appdb_entry * entry_ptr,
+  const struct appdb_map * map_ptr)
+{
+  struct appdb_entry_lazy * lazy_ptr;
+  int fd;
+  struct stat st;
+  bool rescanned;
+  char * value;
+  bool ret;
+
+  lazy_ptr = entry_ptr->lazy;
+  rescanned = false;
+
+  for (;;)
+  {
+    fd = open(entry_ptr->file_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+      log_error("Failed to open '%s' for reading", entry_ptr->file_path);
+      return false;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+      log_error("fstat('%s') failed", entry_ptr->file_path);
+      ret = false;
+      goto exit_close;
+    }
+
+    if (appdb_lazy_identity_match(lazy_ptr, &st))
+    {
+      break;
+    }
+
+    close(fd);
+
+    if (rescanned || !appdb_entry_rescan(entry_ptr))
+    {
+      return false;
+    }
+
+    rescanned = true;
+  }
+
+  value = NULL;
+
+  if (lazy_ptr->values[map_ptr->field].offset != -1)
+  {
+    value = malloc(lazy_ptr->values[map_ptr->field].length + 1);
+    if (value == NULL)
+    {
+      log_error("malloc() failed");
+      ret = false;
+      goto exit_close;
+    }
+
+    if (pread(fd, value, lazy_ptr->values[map_ptr->field].length, lazy_ptr->values[map_ptr->field].offset) !=
+        (ssize_t)lazy_ptr->values[map_ptr->field].length)
+    {
+      log_error("Failed to read %s value from '%s'", map_ptr->key, entry_ptr->file_path);
+      free(value);
+      ret = false;
+      goto exit_close;
+    }
+
+    value[lazy_ptr->values[map_ptr->field].length] = 0;
+  }
+
+  *(char **)((char *)entry_ptr + map_ptr->offset) = value;
+  lazy_ptr->pending &= ~(1U << map_ptr->field);
+
+  if (map_ptr->field == APPDB_FIELD_EXEC && value != NULL)
+  {
+    entry_ptr->exec_argv = appdb_exec_tokenize(value);
+  }
+  ret = true;
+
+exit_close:
+  close(fd);
   return ret;
 }
 
+const char *
+appdb_entry_get(
+  struct appdb_entry * entry_ptr,
+  unsigned int field)
+{
+  const struct appdb_map * map_ptr;
+
+  for (map_ptr = g_appdb_entry_map; map_ptr->key != NULL; map_ptr++)
+  {
+    if (map_ptr->type == MAP_TYPE_STRING && map_ptr->field == field)
+    {
+      break;
+    }
+  }
+
+  if (map_ptr->key == NULL)
+  {
+    log_error("Unknown appdb entry field %u", field);
+    return NULL;
+  }
+
+  if (entry_ptr->lazy != NULL &&
+      (entry_ptr->lazy->pending & (1U << field)) != 0 &&
+      !appdb_entry_read_field(entry_ptr, map_ptr))
+  {
+    return NULL;
+  }
+
+  return *(char **)((char *)entry_ptr + map_ptr->offset);
+}
+
+size_t
+appdb_entry_memory(
+  struct appdb_entry * entry_ptr,
+  size_t * usage)
+{
+  size_t sizes[APPDB_MEMORY_COUNT];
+  size_t total;
+  unsigned int i;
+
+  sizes[APPDB_FIELD_NAME] = malloc_usable_size(entry_ptr->name);
+  sizes[APPDB_FIELD_GENERIC_NAME] = malloc_usable_size(entry_ptr->generic_name);
+  sizes[APPDB_FIELD_COMMENT] = malloc_usable_size(entry_ptr->comment);
+  sizes[APPDB_FIELD_ICON] = malloc_usable_size(entry_ptr->icon);
+  sizes[APPDB_FIELD_EXEC] = malloc_usable_size(entry_ptr->exec);
+  sizes[APPDB_FIELD_PATH] = malloc_usable_size(entry_ptr->path);
+  sizes[APPDB_FIELD_TRY_EXEC] = malloc_usable_size(entry_ptr->try_exec);
+  sizes[APPDB_MEMORY_ENTRY] = malloc_usable_size(entry_ptr) + malloc_usable_size(entry_ptr->lazy);
+  sizes[APPDB_MEMORY_FILE_PATH] = malloc_usable_size(entry_ptr->file_path) + malloc_usable_size(entry_ptr->desktop_id);
+  /* lists and actions are allocated as single blocks, including the strings */
+  sizes[APPDB_MEMORY_EXEC_ARGV] = malloc_usable_size(entry_ptr->exec_argv);
+  sizes[APPDB_MEMORY_MIME_TYPES] = malloc_usable_size(entry_ptr->mime_types);
+  sizes[APPDB_MEMORY_CATEGORIES] = malloc_usable_size(entry_ptr->categories);
+  sizes[APPDB_MEMORY_SESSION] = malloc_usable_size(entry_ptr->lash_class) + malloc_usable_size(entry_ptr->nsm_exec);
+  sizes[APPDB_MEMORY_ACTIONS] = malloc_usable_size(entry_ptr->actions);
+  sizes[APPDB_MEMORY_SHOW_IN] = malloc_usable_size(entry_ptr->only_show_in) + malloc_usable_size(entry_ptr->not_show_in);
+
+  total = 0;
+  for (i = 0; i < APPDB_MEMORY_COUNT; i++)
+  {
+    usage[i] += sizes[i];
+    total += sizes[i];
+  }
+
+  return total;
+}
+
+const char *
+appdb_memory_category_name(
+  unsigned int category)
+{
+  static const char * const names[APPDB_MEMORY_COUNT] =
+  {
+    [APPDB_FIELD_NAME] = "name",
+    [APPDB_FIELD_GENERIC_NAME] = "generic_name",
+    [APPDB_FIELD_COMMENT] = "comment",
+    [APPDB_FIELD_ICON] = "icon",
+    [APPDB_FIELD_EXEC] = "exec",
+    [APPDB_FIELD_PATH] = "path",
+    [APPDB_FIELD_TRY_EXEC] = "try_exec",
+    [APPDB_MEMORY_ENTRY] = "entry",
+    [APPDB_MEMORY_FILE_PATH] = "file_path",
+    [APPDB_MEMORY_EXEC_ARGV] = "exec_argv",
+    [APPDB_MEMORY_MIME_TYPES] = "mime_types",
+    [APPDB_MEMORY_CATEGORIES] = "categories",
+    [APPDB_MEMORY_SESSION] = "session",
+    [APPDB_MEMORY_ACTIONS] = "actions",
+    [APPDB_MEMORY_SHOW_IN] = "show_in",
+  };
+
+  if (category >= APPDB_MEMORY_COUNT)
+  {
+    return NULL;
+  }
+
+  return names[category];
+}
+
+size_t
+appdb_parser_buffer_peak(void)
+{
+  return __atomic_load_n(&g_appdb_parser_buffer_peak, __ATOMIC_RELAXED);
+}
+
 static
 void
 appdb_free_entry(
   struct appdb_entry * entry_ptr)
 {
-  //log_info("appdb_free_entry() called.");
-
   if (entry_ptr->name != NULL)
   {
     free(entry_ptr->name);
@@ -697,6 +1713,19 @@ appdb_free_entry(
     free(entry_ptr->path);
   }
 
+  free(entry_ptr->file_path);
+  free(entry_ptr->desktop_id);
+  free(entry_ptr->lazy);
+  free(entry_ptr->exec_argv);
+  free(entry_ptr->mime_types);
+  free(entry_ptr->categories);
+  free(entry_ptr->lash_class);
+  free(entry_ptr->nsm_exec);
+  free(entry_ptr->actions);
+  free(entry_ptr->try_exec);
+  free(entry_ptr->only_show_in);
+  free(entry_ptr->not_show_in);
+
   free(entry_ptr);
 }
 
@@ -707,8 +1736,6 @@ appdb_free(
   struct list_head * node_ptr;
   struct appdb_entry * entry_ptr;
 
-  //log_info("appdb_free() called.");
-
   while (!list_empty(appdb))
   {
     node_ptr = appdb->next;
@@ -716,8 +1743,6 @@ appdb_free(
 
     list_del(node_ptr);
 
-    //log_info("Destroying appdb entry '%s'", entry_ptr->name);
-
     appdb_free_entry(entry_ptr);
   }
 }
@@ -0,0 +1,387 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ***********************************************************
+ * This file contains implementation of the category index *
+ ***********************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <malloc.h>
+
+#include "common.h"
+#include "appdb/appdb.h"
+#include "hash.h"
+
+/* Categories are interned to small integer IDs. For each category there is
+ * a bitset with one bit per entry (the posting list), so membership of all
+ * entries is a matrix of categories x entries bits. Queries combine the
+ * posting lists of the requested categories with 64-bit word operations,
+ * entries of the result are then picked from the set bits. */
+
+#define WORD_BITS 64
+
+struct appdb_category_index
+{
+  struct appdb_hash * ids;      /* category name -> ID + 1 */
+  char ** names;                /* ID -> name, NULL terminated */
+  size_t count;                 /* number of categories */
+  struct appdb_entry ** entries; /* entry number -> entry */
+  size_t entries_count;
+  size_t words;                 /* size of one posting list in words */
+  uint64_t * postings;          /* count * words, bit N of the list is set when entry N is in the category */
+};
+
+static
+size_t
+appdb_category_intern(
+  struct appdb_category_index * index_ptr,
+  const char * name)
+{
+  uintptr_t id;
+  char ** names;
+
+  id = (uintptr_t)appdb_hash_get(index_ptr->ids, name);
+  if (id != 0)
+  {
+    return id - 1;
+  }
+
+  names = realloc(index_ptr->names, (index_ptr->count + 2) * sizeof(char *));
+  if (names == NULL)
+  {
+    log_error("realloc() failed");
+    return SIZE_MAX;
+  }
+
+  index_ptr->names = names;
+
+  names[index_ptr->count] = strdup(name);
+  if (names[index_ptr->count] == NULL)
+  {
+    log_error("strdup() failed");
+    return SIZE_MAX;
+  }
+
+  if (!appdb_hash_set(index_ptr->ids, name, (void *)(uintptr_t)(index_ptr->count + 1)))
+  {
+    free(names[index_ptr->count]);
+    names[index_ptr->count] = NULL;
+    return SIZE_MAX;
+  }
+
+  names[index_ptr->count + 1] = NULL;
+  return index_ptr->count++;
+}
+
+/* NULL if category is not known */
+static
+const uint64_t *
+appdb_category_posting(
+  struct appdb_category_index * index_ptr,
+  const char * name)
+{
+  uintptr_t id;
+
+  id = (uintptr_t)appdb_hash_get(index_ptr->ids, name);
+  if (id == 0)
+  {
+    return NULL;
+  }
+
+  return index_ptr->postings + (id - 1) * index_ptr->words;
+}
+
+struct appdb_category_index *
+appdb_category_index_new(
+  struct list_head * appdb)
+{
+  struct appdb_category_index * index_ptr;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  char ** category_ptr;
+  size_t entry_no;
+  size_t id;
+
+  index_ptr = calloc(1, sizeof(struct appdb_category_index));
+  if (index_ptr == NULL)
+  {
+    log_error("calloc() failed");
+    return NULL;
+  }
+
+  index_ptr->ids = appdb_hash_new(NULL);
+  if (index_ptr->ids == NULL)
+  {
+    goto fail;
+  }
+
+  /* first pass, number the entries and intern the category names */
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+    index_ptr->entries_count++;
+
+    if (entry_ptr->categories == NULL)
+    {
+      continue;
+    }
+
+    for (category_ptr = entry_ptr->categories; *category_ptr != NULL; category_ptr++)
+    {
+      if (appdb_category_intern(index_ptr, *category_ptr) == SIZE_MAX)
+      {
+        goto fail;
+      }
+    }
+  }
+
+  index_ptr->words = (index_ptr->entries_count + WORD_BITS - 1) / WORD_BITS;
+
+  index_ptr->entries = malloc((index_ptr->entries_count + 1) * sizeof(struct appdb_entry *));
+  index_ptr->postings = calloc(index_ptr->count * index_ptr->words + 1, sizeof(uint64_t));
+  if (index_ptr->entries == NULL || index_ptr->postings == NULL)
+  {
+    log_error("malloc() failed");
+    goto fail;
+  }
+
+  /* second pass, fill the posting lists */
+  entry_no = 0;
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+    index_ptr->entries[entry_no] = entry_ptr;
+
+    if (entry_ptr->categories != NULL)
+    {
+      for (category_ptr = entry_ptr->categories; *category_ptr != NULL; category_ptr++)
+      {
+        id = (uintptr_t)appdb_hash_get(index_ptr->ids, *category_ptr) - 1;
+        index_ptr->postings[id * index_ptr->words + entry_no / WORD_BITS] |= UINT64_C(1) << (entry_no % WORD_BITS);
+      }
+    }
+
+    entry_no++;
+  }
+
+  log_info("%zu categories in the index", index_ptr->count);
+
+  return index_ptr;
+
+fail:
+  appdb_category_index_destroy(index_ptr);
+  return NULL;
+}
+
+void
+appdb_category_index_destroy(
+  struct appdb_category_index * index_ptr)
+{
+  size_t i;
+
+  if (index_ptr == NULL)
+  {
+    return;
+  }
+
+  appdb_hash_destroy(index_ptr->ids);
+
+  if (index_ptr->names != NULL)
+  {
+    for (i = 0; i < index_ptr->count; i++)
+    {
+      free(index_ptr->names[i]);
+    }
+
+    free(index_ptr->names);
+  }
+
+  free(index_ptr->entries);
+  free(index_ptr->postings);
+  free(index_ptr);
+}
+
+size_t
+appdb_category_index_memory(
+  struct appdb_category_index * index_ptr)
+{
+  size_t size;
+  size_t i;
+
+  size = malloc_usable_size(index_ptr);
+  size += appdb_hash_memory(index_ptr->ids, NULL);
+  size += malloc_usable_size(index_ptr->names);
+  for (i = 0; i < index_ptr->count; i++)
+  {
+    size += malloc_usable_size(index_ptr->names[i]);
+  }
+
+  size += malloc_usable_size(index_ptr->entries);
+  size += malloc_usable_size(index_ptr->postings);
+
+  return size;
+}
+
+const char * const *
+appdb_category_index_get_names(
+  struct appdb_category_index * index_ptr)
+{
+  static const char * const empty[] = { NULL };
+
+  if (index_ptr->names == NULL)
+  {
+    return empty;
+  }
+
+  return (const char * const *)index_ptr->names;
+}
+
+size_t
+appdb_category_index_count(
+  struct appdb_category_index * index_ptr,
+  const char * category)
+{
+  const uint64_t * posting;
+  size_t count;
+  size_t i;
+
+  posting = appdb_category_posting(index_ptr, category);
+  if (posting == NULL)
+  {
+    return 0;
+  }
+
+  count = 0;
+  for (i = 0; i < index_ptr->words; i++)
+  {
+    count += __builtin_popcountll(posting[i]);
+  }
+
+  return count;
+}
+
+struct appdb_entry **
+appdb_category_index_query(
+  struct appdb_category_index * index_ptr,
+  const char * const * all,
+  const char * const * any,
+  const char * const * none,
+  size_t * count_ptr)
+{
+  uint64_t * result;
+  uint64_t * any_result;
+  const uint64_t * posting;
+  struct appdb_entry ** entries;
+  size_t words;
+  size_t count;
+  size_t i;
+  uint64_t word;
+
+  words = index_ptr->words;
+
+  result = malloc((words * 2 + 1) * sizeof(uint64_t));
+  if (result == NULL)
+  {
+    log_error("malloc() failed");
+    return NULL;
+  }
+
+  any_result = result + words;
+
+  /* start with all entries */
+  memset(result, 0xFF, words * sizeof(uint64_t));
+  if (index_ptr->entries_count % WORD_BITS != 0)
+  {
+    result[words - 1] = (UINT64_C(1) << (index_ptr->entries_count % WORD_BITS)) - 1;
+  }
+
+  for (; all != NULL && *all != NULL; all++)
+  {
+    posting = appdb_category_posting(index_ptr, *all);
+    if (posting == NULL)
+    {
+      /* no entry is in unknown category */
+      memset(result, 0, words * sizeof(uint64_t));
+      break;
+    }
+
+    for (i = 0; i < words; i++)
+    {
+      result[i] &= posting[i];
+    }
+  }
+
+  if (any != NULL && *any != NULL)
+  {
+    memset(any_result, 0, words * sizeof(uint64_t));
+
+    for (; *any != NULL; any++)
+    {
+      posting = appdb_category_posting(index_ptr, *any);
+      if (posting == NULL)
+      {
+        continue;
+      }
+
+      for (i = 0; i < words; i++)
+      {
+        any_result[i] |= posting[i];
+      }
+    }
+
+    for (i = 0; i < words; i++)
+    {
+      result[i] &= any_result[i];
+    }
+  }
+
+  for (; none != NULL && *none != NULL; none++)
+  {
+    posting = appdb_category_posting(index_ptr, *none);
+    if (posting == NULL)
+    {
+      continue;
+    }
+
+    for (i = 0; i < words; i++)
+    {
+      result[i] &= ~posting[i];
+    }
+  }
+
+  count = 0;
+  for (i = 0; i < words; i++)
+  {
+    count += __builtin_popcountll(result[i]);
+  }
+
+  entries = malloc((count + 1) * sizeof(struct appdb_entry *));
+  if (entries == NULL)
+  {
+    log_error("malloc() failed");
+    free(result);
+    return NULL;
+  }
+
+  count = 0;
+  for (i = 0; i < words; i++)
+  {
+    for (word = result[i]; word != 0; word &= word - 1)
+    {
+      entries[count++] = index_ptr->entries[i * WORD_BITS + __builtin_ctzll(word)];
+    }
+  }
+
+  free(result);
+
+  *count_ptr = count;
+  return entries;
+}
@@ -0,0 +1,381 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *****************************************************************************
+ * This file contains implementation of case folding and of the sorted views *
+ *****************************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#include "common.h"
+#include "appdb/appdb.h"
+
+/* The view keeps entries ordered by strxfrm() keys of the field, computed
+ * once when an entry is added, so ordering is a strcmp() of the keys instead
+ * of strcoll(), which transforms both strings on each comparison. Keys start
+ * with a byte that puts entries without the field after the others. */
+
+#define KEY_PRESENT '\x01'
+#define KEY_ABSENT  '\x02'
+
+struct appdb_sorted_view_key
+{
+  char * key;
+  struct appdb_entry * entry_ptr;
+};
+
+struct appdb_sorted_view
+{
+  unsigned int field;
+  struct appdb_sorted_view_key * keys;  /* sorted by key */
+  struct appdb_entry ** entries;        /* same order as keys, NULL terminated */
+  size_t count;
+  size_t size;                          /* allocated */
+};
+
+char *
+appdb_casefold(
+  const char * string)
+{
+  size_t len;
+  char * folded;
+  char * dst;
+  mbstate_t src_state;
+  mbstate_t dst_state;
+  wchar_t wc;
+  size_t ret;
+
+  len = strlen(string);
+
+  /* lowercase form of a character is never more than 1.5 times longer in UTF-8 */
+  folded = malloc(len * 2 + MB_CUR_MAX + 1);
+  if (folded == NULL)
+  {
+    log_error("malloc() failed");
+    return NULL;
+  }
+
+  memset(&src_state, 0, sizeof(src_state));
+  memset(&dst_state, 0, sizeof(dst_state));
+  dst = folded;
+
+  while (len > 0)
+  {
+    ret = mbrtowc(&wc, string, len, &src_state);
+    if (ret == (size_t)-1 || ret == (size_t)-2 || ret == 0)
+    {
+      /* invalid or incomplete sequence (any non-ASCII byte in the C locale) is copied as it is */
+      memset(&src_state, 0, sizeof(src_state));
+      *dst++ = *string++;
+      len--;
+      continue;
+    }
+
+    string += ret;
+    len -= ret;
+
+    ret = wcrtomb(dst, towlower(wc), &dst_state);
+    if (ret == (size_t)-1)
+    {
+      /* lowercase form is not representable in the charset of the locale */
+      memset(&dst_state, 0, sizeof(dst_state));
+      ret = wcrtomb(dst, wc, &dst_state);
+    }
+
+    if (ret != (size_t)-1)
+    {
+      dst += ret;
+    }
+  }
+
+  *dst = 0;
+
+  return folded;
+}
+
+static
+char *
+appdb_sorted_view_make_key(
+  struct appdb_sorted_view * view_ptr,
+  struct appdb_entry * entry_ptr)
+{
+  const char * value;
+  char * key;
+  size_t size;
+  char prefix;
+
+  prefix = KEY_PRESENT;
+  value = appdb_entry_get(entry_ptr, view_ptr->field);
+  if (value == NULL)
+  {
+    prefix = KEY_ABSENT;
+    value = entry_ptr->name;
+  }
+
+  size = strxfrm(NULL, value, 0) + 1;
+
+  key = malloc(size + 1);
+  if (key == NULL)
+  {
+    log_error("malloc() failed");
+    return NULL;
+  }
+
+  key[0] = prefix;
+  strxfrm(key + 1, value, size);
+
+  return key;
+}
+
+static
+int
+appdb_sorted_view_key_compare(
+  const void * a,
+  const void * b)
+{
+  return strcmp(((const struct appdb_sorted_view_key *)a)->key, ((const struct appdb_sorted_view_key *)b)->key);
+}
+
+static
+bool
+appdb_sorted_view_reserve(
+  struct appdb_sorted_view * view_ptr)
+{
+  struct appdb_sorted_view_key * keys;
+  struct appdb_entry ** entries;
+  size_t size;
+
+  if (view_ptr->count < view_ptr->size)
+  {
+    return true;
+  }
+
+  size = view_ptr->size != 0 ? view_ptr->size * 2 : 64;
+
+  keys = realloc(view_ptr->keys, size * sizeof(struct appdb_sorted_view_key));
+  if (keys == NULL)
+  {
+    log_error("realloc() failed");
+    return false;
+  }
+
+  view_ptr->keys = keys;
+
+  entries = realloc(view_ptr->entries, (size + 1) * sizeof(struct appdb_entry *));
+  if (entries == NULL)
+  {
+    log_error("realloc() failed");
+    return false;
+  }
+
+  view_ptr->entries = entries;
+  view_ptr->size = size;
+
+  return true;
+}
+
+struct appdb_sorted_view *
+appdb_sorted_view_new(
+  struct list_head * appdb,
+  unsigned int field)
+{
+  struct appdb_sorted_view * view_ptr;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  char * key;
+  size_t i;
+
+  if (field >= APPDB_FIELD_COUNT)
+  {
+    log_error("Unknown appdb entry field %u", field);
+    return NULL;
+  }
+
+  view_ptr = calloc(1, sizeof(struct appdb_sorted_view));
+  if (view_ptr == NULL)
+  {
+    log_error("calloc() failed");
+    return NULL;
+  }
+
+  view_ptr->field = field;
+
+  if (!appdb_sorted_view_reserve(view_ptr))
+  {
+    goto fail;
+  }
+
+  /* append all keys and sort once */
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    key = appdb_sorted_view_make_key(view_ptr, entry_ptr);
+    if (key == NULL)
+    {
+      goto fail;
+    }
+
+    if (!appdb_sorted_view_reserve(view_ptr))
+    {
+      free(key);
+      goto fail;
+    }
+
+    view_ptr->keys[view_ptr->count].key = key;
+    view_ptr->keys[view_ptr->count].entry_ptr = entry_ptr;
+    view_ptr->count++;
+  }
+
+  if (view_ptr->count != 0)
+  {
+    qsort(view_ptr->keys, view_ptr->count, sizeof(struct appdb_sorted_view_key), appdb_sorted_view_key_compare);
+  }
+
+  for (i = 0; i < view_ptr->count; i++)
+  {
+    view_ptr->entries[i] = view_ptr->keys[i].entry_ptr;
+  }
+
+  view_ptr->entries[view_ptr->count] = NULL;
+
+  return view_ptr;
+
+fail:
+  appdb_sorted_view_destroy(view_ptr);
+  return NULL;
+}
+
+void
+appdb_sorted_view_destroy(
+  struct appdb_sorted_view * view_ptr)
+{
+  size_t i;
+
+  if (view_ptr == NULL)
+  {
+    return;
+  }
+
+  for (i = 0; i < view_ptr->count; i++)
+  {
+    free(view_ptr->keys[i].key);
+  }
+
+  free(view_ptr->keys);
+  free(view_ptr->entries);
+  free(view_ptr);
+}
+
+bool
+appdb_sorted_view_add(
+  struct appdb_sorted_view * view_ptr,
+  struct appdb_entry * entry_ptr)
+{
+  char * key;
+  size_t low;
+  size_t high;
+  size_t middle;
+
+  key = appdb_sorted_view_make_key(view_ptr, entry_ptr);
+  if (key == NULL)
+  {
+    return false;
+  }
+
+  if (!appdb_sorted_view_reserve(view_ptr))
+  {
+    free(key);
+    return false;
+  }
+
+  /* after existing entries with same key, so equal names stay in order they were added */
+  low = 0;
+  high = view_ptr->count;
+  while (low < high)
+  {
+    middle = low + (high - low) / 2;
+
+    if (strcmp(view_ptr->keys[middle].key, key) <= 0)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  memmove(view_ptr->keys + low + 1, view_ptr->keys + low, (view_ptr->count - low) * sizeof(struct appdb_sorted_view_key));
+  memmove(view_ptr->entries + low + 1, view_ptr->entries + low, (view_ptr->count - low + 1) * sizeof(struct appdb_entry *));
+
+  view_ptr->keys[low].key = key;
+  view_ptr->keys[low].entry_ptr = entry_ptr;
+  view_ptr->entries[low] = entry_ptr;
+  view_ptr->count++;
+
+  return true;
+}
+
+void
+appdb_sorted_view_remove(
+  struct appdb_sorted_view * view_ptr,
+  struct appdb_entry * entry_ptr)
+{
+  size_t i;
+
+  /* key is not computed again, fields of lazy loaded entry could have changed since it was added */
+  for (i = 0; i < view_ptr->count; i++)
+  {
+    if (view_ptr->keys[i].entry_ptr == entry_ptr)
+    {
+      break;
+    }
+  }
+
+  if (i == view_ptr->count)
+  {
+    return;
+  }
+
+  free(view_ptr->keys[i].key);
+
+  view_ptr->count--;
+  memmove(view_ptr->keys + i, view_ptr->keys + i + 1, (view_ptr->count - i) * sizeof(struct appdb_sorted_view_key));
+  memmove(view_ptr->entries + i, view_ptr->entries + i + 1, (view_ptr->count - i + 1) * sizeof(struct appdb_entry *));
+}
+
+struct appdb_entry * const *
+appdb_sorted_view_get(
+  struct appdb_sorted_view * view_ptr,
+  size_t * count_ptr)
+{
+  *count_ptr = view_ptr->count;
+  return view_ptr->entries;
+}
+
+size_t
+appdb_sorted_view_memory(
+  struct appdb_sorted_view * view_ptr)
+{
+  size_t size;
+  size_t i;
+
+  size = malloc_usable_size(view_ptr) + malloc_usable_size(view_ptr->keys) + malloc_usable_size(view_ptr->entries);
+  for (i = 0; i < view_ptr->count; i++)
+  {
+    size += malloc_usable_size(view_ptr->keys[i].key);
+  }
+
+  return size;
+}
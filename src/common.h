@@ -21,5 +21,7 @@
 #define UNUSED(x) UNUSED_ ## x __attribute__((unused))
 
 #define APPDB_DBUS_SERVICE_NAME "org.ladish.appdb"
+#define APPDB_DBUS_OBJECT_PATH  "/org/ladish/appdb"
+#define APPDB_DBUS_IFACE        "org.ladish.appdb"
 
 #endif /* #ifndef COMMON_H__BD287362_4EAE_4DB0_BAB4_5EE0FEED86E4__INCLUDED */
@@ -0,0 +1,455 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *************************************************************
+ * This file contains implementation of the completion index *
+ *************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <malloc.h>
+
+#include "common.h"
+#include "appdb/appdb.h"
+
+/* Each entry has up to three keys: name, generic name and basename of the
+ * executable, case folded with appdb_casefold(). Keys are kept in a sorted
+ * array, so keys with a prefix are a contiguous range that starts at the
+ * lower bound of the prefix. Entries are inserted and removed in place,
+ * with memmove(), which for the number of installed applications is
+ * cheaper than rebuilding. */
+
+#define MAX_KEYS 3
+
+struct appdb_complete_key
+{
+  char * key;                   /* case folded */
+  struct appdb_entry * entry_ptr;
+};
+
+struct appdb_complete_index
+{
+  struct appdb_complete_key * keys;  /* sorted by key */
+  size_t count;
+  size_t size;                  /* allocated */
+};
+
+/* "env VAR=value program" is common, the program is what users type */
+static
+const char *
+appdb_complete_exec_name(
+  struct appdb_entry * entry_ptr)
+{
+  char ** arg_ptr;
+  const char * name;
+
+  if (appdb_entry_get(entry_ptr, APPDB_FIELD_EXEC) == NULL || entry_ptr->exec_argv == NULL)
+  {
+    return NULL;
+  }
+
+  for (arg_ptr = entry_ptr->exec_argv; *arg_ptr != NULL; arg_ptr++)
+  {
+    name = strrchr(*arg_ptr, '/');
+    name = name != NULL ? name + 1 : *arg_ptr;
+
+    if (arg_ptr == entry_ptr->exec_argv && strcmp(name, "env") == 0)
+    {
+      continue;
+    }
+
+    if (arg_ptr != entry_ptr->exec_argv && strchr(*arg_ptr, '=') != NULL)
+    {
+      continue;
+    }
+
+    return *name != 0 ? name : NULL;
+  }
+
+  return NULL;
+}
+
+/* returns number of keys, or -1 on failure; keys are to be freed by the caller */
+static
+int
+appdb_complete_entry_keys(
+  struct appdb_entry * entry_ptr,
+  char ** keys)
+{
+  const char * strings[MAX_KEYS];
+  int count;
+  int i;
+  int j;
+
+  strings[0] = entry_ptr->name;
+  strings[1] = appdb_entry_get(entry_ptr, APPDB_FIELD_GENERIC_NAME);
+  strings[2] = appdb_complete_exec_name(entry_ptr);
+
+  count = 0;
+  for (i = 0; i < MAX_KEYS; i++)
+  {
+    if (strings[i] == NULL || *strings[i] == 0)
+    {
+      continue;
+    }
+
+    keys[count] = appdb_casefold(strings[i]);
+    if (keys[count] == NULL)
+    {
+      goto fail;
+    }
+
+    /* "Ardour" named "ardour" would match twice */
+    for (j = 0; j < count; j++)
+    {
+      if (strcmp(keys[j], keys[count]) == 0)
+      {
+        break;
+      }
+    }
+
+    if (j < count)
+    {
+      free(keys[count]);
+      continue;
+    }
+
+    count++;
+  }
+
+  return count;
+
+fail:
+  while (count > 0)
+  {
+    free(keys[--count]);
+  }
+
+  return -1;
+}
+
+/* index of first key that is not less than key */
+static
+size_t
+appdb_complete_lower_bound(
+  struct appdb_complete_index * index_ptr,
+  const char * key)
+{
+  size_t low;
+  size_t high;
+  size_t middle;
+
+  low = 0;
+  high = index_ptr->count;
+
+  while (low < high)
+  {
+    middle = low + (high - low) / 2;
+
+    if (strcmp(index_ptr->keys[middle].key, key) < 0)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+static
+int
+appdb_complete_key_compare(
+  const void * a,
+  const void * b)
+{
+  return strcmp(((const struct appdb_complete_key *)a)->key, ((const struct appdb_complete_key *)b)->key);
+}
+
+static
+bool
+appdb_complete_reserve(
+  struct appdb_complete_index * index_ptr,
+  size_t count)
+{
+  struct appdb_complete_key * keys;
+  size_t size;
+
+  if (index_ptr->count + count <= index_ptr->size)
+  {
+    return true;
+  }
+
+  size = index_ptr->size != 0 ? index_ptr->size * 2 : 64;
+  while (size < index_ptr->count + count)
+  {
+    size *= 2;
+  }
+
+  keys = realloc(index_ptr->keys, size * sizeof(struct appdb_complete_key));
+  if (keys == NULL)
+  {
+    log_error("realloc() failed");
+    return false;
+  }
+
+  index_ptr->keys = keys;
+  index_ptr->size = size;
+
+  return true;
+}
+
+struct appdb_complete_index *
+appdb_complete_index_new(
+  struct list_head * appdb)
+{
+  struct appdb_complete_index * index_ptr;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  char * keys[MAX_KEYS];
+  int count;
+  int i;
+
+  index_ptr = calloc(1, sizeof(struct appdb_complete_index));
+  if (index_ptr == NULL)
+  {
+    log_error("calloc() failed");
+    return NULL;
+  }
+
+  /* append all keys and sort once */
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    count = appdb_complete_entry_keys(entry_ptr, keys);
+    if (count == -1)
+    {
+      goto fail;
+    }
+
+    if (!appdb_complete_reserve(index_ptr, count))
+    {
+      while (count > 0)
+      {
+        free(keys[--count]);
+      }
+
+      goto fail;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+      index_ptr->keys[index_ptr->count].key = keys[i];
+      index_ptr->keys[index_ptr->count].entry_ptr = entry_ptr;
+      index_ptr->count++;
+    }
+  }
+
+  if (index_ptr->count != 0)
+  {
+    qsort(index_ptr->keys, index_ptr->count, sizeof(struct appdb_complete_key), appdb_complete_key_compare);
+  }
+
+  log_info("%zu keys in the completion index", index_ptr->count);
+
+  return index_ptr;
+
+fail:
+  appdb_complete_index_destroy(index_ptr);
+  return NULL;
+}
+
+void
+appdb_complete_index_destroy(
+  struct appdb_complete_index * index_ptr)
+{
+  size_t i;
+
+  if (index_ptr == NULL)
+  {
+    return;
+  }
+
+  for (i = 0; i < index_ptr->count; i++)
+  {
+    free(index_ptr->keys[i].key);
+  }
+
+  free(index_ptr->keys);
+  free(index_ptr);
+}
+
+bool
+appdb_complete_index_add(
+  struct appdb_complete_index * index_ptr,
+  struct appdb_entry * entry_ptr)
+{
+  char * keys[MAX_KEYS];
+  int count;
+  int i;
+  size_t position;
+
+  count = appdb_complete_entry_keys(entry_ptr, keys);
+  if (count == -1)
+  {
+    return false;
+  }
+
+  if (!appdb_complete_reserve(index_ptr, count))
+  {
+    while (count > 0)
+    {
+      free(keys[--count]);
+    }
+
+    return false;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    position = appdb_complete_lower_bound(index_ptr, keys[i]);
+
+    memmove(
+      index_ptr->keys + position + 1,
+      index_ptr->keys + position,
+      (index_ptr->count - position) * sizeof(struct appdb_complete_key));
+
+    index_ptr->keys[position].key = keys[i];
+    index_ptr->keys[position].entry_ptr = entry_ptr;
+    index_ptr->count++;
+  }
+
+  return true;
+}
+
+void
+appdb_complete_index_remove(
+  struct appdb_complete_index * index_ptr,
+  struct appdb_entry * entry_ptr)
+{
+  size_t i;
+  size_t j;
+
+  /* keys are not computed again, fields of lazy loaded entry could have changed since it was added */
+  for (i = 0, j = 0; i < index_ptr->count; i++)
+  {
+    if (index_ptr->keys[i].entry_ptr == entry_ptr)
+    {
+      free(index_ptr->keys[i].key);
+      continue;
+    }
+
+    index_ptr->keys[j++] = index_ptr->keys[i];
+  }
+
+  index_ptr->count = j;
+}
+
+struct appdb_entry **
+appdb_complete_index_query(
+  struct appdb_complete_index * index_ptr,
+  const char * prefix,
+  size_t limit,
+  size_t * count_ptr)
+{
+  char * folded;
+  size_t len;
+  struct appdb_entry ** entries;
+  struct appdb_entry ** seen;
+  size_t seen_mask;
+  size_t first;
+  size_t last;
+  size_t max;
+  size_t count;
+  size_t i;
+  size_t slot;
+
+  folded = appdb_casefold(prefix);
+  if (folded == NULL)
+  {
+    return NULL;
+  }
+
+  len = strlen(folded);
+  first = appdb_complete_lower_bound(index_ptr, folded);
+
+  for (last = first; last < index_ptr->count; last++)
+  {
+    if (strncmp(index_ptr->keys[last].key, folded, len) != 0)
+    {
+      break;
+    }
+  }
+
+  free(folded);
+
+  max = last - first;
+  if (limit != 0 && limit < max)
+  {
+    max = limit;
+  }
+
+  /* entry can match with more than one key, so the returned entries are remembered in a small set */
+  for (seen_mask = 1; seen_mask < max * 2; seen_mask *= 2);
+
+  entries = malloc((max + 1) * sizeof(struct appdb_entry *));
+  seen = calloc(seen_mask, sizeof(struct appdb_entry *));
+  if (entries == NULL || seen == NULL)
+  {
+    log_error("malloc() failed");
+    free(entries);
+    free(seen);
+    return NULL;
+  }
+
+  seen_mask--;
+
+  count = 0;
+  for (i = first; i < last && count < max; i++)
+  {
+    slot = ((uintptr_t)index_ptr->keys[i].entry_ptr >> 4) & seen_mask;
+    while (seen[slot] != NULL && seen[slot] != index_ptr->keys[i].entry_ptr)
+    {
+      slot = (slot + 1) & seen_mask;
+    }
+
+    if (seen[slot] != NULL)
+    {
+      continue;
+    }
+
+    seen[slot] = index_ptr->keys[i].entry_ptr;
+    entries[count++] = index_ptr->keys[i].entry_ptr;
+  }
+
+  free(seen);
+
+  *count_ptr = count;
+  return entries;
+}
+
+size_t
+appdb_complete_index_memory(
+  struct appdb_complete_index * index_ptr)
+{
+  size_t size;
+  size_t i;
+
+  size = malloc_usable_size(index_ptr) + malloc_usable_size(index_ptr->keys);
+  for (i = 0; i < index_ptr->count; i++)
+  {
+    size += malloc_usable_size(index_ptr->keys[i].key);
+  }
+
+  return size;
+}
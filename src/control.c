@@ -0,0 +1,2016 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *****************************************************************
+ * This file contains implementation of the D-Bus control object *
+ *****************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_DBUS
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <locale.h>
+
+#include <cdbus/cdbus.h>
+
+#include "common.h"
+#include "control.h"
+#include "db.h"
+#include "fastpath.h"
+#include "fuzzy.h"
+#include "icons.h"
+#include "path.h"
+#include "qcache.h"
+#include "workers.h"
+#include "catdup.h"
+
+#define LIST_PAGE_LIMIT 1024
+
+/* cached result of a query that returns names */
+struct appdb_dbus_names
+{
+  size_t count;
+  const char * names[];
+};
+
+/* cached result of FuzzySearch */
+struct appdb_dbus_matches
+{
+  size_t count;
+  struct appdb_fuzzy_match matches[];
+};
+
+struct appdb_dbus_key
+{
+  char * buffer;
+  size_t len;
+  size_t size;                  /* allocated */
+};
+
+static bool appdb_dbus_key_append(struct appdb_dbus_key * key_ptr, const char * string, size_t len)
+{
+  char * buffer;
+  size_t size;
+
+  if (key_ptr->len + len >= key_ptr->size)
+  {
+    for (size = key_ptr->size != 0 ? key_ptr->size * 2 : 256; key_ptr->len + len >= size; size *= 2);
+
+    buffer = realloc(key_ptr->buffer, size);
+    if (buffer == NULL)
+    {
+      log_error("realloc() failed");
+      return false;
+    }
+
+    key_ptr->buffer = buffer;
+    key_ptr->size = size;
+  }
+
+  memcpy(key_ptr->buffer + key_ptr->len, string, len);
+  key_ptr->len += len;
+  key_ptr->buffer[key_ptr->len] = 0;
+
+  return true;
+}
+
+/* strings are prefixed with their length, so contents of one argument can't look like another argument */
+static bool appdb_dbus_key_append_args(struct appdb_dbus_key * key_ptr, DBusMessageIter * iter_ptr)
+{
+  DBusMessageIter array_iter;
+  const char * string;
+  dbus_uint32_t uint32;
+  char number[32];
+  int type;
+  int len;
+
+  while ((type = dbus_message_iter_get_arg_type(iter_ptr)) != DBUS_TYPE_INVALID)
+  {
+    switch (type)
+    {
+    case DBUS_TYPE_STRING:
+      dbus_message_iter_get_basic(iter_ptr, &string);
+      len = snprintf(number, sizeof(number), "s%zu:", strlen(string));
+      if (!appdb_dbus_key_append(key_ptr, number, len) ||
+          !appdb_dbus_key_append(key_ptr, string, strlen(string)))
+      {
+        return false;
+      }
+      break;
+    case DBUS_TYPE_UINT32:
+      dbus_message_iter_get_basic(iter_ptr, &uint32);
+      len = snprintf(number, sizeof(number), "u%u;", (unsigned int)uint32);
+      if (!appdb_dbus_key_append(key_ptr, number, len))
+      {
+        return false;
+      }
+      break;
+    case DBUS_TYPE_ARRAY:
+      dbus_message_iter_recurse(iter_ptr, &array_iter);
+      if (!appdb_dbus_key_append(key_ptr, "[", 1) ||
+          !appdb_dbus_key_append_args(key_ptr, &array_iter) ||
+          !appdb_dbus_key_append(key_ptr, "]", 1))
+      {
+        return false;
+      }
+      break;
+    default:
+      log_error("Argument of type '%c' can't be part of a query cache key", type);
+      return false;
+    }
+
+    dbus_message_iter_next(iter_ptr);
+  }
+
+  return true;
+}
+
+/* key of the query in the query cache: method, locale and arguments; NULL on failure, then result is not cached */
+static char * appdb_dbus_query_key(struct cdbus_method_call * call_ptr)
+{
+  struct appdb_dbus_key key;
+  DBusMessageIter iter;
+  const char * locale;
+
+  key.buffer = NULL;
+  key.len = 0;
+  key.size = 0;
+
+  if (!appdb_dbus_key_append(&key, call_ptr->method_name, strlen(call_ptr->method_name)) ||
+      !appdb_dbus_key_append(&key, "\n", 1))
+  {
+    goto fail;
+  }
+
+  /* case folding and collation depend on the locale */
+  locale = setlocale(LC_CTYPE, NULL);
+  if (!appdb_dbus_key_append(&key, locale, strlen(locale)) ||
+      !appdb_dbus_key_append(&key, "\n", 1))
+  {
+    goto fail;
+  }
+
+  locale = setlocale(LC_COLLATE, NULL);
+  if (!appdb_dbus_key_append(&key, locale, strlen(locale)) ||
+      !appdb_dbus_key_append(&key, "\n", 1))
+  {
+    goto fail;
+  }
+
+  if (dbus_message_iter_init(call_ptr->message, &iter) &&
+      !appdb_dbus_key_append_args(&key, &iter))
+  {
+    goto fail;
+  }
+
+  return key.buffer;
+
+fail:
+  free(key.buffer);
+  return NULL;
+}
+
+static void appdb_dbus_reply_names(struct cdbus_method_call * call_ptr, const char * const * names, size_t count)
+{
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names, (int)count,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+}
+
+static void appdb_dbus_set_log_level(struct cdbus_method_call * call_ptr)
+{
+  const char * subsystem;
+  const char * level;
+
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &cdbus_g_dbus_error,
+        DBUS_TYPE_STRING, &subsystem,
+        DBUS_TYPE_STRING, &level,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, cdbus_g_dbus_error.message);
+    dbus_error_free(&cdbus_g_dbus_error);
+    return;
+  }
+
+  if (!appdb_log_set_level(subsystem, level))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Unknown log subsystem '%s' or level '%s'", subsystem, level);
+    return;
+  }
+
+  log_info("Log level of '%s' set to '%s'", subsystem, level);
+
+  cdbus_method_return_new_void(call_ptr);
+}
+
+static void appdb_dbus_launch(struct cdbus_method_call * call_ptr)
+{
+  const char * name;
+  const char ** uris;
+  int uris_count;
+  struct appdb_entry * entry_ptr;
+  pid_t * pids;
+  size_t pids_count;
+  dbus_int32_t * dbus_pids;
+  size_t i;
+
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &cdbus_g_dbus_error,
+        DBUS_TYPE_STRING, &name,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &uris, &uris_count,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, cdbus_g_dbus_error.message);
+    dbus_error_free(&cdbus_g_dbus_error);
+    return;
+  }
+
+  entry_ptr = appdb_db_find(name);
+  if (entry_ptr == NULL)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Unknown application '%s'", name);
+    goto free_uris;
+  }
+
+  pids = malloc((uris_count > 0 ? uris_count : 1) * (sizeof(pid_t) + sizeof(dbus_int32_t)));
+  if (pids == NULL)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    goto free_uris;
+  }
+
+  if (!appdb_entry_launch(entry_ptr, uris, uris_count, pids, &pids_count))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_FAILED, "Failed to start '%s'", name);
+    goto free_pids;
+  }
+
+  dbus_pids = (dbus_int32_t *)(pids + (uris_count > 0 ? uris_count : 1));
+  for (i = 0; i < pids_count; i++)
+  {
+    dbus_pids[i] = pids[i];
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_INT32, &dbus_pids, (int)pids_count,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+
+free_pids:
+  free(pids);
+free_uris:
+  dbus_free_string_array((char **)uris);
+}
+
+static void appdb_dbus_resolve_icons(struct cdbus_method_call * call_ptr)
+{
+  const char ** names;
+  int names_count;
+  dbus_uint32_t size;
+  const char ** paths;
+  int i;
+
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &cdbus_g_dbus_error,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names, &names_count,
+        DBUS_TYPE_UINT32, &size,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, cdbus_g_dbus_error.message);
+    dbus_error_free(&cdbus_g_dbus_error);
+    return;
+  }
+
+  paths = malloc((names_count > 0 ? names_count : 1) * sizeof(const char *));
+  if (paths == NULL)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    goto free_names;
+  }
+
+  for (i = 0; i < names_count; i++)
+  {
+    paths[i] = appdb_icons_resolve(names[i], size);
+    if (paths[i] == NULL)
+    {
+      paths[i] = "";
+    }
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &paths, names_count,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+
+  free(paths);
+free_names:
+  dbus_free_string_array((char **)names);
+}
+
+/* append "as" with names of applications that handle the MIME type */
+static bool appdb_dbus_append_handlers(DBusMessageIter * iter_ptr, const char * mime_type)
+{
+  DBusMessageIter array_iter;
+  struct appdb_entry * const * entries;
+  size_t count;
+  size_t i;
+
+  /* index is not built until loading is finished */
+  entries = NULL;
+  count = 0;
+  if (g_appdb_mime_index != NULL)
+  {
+    entries = appdb_mime_index_lookup(g_appdb_mime_index, mime_type, &count);
+  }
+
+  if (!dbus_message_iter_open_container(iter_ptr, DBUS_TYPE_ARRAY, "s", &array_iter))
+  {
+    return false;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    if (!dbus_message_iter_append_basic(&array_iter, DBUS_TYPE_STRING, &entries[i]->name))
+    {
+      dbus_message_iter_abandon_container(iter_ptr, &array_iter);
+      return false;
+    }
+  }
+
+  return dbus_message_iter_close_container(iter_ptr, &array_iter);
+}
+
+static void appdb_dbus_get_handlers(struct cdbus_method_call * call_ptr)
+{
+  const char * mime_type;
+  DBusMessageIter iter;
+
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &cdbus_g_dbus_error,
+        DBUS_TYPE_STRING, &mime_type,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, cdbus_g_dbus_error.message);
+    dbus_error_free(&cdbus_g_dbus_error);
+    return;
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!appdb_dbus_append_handlers(&iter, mime_type))
+  {
+    goto fail_unref;
+  }
+
+  return;
+
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+}
+
+static void appdb_dbus_get_handlers_many(struct cdbus_method_call * call_ptr)
+{
+  const char ** mime_types;
+  int mime_types_count;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  int i;
+
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &cdbus_g_dbus_error,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &mime_types, &mime_types_count,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, cdbus_g_dbus_error.message);
+    dbus_error_free(&cdbus_g_dbus_error);
+    return;
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "as", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  for (i = 0; i < mime_types_count; i++)
+  {
+    if (!appdb_dbus_append_handlers(&array_iter, mime_types[i]))
+    {
+      dbus_message_iter_abandon_container(&iter, &array_iter);
+      goto fail_unref;
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  goto free_mime_types;
+
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+free_mime_types:
+  dbus_free_string_array((char **)mime_types);
+}
+
+static void appdb_dbus_query_categories(struct cdbus_method_call * call_ptr)
+{
+  const char ** all;
+  int all_count;
+  const char ** any;
+  int any_count;
+  const char ** none;
+  int none_count;
+  char * key;
+  const struct appdb_dbus_names * cached_ptr;
+  struct appdb_dbus_names * result_ptr;
+  struct appdb_entry ** entries;
+  size_t count;
+  size_t i;
+  DBusError error;
+
+  dbus_error_init(&error);
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &error,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &all, &all_count,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &any, &any_count,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &none, &none_count,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, error.message);
+    dbus_error_free(&error);
+    return;
+  }
+
+  key = appdb_dbus_query_key(call_ptr);
+
+  appdb_qcache_lock();
+  cached_ptr = key != NULL ? appdb_qcache_get(key) : NULL;
+  if (cached_ptr != NULL)
+  {
+    appdb_dbus_reply_names(call_ptr, cached_ptr->names, cached_ptr->count);
+    appdb_qcache_unlock();
+    goto free_key;
+  }
+
+  appdb_qcache_unlock();
+
+  /* string arrays from dbus_message_get_args() are NULL terminated */
+  if (g_appdb_category_index != NULL)
+  {
+    entries = appdb_category_index_query(g_appdb_category_index, all, any, none, &count);
+  }
+  else
+  {
+    /* loading is not finished yet */
+    entries = malloc(sizeof(struct appdb_entry *));
+    count = 0;
+  }
+
+  if (entries == NULL)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    goto free_key;
+  }
+
+  result_ptr = malloc(sizeof(struct appdb_dbus_names) + count * sizeof(const char *));
+  if (result_ptr == NULL)
+  {
+    free(entries);
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    goto free_key;
+  }
+
+  result_ptr->count = count;
+  for (i = 0; i < count; i++)
+  {
+    result_ptr->names[i] = entries[i]->name;
+  }
+
+  free(entries);
+
+  appdb_dbus_reply_names(call_ptr, result_ptr->names, result_ptr->count);
+
+  if (key == NULL || !appdb_qcache_put(key, result_ptr))
+  {
+    free(result_ptr);
+  }
+
+free_key:
+  free(key);
+  dbus_free_string_array((char **)all);
+  dbus_free_string_array((char **)any);
+  dbus_free_string_array((char **)none);
+}
+
+static void appdb_dbus_complete(struct cdbus_method_call * call_ptr)
+{
+  const char * prefix;
+  dbus_uint32_t limit;
+  char * key;
+  const struct appdb_dbus_names * cached_ptr;
+  struct appdb_dbus_names * result_ptr;
+  struct appdb_entry ** entries;
+  size_t count;
+  size_t i;
+
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &cdbus_g_dbus_error,
+        DBUS_TYPE_STRING, &prefix,
+        DBUS_TYPE_UINT32, &limit,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, cdbus_g_dbus_error.message);
+    dbus_error_free(&cdbus_g_dbus_error);
+    return;
+  }
+
+  key = appdb_dbus_query_key(call_ptr);
+
+  appdb_qcache_lock();
+  cached_ptr = key != NULL ? appdb_qcache_get(key) : NULL;
+  if (cached_ptr != NULL)
+  {
+    appdb_dbus_reply_names(call_ptr, cached_ptr->names, cached_ptr->count);
+    appdb_qcache_unlock();
+    goto free_key;
+  }
+
+  appdb_qcache_unlock();
+
+  if (g_appdb_complete_index != NULL)
+  {
+    entries = appdb_complete_index_query(g_appdb_complete_index, prefix, limit, &count);
+  }
+  else
+  {
+    /* loading is not finished yet */
+    entries = malloc(sizeof(struct appdb_entry *));
+    count = 0;
+  }
+
+  if (entries == NULL)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    goto free_key;
+  }
+
+  result_ptr = malloc(sizeof(struct appdb_dbus_names) + count * sizeof(const char *));
+  if (result_ptr == NULL)
+  {
+    free(entries);
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    goto free_key;
+  }
+
+  result_ptr->count = count;
+  for (i = 0; i < count; i++)
+  {
+    result_ptr->names[i] = entries[i]->name;
+  }
+
+  free(entries);
+
+  appdb_dbus_reply_names(call_ptr, result_ptr->names, result_ptr->count);
+
+  if (key == NULL || !appdb_qcache_put(key, result_ptr))
+  {
+    free(result_ptr);
+  }
+
+free_key:
+  free(key);
+}
+
+static void appdb_dbus_reply_matches(struct cdbus_method_call * call_ptr, const struct appdb_dbus_matches * result_ptr)
+{
+  size_t i;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  DBusMessageIter struct_iter;
+  dbus_uint32_t score;
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(su)", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  for (i = 0; i < result_ptr->count; i++)
+  {
+    score = result_ptr->matches[i].score;
+
+    if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &result_ptr->matches[i].entry_ptr->name) ||
+        !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &score))
+    {
+      dbus_message_iter_abandon_container(&array_iter, &struct_iter);
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  return;
+
+fail_abandon:
+  dbus_message_iter_abandon_container(&iter, &array_iter);
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+}
+
+static void appdb_dbus_fuzzy_search(struct cdbus_method_call * call_ptr)
+{
+  const char * query;
+  dbus_uint32_t k;
+  char * key;
+  const struct appdb_dbus_matches * cached_ptr;
+  struct appdb_dbus_matches * result_ptr;
+  size_t count;
+  DBusError error;
+
+  dbus_error_init(&error);
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &error,
+        DBUS_TYPE_STRING, &query,
+        DBUS_TYPE_UINT32, &k,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, error.message);
+    dbus_error_free(&error);
+    return;
+  }
+
+  key = appdb_dbus_query_key(call_ptr);
+
+  appdb_qcache_lock();
+  cached_ptr = key != NULL ? appdb_qcache_get(key) : NULL;
+  if (cached_ptr != NULL)
+  {
+    appdb_dbus_reply_matches(call_ptr, cached_ptr);
+    appdb_qcache_unlock();
+    free(key);
+    return;
+  }
+
+  appdb_qcache_unlock();
+
+  /* matcher is not built until loading is finished */
+  count = g_appdb_fuzzy != NULL ? appdb_fuzzy_count(g_appdb_fuzzy) : 0;
+  if (k > count)
+  {
+    k = count;
+  }
+
+  count = 0;
+
+  result_ptr = malloc(sizeof(struct appdb_dbus_matches) + (k + 1) * sizeof(struct appdb_fuzzy_match));
+  if (result_ptr == NULL ||
+      (g_appdb_fuzzy != NULL && !appdb_fuzzy_search(g_appdb_fuzzy, query, result_ptr->matches, k, &count)))
+  {
+    free(result_ptr);
+    free(key);
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    return;
+  }
+
+  result_ptr->count = count;
+
+  appdb_dbus_reply_matches(call_ptr, result_ptr);
+
+  if (key == NULL || !appdb_qcache_put(key, result_ptr))
+  {
+    free(result_ptr);
+  }
+
+  free(key);
+}
+
+static void appdb_dbus_get_categories(struct cdbus_method_call * call_ptr)
+{
+  static const char * const empty = NULL;
+  const char * const * names;
+  dbus_uint32_t count;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  DBusMessageIter struct_iter;
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(su)", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  for (names = g_appdb_category_index != NULL ? appdb_category_index_get_names(g_appdb_category_index) : &empty;
+       *names != NULL;
+       names++)
+  {
+    count = appdb_category_index_count(g_appdb_category_index, *names);
+
+    if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, names) ||
+        !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &count))
+    {
+      dbus_message_iter_abandon_container(&array_iter, &struct_iter);
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  return;
+
+fail_abandon:
+  dbus_message_iter_abandon_container(&iter, &array_iter);
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+}
+
+static void appdb_dbus_get_session_applications(struct cdbus_method_call * call_ptr)
+{
+  dbus_uint32_t protocols;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  DBusMessageIter struct_iter;
+  struct appdb_entry * entry_ptr;
+  dbus_uint32_t entry_protocols;
+  const char * lash_class;
+  const char * nsm_exec;
+  size_t i;
+  DBusError error;
+
+  dbus_error_init(&error);
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &error,
+        DBUS_TYPE_UINT32, &protocols,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, error.message);
+    dbus_error_free(&error);
+    return;
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(suss)", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  for (i = 0; i < g_appdb_session_entries_count; i++)
+  {
+    entry_ptr = g_appdb_session_entries[i];
+
+    entry_protocols = entry_ptr->session_protocols;
+    if (protocols != 0 && (entry_protocols & protocols) == 0)
+    {
+      continue;
+    }
+
+    lash_class = entry_ptr->lash_class != NULL ? entry_ptr->lash_class : "";
+    nsm_exec = entry_ptr->nsm_exec != NULL ? entry_ptr->nsm_exec : "";
+
+    if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &entry_ptr->name) ||
+        !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &entry_protocols) ||
+        !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &lash_class) ||
+        !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &nsm_exec))
+    {
+      dbus_message_iter_abandon_container(&array_iter, &struct_iter);
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  return;
+
+fail_abandon:
+  dbus_message_iter_abandon_container(&iter, &array_iter);
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+}
+
+static void appdb_dbus_get_visible(struct cdbus_method_call * call_ptr)
+{
+  const char * desktops;
+  struct appdb_entry ** entries;
+  size_t count;
+  const char ** names;
+  size_t i;
+  DBusError error;
+
+  dbus_error_init(&error);
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &error,
+        DBUS_TYPE_STRING, &desktops,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, error.message);
+    dbus_error_free(&error);
+    return;
+  }
+
+  entries = appdb_db_visible(desktops, &count);
+  if (entries == NULL)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    return;
+  }
+
+  names = malloc((count + 1) * sizeof(const char *));
+  if (names == NULL)
+  {
+    free(entries);
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    return;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    names[i] = entries[i]->name;
+  }
+
+  free(entries);
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names, (int)count,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+
+  free(names);
+}
+
+static void appdb_dbus_get_sorted(struct cdbus_method_call * call_ptr)
+{
+  const char * field;
+  struct appdb_sorted_view * view_ptr;
+  struct appdb_entry * const * entries;
+  size_t count;
+  const char ** names;
+  size_t i;
+  DBusError error;
+
+  dbus_error_init(&error);
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &error,
+        DBUS_TYPE_STRING, &field,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, error.message);
+    dbus_error_free(&error);
+    return;
+  }
+
+  if (strcmp(field, "name") == 0)
+  {
+    view_ptr = g_appdb_name_view;
+  }
+  else if (strcmp(field, "generic_name") == 0)
+  {
+    view_ptr = g_appdb_generic_name_view;
+  }
+  else
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Unknown sort field '%s'", field);
+    return;
+  }
+
+  /* views are not built while loading */
+  count = 0;
+  entries = NULL;
+  if (view_ptr != NULL)
+  {
+    entries = appdb_sorted_view_get(view_ptr, &count);
+  }
+
+  names = malloc((count + 1) * sizeof(const char *));
+  if (names == NULL)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    return;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    names[i] = entries[i]->name;
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names, (int)count,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+
+  free(names);
+}
+
+static void appdb_dbus_format_digest(char * buffer, uint64_t digest)
+{
+  sprintf(buffer, "%016llx", (unsigned long long)digest);
+}
+
+static void appdb_dbus_get_digest(struct cdbus_method_call * call_ptr)
+{
+  char digest[17];
+  const char * digest_ptr;
+  char * const * dirs;
+  const uint64_t * dir_digests;
+  size_t i;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  DBusMessageIter struct_iter;
+
+  /* there is no digest until loading is finished */
+  dirs = appdb_db_dir_digests(&dir_digests);
+  digest[0] = 0;
+  if (dir_digests != NULL)
+  {
+    appdb_dbus_format_digest(digest, appdb_db_digest());
+  }
+
+  digest_ptr = digest;
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &digest_ptr) ||
+      !dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(ss)", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  for (i = 0; dirs[i] != NULL; i++)
+  {
+    appdb_dbus_format_digest(digest, dir_digests[i]);
+
+    if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &dirs[i]) ||
+        !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &digest_ptr))
+    {
+      dbus_message_iter_abandon_container(&array_iter, &struct_iter);
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  return;
+
+fail_abandon:
+  dbus_message_iter_abandon_container(&iter, &array_iter);
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+}
+
+static void appdb_dbus_get_all_if_changed(struct cdbus_method_call * call_ptr)
+{
+  const char * client_digest;
+  char digest[17];
+  const char * digest_ptr;
+  const uint64_t * dir_digests;
+  dbus_bool_t modified;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  const char * icon;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  DBusMessageIter struct_iter;
+  DBusError error;
+
+  dbus_error_init(&error);
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &error,
+        DBUS_TYPE_STRING, &client_digest,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, error.message);
+    dbus_error_free(&error);
+    return;
+  }
+
+  /* while loading, the digest is empty and never matches */
+  appdb_db_dir_digests(&dir_digests);
+  digest[0] = 0;
+  if (dir_digests != NULL)
+  {
+    appdb_dbus_format_digest(digest, appdb_db_digest());
+  }
+
+  digest_ptr = digest;
+  modified = digest[0] == 0 || strcmp(client_digest, digest) != 0;
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &digest_ptr) ||
+      !dbus_message_iter_append_basic(&iter, DBUS_TYPE_BOOLEAN, &modified) ||
+      !dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sss)", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  /* not modified reply has no payload */
+  if (modified)
+  {
+    list_for_each(node_ptr, &g_appdb)
+    {
+      entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+      icon = entry_ptr->icon != NULL ? entry_ptr->icon : "";
+
+      if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+      {
+        goto fail_abandon;
+      }
+
+      if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &entry_ptr->name) ||
+          !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &entry_ptr->desktop_id) ||
+          !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &icon))
+      {
+        dbus_message_iter_abandon_container(&array_iter, &struct_iter);
+        goto fail_abandon;
+      }
+
+      if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+      {
+        goto fail_abandon;
+      }
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  return;
+
+fail_abandon:
+  dbus_message_iter_abandon_container(&iter, &array_iter);
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+}
+
+/* values of the APPDB_FIELD_xxx fields that have their bit set in fields, in order of the bits */
+static bool appdb_dbus_append_fields(DBusMessageIter * iter_ptr, struct appdb_entry * entry_ptr, dbus_uint32_t fields)
+{
+  DBusMessageIter array_iter;
+  const char * value;
+  unsigned int field;
+
+  if (!dbus_message_iter_open_container(iter_ptr, DBUS_TYPE_ARRAY, "s", &array_iter))
+  {
+    return false;
+  }
+
+  for (field = 0; entry_ptr != NULL && field < APPDB_FIELD_COUNT; field++)
+  {
+    if ((fields & (1 << field)) == 0)
+    {
+      continue;
+    }
+
+    value = appdb_entry_get(entry_ptr, field);
+    if (value == NULL)
+    {
+      value = "";
+    }
+
+    if (!dbus_message_iter_append_basic(&array_iter, DBUS_TYPE_STRING, &value))
+    {
+      dbus_message_iter_abandon_container(iter_ptr, &array_iter);
+      return false;
+    }
+  }
+
+  return dbus_message_iter_close_container(iter_ptr, &array_iter);
+}
+
+static void appdb_dbus_get_entries(struct cdbus_method_call * call_ptr)
+{
+  const char ** names;
+  int names_count;
+  int i;
+  struct appdb_entry * entry_ptr;
+  dbus_bool_t found;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  DBusMessageIter struct_iter;
+
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &cdbus_g_dbus_error,
+        DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names, &names_count,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, cdbus_g_dbus_error.message);
+    dbus_error_free(&cdbus_g_dbus_error);
+    return;
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(bas)", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  for (i = 0; i < names_count; i++)
+  {
+    entry_ptr = appdb_db_find(names[i]);
+    found = entry_ptr != NULL;
+
+    if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_BOOLEAN, &found) ||
+        !appdb_dbus_append_fields(&struct_iter, entry_ptr, (1 << APPDB_FIELD_COUNT) - 1))
+    {
+      dbus_message_iter_abandon_container(&array_iter, &struct_iter);
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  goto free_names;
+
+fail_abandon:
+  dbus_message_iter_abandon_container(&iter, &array_iter);
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+free_names:
+  dbus_free_string_array((char **)names);
+}
+
+/* Pages are in order of the name view. Cursor is generation of the database and position of the
+ * next page; it is not valid after a reload, as the position could skip or repeat entries. */
+static void appdb_dbus_list(struct cdbus_method_call * call_ptr)
+{
+  const char * cursor;
+  dbus_uint32_t page_size;
+  dbus_uint32_t fields;
+  unsigned int generation;
+  size_t position;
+  char c;
+  struct appdb_entry * const * entries;
+  size_t count;
+  size_t end;
+  char next[32];
+  const char * next_ptr;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  DBusError error;
+
+  dbus_error_init(&error);
+  if (!dbus_message_get_args(
+        call_ptr->message,
+        &error,
+        DBUS_TYPE_STRING, &cursor,
+        DBUS_TYPE_UINT32, &page_size,
+        DBUS_TYPE_UINT32, &fields,
+        DBUS_TYPE_INVALID))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Invalid arguments to method \"%s\": %s", call_ptr->method_name, error.message);
+    dbus_error_free(&error);
+    return;
+  }
+
+  if (page_size == 0 || page_size > LIST_PAGE_LIMIT)
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Page size must be between 1 and %u", LIST_PAGE_LIMIT);
+    return;
+  }
+
+  if (fields >= (1 << APPDB_FIELD_COUNT))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Unknown fields 0x%x", (unsigned int)fields);
+    return;
+  }
+
+  if (fields == 0)
+  {
+    fields = (1 << APPDB_FIELD_COUNT) - 1;
+  }
+
+  position = 0;
+  if (*cursor != 0 &&
+      (sscanf(cursor, "%u:%zu%c", &generation, &position, &c) != 2 || generation != appdb_db_generation()))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_INVALID_ARGS, "Cursor '%s' is not valid, database was reloaded since it was returned", cursor);
+    return;
+  }
+
+  /* view is not built while loading */
+  count = 0;
+  entries = NULL;
+  if (g_appdb_name_view != NULL)
+  {
+    entries = appdb_sorted_view_get(g_appdb_name_view, &count);
+  }
+
+  if (position > count)
+  {
+    position = count;
+  }
+
+  end = count - position > page_size ? position + page_size : count;
+
+  next[0] = 0;
+  if (end < count)
+  {
+    sprintf(next, "%u:%zu", appdb_db_generation(), end);
+  }
+
+  next_ptr = next;
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &next_ptr) ||
+      !dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "as", &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  for (; position < end; position++)
+  {
+    if (!appdb_dbus_append_fields(&array_iter, entries[position], fields))
+    {
+      goto fail_abandon;
+    }
+  }
+
+  if (!dbus_message_iter_close_container(&iter, &array_iter))
+  {
+    goto fail_unref;
+  }
+
+  return;
+
+fail_abandon:
+  dbus_message_iter_abandon_container(&iter, &array_iter);
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+}
+
+static void appdb_dbus_reply_unref(void * reply)
+{
+  dbus_message_unref(reply);
+}
+
+/* Replies of methods that return large parts of the database are kept marshalled in the query cache,
+ * and are answered with a copy that differs only in serial and destination. Results of TryExec checks
+ * are valid only until contents of the $PATH directories change. */
+static void appdb_dbus_bulk(struct cdbus_method_call * call_ptr, void (* handler)(struct cdbus_method_call * call_ptr), bool tryexec)
+{
+  char * key;
+  char * path_key;
+  char generation[32];
+  DBusMessage * reply;
+  char * marshalled;
+  int len;
+
+  key = appdb_dbus_query_key(call_ptr);
+  if (key != NULL && tryexec)
+  {
+    snprintf(generation, sizeof(generation), "path %u", appdb_path_generation());
+    path_key = catdup(key, generation);
+    free(key);
+    key = path_key;
+  }
+
+  appdb_qcache_lock();
+  reply = key != NULL ? (DBusMessage *)appdb_qcache_get(key) : NULL;
+  if (reply != NULL)
+  {
+    call_ptr->reply = dbus_message_copy(reply);
+    appdb_qcache_unlock();
+
+    if (call_ptr->reply == NULL ||
+        !dbus_message_set_reply_serial(call_ptr->reply, dbus_message_get_serial(call_ptr->message)) ||
+        !dbus_message_set_destination(call_ptr->reply, dbus_message_get_sender(call_ptr->message)))
+    {
+      log_error("Ran out of memory trying to construct method return");
+      if (call_ptr->reply != NULL)
+      {
+        dbus_message_unref(call_ptr->reply);
+        call_ptr->reply = NULL;
+      }
+    }
+
+    free(key);
+    return;
+  }
+
+  appdb_qcache_unlock();
+
+  handler(call_ptr);
+
+  /* errors are not cached */
+  if (key == NULL || call_ptr->reply == NULL || dbus_message_get_type(call_ptr->reply) != DBUS_MESSAGE_TYPE_METHOD_RETURN)
+  {
+    free(key);
+    return;
+  }
+
+  /* size is needed for the accounting; marshalling is done once per generation */
+  len = 0;
+  if (dbus_message_marshal(call_ptr->reply, &marshalled, &len))
+  {
+    dbus_free(marshalled);
+  }
+
+  /* the reply is sent by the main loop, which sets its serial, while a worker could be copying the cached one */
+  reply = dbus_message_copy(call_ptr->reply);
+  if (reply != NULL && !appdb_qcache_put_object(key, reply, appdb_dbus_reply_unref, len))
+  {
+    dbus_message_unref(reply);
+  }
+
+  free(key);
+}
+
+static void appdb_dbus_get_categories_cached(struct cdbus_method_call * call_ptr)
+{
+  appdb_dbus_bulk(call_ptr, appdb_dbus_get_categories, false);
+}
+
+static void appdb_dbus_get_session_applications_cached(struct cdbus_method_call * call_ptr)
+{
+  appdb_dbus_bulk(call_ptr, appdb_dbus_get_session_applications, false);
+}
+
+static void appdb_dbus_get_visible_cached(struct cdbus_method_call * call_ptr)
+{
+  appdb_dbus_bulk(call_ptr, appdb_dbus_get_visible, true);
+}
+
+static void appdb_dbus_get_sorted_cached(struct cdbus_method_call * call_ptr)
+{
+  appdb_dbus_bulk(call_ptr, appdb_dbus_get_sorted, false);
+}
+
+static void appdb_dbus_get_all_if_changed_cached(struct cdbus_method_call * call_ptr)
+{
+  appdb_dbus_bulk(call_ptr, appdb_dbus_get_all_if_changed, false);
+}
+
+static void appdb_dbus_list_cached(struct cdbus_method_call * call_ptr)
+{
+  appdb_dbus_bulk(call_ptr, appdb_dbus_list, false);
+}
+
+/* Methods that scan much of the database are handled by the workers, each with a limit of calls
+ * handled at once, so that a burst of one of them does not take the whole pool. The other methods
+ * are cheap lookups, they are handled by the main loop right away and never wait behind the scans.
+ * Handlers of the deferred methods do not use cdbus_g_dbus_error, as they run in parallel. */
+static void appdb_dbus_defer(struct cdbus_method_call * call_ptr, cdbus_method_handler handler, struct appdb_workers_limit * limit_ptr)
+{
+  /* the main loop holds the database lock shared while it dispatches, same as the workers */
+  if (!appdb_workers_submit(call_ptr, handler, limit_ptr))
+  {
+    handler(call_ptr);
+  }
+}
+
+static void appdb_dbus_get_categories_deferred(struct cdbus_method_call * call_ptr)
+{
+  static struct appdb_workers_limit limit = { .max = 1 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_get_categories_cached, &limit);
+}
+
+static void appdb_dbus_query_categories_deferred(struct cdbus_method_call * call_ptr)
+{
+  static struct appdb_workers_limit limit = { .max = 2 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_query_categories, &limit);
+}
+
+static void appdb_dbus_fuzzy_search_deferred(struct cdbus_method_call * call_ptr)
+{
+  /* the search itself is split to threads when there are many entries */
+  static struct appdb_workers_limit limit = { .max = 2 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_fuzzy_search, &limit);
+}
+
+static void appdb_dbus_get_session_applications_deferred(struct cdbus_method_call * call_ptr)
+{
+  static struct appdb_workers_limit limit = { .max = 1 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_get_session_applications_cached, &limit);
+}
+
+static void appdb_dbus_get_visible_deferred(struct cdbus_method_call * call_ptr)
+{
+  static struct appdb_workers_limit limit = { .max = 1 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_get_visible_cached, &limit);
+}
+
+static void appdb_dbus_get_sorted_deferred(struct cdbus_method_call * call_ptr)
+{
+  static struct appdb_workers_limit limit = { .max = 1 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_get_sorted_cached, &limit);
+}
+
+static void appdb_dbus_get_all_if_changed_deferred(struct cdbus_method_call * call_ptr)
+{
+  static struct appdb_workers_limit limit = { .max = 1 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_get_all_if_changed_cached, &limit);
+}
+
+static void appdb_dbus_list_deferred(struct cdbus_method_call * call_ptr)
+{
+  /* pages of a listing are requested one after another, more of them are from different clients */
+  static struct appdb_workers_limit limit = { .max = 2 };
+  appdb_dbus_defer(call_ptr, appdb_dbus_list_cached, &limit);
+}
+
+void appdb_control_stream(void * UNUSED(ctx), unsigned int event, struct appdb_entry * entry_ptr)
+{
+  const char * icon;
+
+  if (event == APPDB_STREAM_ADD)
+  {
+    icon = entry_ptr->icon != NULL ? entry_ptr->icon : "";
+    cdbus_signal_emit(cdbus_g_dbus_connection, APPDB_DBUS_OBJECT_PATH, APPDB_DBUS_IFACE, "EntryAdded", "ss", &entry_ptr->name, &icon);
+  }
+  else
+  {
+    cdbus_signal_emit(cdbus_g_dbus_connection, APPDB_DBUS_OBJECT_PATH, APPDB_DBUS_IFACE, "EntryRetracted", "s", &entry_ptr->name);
+  }
+}
+
+void appdb_control_emit_ready(void)
+{
+  struct list_head * node_ptr;
+  dbus_uint32_t count;
+
+  count = 0;
+  list_for_each(node_ptr, &g_appdb)
+  {
+    count++;
+  }
+
+  cdbus_signal_emit(cdbus_g_dbus_connection, APPDB_DBUS_OBJECT_PATH, APPDB_DBUS_IFACE, "Ready", "u", &count);
+}
+
+/* append a(st) array of names and sizes in bytes */
+static bool appdb_dbus_append_memory(DBusMessageIter * iter_ptr, const char * const * names, const size_t * sizes, size_t count)
+{
+  DBusMessageIter array_iter;
+  DBusMessageIter struct_iter;
+  dbus_uint64_t size;
+  size_t i;
+
+  if (!dbus_message_iter_open_container(iter_ptr, DBUS_TYPE_ARRAY, "(st)", &array_iter))
+  {
+    return false;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    size = sizes[i];
+
+    if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, names + i) ||
+        !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &size))
+    {
+      dbus_message_iter_abandon_container(&array_iter, &struct_iter);
+      goto fail_abandon;
+    }
+
+    if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+    {
+      goto fail_abandon;
+    }
+  }
+
+  return dbus_message_iter_close_container(iter_ptr, &array_iter);
+
+fail_abandon:
+  dbus_message_iter_abandon_container(iter_ptr, &array_iter);
+  return false;
+}
+
+static void appdb_dbus_get_memory_usage(struct cdbus_method_call * call_ptr)
+{
+  static const char * const index_names[] =
+  {
+    "mime_index",
+    "category_index",
+    "complete_index",
+    "sorted_views",
+    "fuzzy_index",
+    "session_index",
+    "name_index",
+    "visible_cache",
+    "path_cache",
+    "query_cache",
+    "parser_buffer_peak",
+  };
+  struct appdb_db_memory memory;
+  const char * field_names[APPDB_MEMORY_COUNT];
+  size_t index_sizes[sizeof(index_names) / sizeof(index_names[0])];
+  size_t dirs_count;
+  unsigned int i;
+  DBusMessageIter iter;
+
+  if (!appdb_db_memory_get(&memory))
+  {
+    cdbus_error(call_ptr, DBUS_ERROR_FAILED, "Memory accounting failed");
+    return;
+  }
+
+  for (i = 0; i < APPDB_MEMORY_COUNT; i++)
+  {
+    field_names[i] = appdb_memory_category_name(i);
+  }
+
+  for (dirs_count = 0; memory.dirs[dirs_count] != NULL; dirs_count++);
+
+  index_sizes[0] = memory.mime_index;
+  index_sizes[1] = memory.category_index;
+  index_sizes[2] = memory.complete_index;
+  index_sizes[3] = memory.sorted_views;
+  index_sizes[4] = memory.fuzzy_index;
+  index_sizes[5] = memory.session_index;
+  index_sizes[6] = memory.name_index;
+  index_sizes[7] = memory.visible_cache;
+  index_sizes[8] = memory.path_cache;
+  index_sizes[9] = memory.query_cache;
+  index_sizes[10] = memory.parser_buffer_peak;
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL)
+  {
+    goto fail;
+  }
+
+  dbus_message_iter_init_append(call_ptr->reply, &iter);
+
+  if (!appdb_dbus_append_memory(&iter, field_names, memory.fields, APPDB_MEMORY_COUNT) ||
+      !appdb_dbus_append_memory(&iter, (const char * const *)memory.dirs, memory.dirs_usage, dirs_count) ||
+      !appdb_dbus_append_memory(&iter, index_names, index_sizes, sizeof(index_names) / sizeof(index_names[0])))
+  {
+    goto fail_unref;
+  }
+
+  appdb_db_memory_free(&memory);
+  return;
+
+fail_unref:
+  dbus_message_unref(call_ptr->reply);
+  call_ptr->reply = NULL;
+fail:
+  log_error("Ran out of memory trying to construct method return");
+  appdb_db_memory_free(&memory);
+}
+
+static void appdb_dbus_get_query_cache_stats(struct cdbus_method_call * call_ptr)
+{
+  uint64_t hits;
+  uint64_t misses;
+  size_t count;
+  dbus_uint64_t dbus_hits;
+  dbus_uint64_t dbus_misses;
+  dbus_uint32_t dbus_count;
+
+  appdb_qcache_stats(&hits, &misses, &count);
+  dbus_hits = hits;
+  dbus_misses = misses;
+  dbus_count = count;
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_UINT64, &dbus_hits,
+        DBUS_TYPE_UINT64, &dbus_misses,
+        DBUS_TYPE_UINT32, &dbus_count,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+}
+
+static void appdb_dbus_get_fast_path_socket(struct cdbus_method_call * call_ptr)
+{
+  const char * path;
+
+  path = appdb_fastpath_socket();
+  if (path == NULL)
+  {
+    path = "";
+  }
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_STRING, &path,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+}
+
+static void appdb_dbus_is_ready(struct cdbus_method_call * call_ptr)
+{
+  dbus_bool_t ready;
+
+  ready = appdb_db_is_ready();
+
+  call_ptr->reply = dbus_message_new_method_return(call_ptr->message);
+  if (call_ptr->reply == NULL ||
+      !dbus_message_append_args(
+        call_ptr->reply,
+        DBUS_TYPE_BOOLEAN, &ready,
+        DBUS_TYPE_INVALID))
+  {
+    log_error("Ran out of memory trying to construct method return");
+    if (call_ptr->reply != NULL)
+    {
+      dbus_message_unref(call_ptr->reply);
+      call_ptr->reply = NULL;
+    }
+  }
+}
+
+CDBUS_METHOD_ARGS_BEGIN(Launch, "Start application")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("name", "s", "Name of the application")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("uris", "as", "Files or URIs to open, can be empty")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("pids", "ai", "Process IDs of the started processes, one per URI if application does not accept list of them")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(ResolveIcons, "Find icon files for icon names")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("names", "as", "Icon names, as in the Icon key of desktop entries")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("size", "u", "Desired icon size in pixels")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("paths", "as", "Icon file paths, in same order as names; empty string for icons that were not found")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetHandlers, "Get applications that can open files of a MIME type")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("mime_type", "s", "MIME type, for example \"audio/x-wav\"")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("names", "as", "Names of the applications in order of preference, the default application first")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetHandlersMany, "Get applications that can open files of several MIME types")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("mime_types", "as", "MIME types")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("names", "aas", "For each of the MIME types, same as the result of GetHandlers")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetCategories, "Get categories of the applications")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("categories", "a(su)", "Category names with number of applications in them")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(QueryCategories, "Find applications by categories")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("all", "as", "Categories the application must be in, all of them")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("any", "as", "Categories the application must be in, at least one of them; empty for no constraint")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("none", "as", "Categories the application must not be in")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("names", "as", "Names of the matching applications")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(Complete, "Complete prefix of application name, generic name or executable name, ignoring case")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("prefix", "s", "What the user typed so far")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("limit", "u", "Maximum number of returned applications, 0 for no limit")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("names", "as", "Names of the matching applications, ordered by the matching name")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(FuzzySearch, "Find applications whose name contains the query characters in same order, ignoring case")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("query", "s", "What the user typed so far, for example \"ardr\" for \"Ardour\"")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("k", "u", "Maximum number of returned applications")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("matches", "a(su)", "Names of the best matching applications and their scores, best first")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetSessionApplications, "Get applications that support session management")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("protocols", "u", "Bitmask of protocols to return applications for, 1 for LASH/LADISH, 2 for NSM; 0 for all")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("applications", "a(suss)", "Name, bitmask of supported protocols, LASH class and NSM executable (empty if not set) of the applications")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetVisible, "Get applications that should be shown in menus of a desktop environment")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("desktops", "s", "Colon separated desktop names, as in XDG_CURRENT_DESKTOP, for example \"KDE\"; empty for none")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("names", "as", "Names of the applications that are not hidden and whose TryExec executable exists, ordered by name")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetSorted, "Get all applications in order of the collation rules of the locale")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("field", "s", "One of \"name\" or \"generic_name\"; applications without generic name are last, ordered by name")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("names", "as", "Names of the applications")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetDigest, "Get digest of the database, it changes when any application is added, removed or changed")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("digest", "s", "Digest of all applications, hexadecimal; empty while loading")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("directories", "a(ss)", "Applications directories and digests of the applications loaded from them")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetAllIfChanged, "Get all applications, unless the database did not change since the client got them")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("digest", "s", "Digest the client got with the applications it has; empty if it has none")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("digest", "s", "Current digest of the database, as returned by GetDigest")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("modified", "b", "False if digest is same as the one of the client, then the applications are not returned")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("applications", "a(sss)", "Name, desktop file ID and icon (empty if not set) of the applications")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetEntries, "Get applications by name, many at once")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("names", "as", "Names of the applications")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("applications", "a(bas)", "For each of the names, whether the application was found, and its name, generic name, comment, icon, exec, path and try exec (empty if not set)")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(List, "Get all applications, ordered by name, in pages")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("cursor", "s", "Empty for the first page, then the cursor returned with the previous page")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("page_size", "u", "Maximum number of applications in the page, at most 1024")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("fields", "u", "Bitmask of fields to return, 1 name, 2 generic name, 4 comment, 8 icon, 16 exec, 32 path, 64 try exec; 0 for all")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("cursor", "s", "Cursor of the next page, empty if this is the last one; it is rejected if the database changes meanwhile")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("applications", "aas", "Values of the requested fields, in order of their bits (empty if not set)")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetMemoryUsage, "Get memory used by the database, in bytes of heap blocks")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("fields", "a(st)", "Memory used by entries, by field")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("directories", "a(st)", "Memory used by entries, by applications directory they were loaded from")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("indexes", "a(st)", "Memory used by indexes and caches, and size of the largest parser buffer")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetQueryCacheStats, "Get statistics of the cache of query results and of replies of the methods that return many applications")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("hits", "t", "Number of queries answered from the cache")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("misses", "t", "Number of queries that were not in the cache")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("count", "u", "Number of cached results")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(GetFastPathSocket, "Get path of the unix socket for the binary protocol of appdb/fastpath.h")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("path", "s", "Path of the SOCK_SEQPACKET socket, empty if the fast path is not available")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(IsReady, "Check whether loading of the database is finished")
+  CDBUS_METHOD_ARG_DESCRIBE_OUT("ready", "b", "False while loading, results of the other methods are empty until then")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHOD_ARGS_BEGIN(SetLogLevel, "Set minimum level of messages logged by a subsystem")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("subsystem", "s", "One of \"core\", \"loader\", \"parser\", \"dbus\", \"watcher\" or \"all\"")
+  CDBUS_METHOD_ARG_DESCRIBE_IN("level", "s", "One of \"debug\", \"info\", \"warn\" or \"error\"")
+CDBUS_METHOD_ARGS_END
+
+CDBUS_METHODS_BEGIN
+  CDBUS_METHOD_DESCRIBE(Launch, appdb_dbus_launch)
+  CDBUS_METHOD_DESCRIBE(ResolveIcons, appdb_dbus_resolve_icons)
+  CDBUS_METHOD_DESCRIBE(GetHandlers, appdb_dbus_get_handlers)
+  CDBUS_METHOD_DESCRIBE(GetHandlersMany, appdb_dbus_get_handlers_many)
+  CDBUS_METHOD_DESCRIBE(GetCategories, appdb_dbus_get_categories_deferred)
+  CDBUS_METHOD_DESCRIBE(QueryCategories, appdb_dbus_query_categories_deferred)
+  CDBUS_METHOD_DESCRIBE(Complete, appdb_dbus_complete)
+  CDBUS_METHOD_DESCRIBE(FuzzySearch, appdb_dbus_fuzzy_search_deferred)
+  CDBUS_METHOD_DESCRIBE(GetSessionApplications, appdb_dbus_get_session_applications_deferred)
+  CDBUS_METHOD_DESCRIBE(GetVisible, appdb_dbus_get_visible_deferred)
+  CDBUS_METHOD_DESCRIBE(GetSorted, appdb_dbus_get_sorted_deferred)
+  CDBUS_METHOD_DESCRIBE(GetDigest, appdb_dbus_get_digest)
+  CDBUS_METHOD_DESCRIBE(GetAllIfChanged, appdb_dbus_get_all_if_changed_deferred)
+  CDBUS_METHOD_DESCRIBE(GetEntries, appdb_dbus_get_entries)
+  CDBUS_METHOD_DESCRIBE(List, appdb_dbus_list_deferred)
+  CDBUS_METHOD_DESCRIBE(GetMemoryUsage, appdb_dbus_get_memory_usage)
+  CDBUS_METHOD_DESCRIBE(GetQueryCacheStats, appdb_dbus_get_query_cache_stats)
+  CDBUS_METHOD_DESCRIBE(GetFastPathSocket, appdb_dbus_get_fast_path_socket)
+  CDBUS_METHOD_DESCRIBE(IsReady, appdb_dbus_is_ready)
+  CDBUS_METHOD_DESCRIBE(SetLogLevel, appdb_dbus_set_log_level)
+CDBUS_METHODS_END
+
+CDBUS_SIGNAL_ARGS_BEGIN(EntryAdded, "Application was found while loading the database")
+  CDBUS_SIGNAL_ARG_DESCRIBE("name", "s", "Name of the application")
+  CDBUS_SIGNAL_ARG_DESCRIBE("icon", "s", "Icon name, empty if not set")
+CDBUS_SIGNAL_ARGS_END
+
+CDBUS_SIGNAL_ARGS_BEGIN(EntryRetracted, "Application reported by EntryAdded is not in the database anymore")
+  CDBUS_SIGNAL_ARG_DESCRIBE("name", "s", "Name of the application")
+CDBUS_SIGNAL_ARGS_END
+
+CDBUS_SIGNAL_ARGS_BEGIN(Ready, "Loading of the database is finished")
+  CDBUS_SIGNAL_ARG_DESCRIBE("count", "u", "Number of applications")
+CDBUS_SIGNAL_ARGS_END
+
+CDBUS_SIGNALS_BEGIN
+  CDBUS_SIGNAL_DESCRIBE(EntryAdded)
+  CDBUS_SIGNAL_DESCRIBE(EntryRetracted)
+  CDBUS_SIGNAL_DESCRIBE(Ready)
+CDBUS_SIGNALS_END
+
+CDBUS_INTERFACE_BEGIN(g_appdb_interface_control, APPDB_DBUS_IFACE)
+  CDBUS_INTERFACE_DEFAULT_HANDLER
+  CDBUS_INTERFACE_EXPOSE_METHODS
+  CDBUS_INTERFACE_EXPOSE_SIGNALS
+CDBUS_INTERFACE_END
@@ -0,0 +1,27 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ************************************************************
+ * This file contains interface of the D-Bus control object *
+ ************************************************************/
+
+#ifndef CONTROL_H__0E5A7C4B_2E52_4C7C_9F0A_6D1B3F4E8A21__INCLUDED
+#define CONTROL_H__0E5A7C4B_2E52_4C7C_9F0A_6D1B3F4E8A21__INCLUDED
+
+#include <cdbus/cdbus.h>
+
+#include "common.h"
+
+extern const struct cdbus_interface_descriptor g_appdb_interface_control;
+
+/* appdb_stream_callback that emits the EntryAdded and EntryRetracted signals */
+void appdb_control_stream(void * ctx, unsigned int event, struct appdb_entry * entry_ptr);
+
+/* emit the Ready signal, when the database is loaded */
+void appdb_control_emit_ready(void);
+
+#endif /* #ifndef CONTROL_H__0E5A7C4B_2E52_4C7C_9F0A_6D1B3F4E8A21__INCLUDED */
@@ -12,15 +12,47 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <locale.h>
+#include <errno.h>
+#include <poll.h>
+#include <getopt.h>
+#include <time.h>
 //#include <sys/stat.h>
 
 #include <cdbus/cdbus.h>
 
 #include "common.h"
+#include "control.h"
+#include "db.h"
+#include "watcher.h"
+#include "icons.h"
+#include "path.h"
+#include "qcache.h"
+#include "fastpath.h"
+#include "workers.h"
+#include "probes.h"
 
 bool g_quit;
 const char * g_dbus_unique_name;
-//cdbus_object_path g_control_object;
+cdbus_object_path g_control_object;
+
+#if defined(HAVE_SYS_SDT_H)
+/* filters see each message before it is dispatched to the object path handlers */
+static DBusHandlerResult probe_filter(DBusConnection * UNUSED(connection), DBusMessage * message, void * UNUSED(data))
+{
+  if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL)
+  {
+    APPDB_PROBE4(
+      dbus__method,
+      dbus_message_get_sender(message),
+      dbus_message_get_interface(message),
+      dbus_message_get_member(message),
+      dbus_message_get_serial(message));
+  }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+#endif
 
 static bool connect_dbus(void)
 {
@@ -28,6 +60,13 @@ static bool connect_dbus(void)
 
   dbus_error_init(&cdbus_g_dbus_error);
 
+  /* entries are streamed from the loader thread */
+  if (!dbus_threads_init_default())
+  {
+    log_error("Failed to initialize D-Bus thread support");
+    goto fail;
+  }
+
   cdbus_g_dbus_connection = dbus_bus_get(DBUS_BUS_SESSION, &cdbus_g_dbus_error);
   if (dbus_error_is_set(&cdbus_g_dbus_error))
   {
@@ -63,8 +102,7 @@ static bool connect_dbus(void)
     goto unref_connection;
   }
 
-#if 0
-  g_control_object = cdbus_object_path_new(CONTROL_OBJECT_PATH, &g_lashd_interface_control, NULL, NULL);
+  g_control_object = cdbus_object_path_new(APPDB_DBUS_OBJECT_PATH, &g_appdb_interface_control, NULL, NULL);
   if (g_control_object == NULL)
   {
     goto unref_connection;
@@ -74,14 +112,19 @@ static bool connect_dbus(void)
   {
     goto destroy_control_object;
   }
+
+#if defined(HAVE_SYS_SDT_H)
+  if (!dbus_connection_add_filter(cdbus_g_dbus_connection, probe_filter, NULL, NULL))
+  {
+    /* not fatal, only tracing of the method calls is not possible */
+    log_error("Failed to add D-Bus filter for the tracepoints");
+  }
 #endif
 
   return true;
 
-#if 0
 destroy_control_object:
   cdbus_object_path_destroy(cdbus_g_dbus_connection, g_control_object);
-#endif
 unref_connection:
   dbus_connection_unref(cdbus_g_dbus_connection);
 
@@ -91,12 +134,119 @@ fail:
 
 static void disconnect_dbus(void)
 {
-  //cdbus_object_path_destroy(cdbus_g_dbus_connection, g_control_object);
+#if defined(HAVE_SYS_SDT_H)
+  dbus_connection_remove_filter(cdbus_g_dbus_connection, probe_filter, NULL);
+#endif
+  cdbus_object_path_destroy(cdbus_g_dbus_connection, g_control_object);
   dbus_connection_unref(cdbus_g_dbus_connection);
   cdbus_call_last_error_cleanup();
   log_info("Disconnected from local session bus");
 }
 
+/* wait until a message can be read from the bus or written to it, until a worker finished a call */
+/* or until the watcher has events; returns true in the last case */
+static bool wait_for_events(int timeout)
+{
+  struct pollfd fds[3];
+  nfds_t count;
+  nfds_t watcher;
+  int fd;
+
+  count = 0;
+
+  if (dbus_connection_get_unix_fd(cdbus_g_dbus_connection, &fd))
+  {
+    fds[count].fd = fd;
+    fds[count].events = POLLIN;
+    if (dbus_connection_has_messages_to_send(cdbus_g_dbus_connection))
+    {
+      fds[count].events |= POLLOUT;
+    }
+
+    count++;
+  }
+
+  fd = appdb_workers_fd();
+  if (fd != -1)
+  {
+    fds[count].fd = fd;
+    fds[count].events = POLLIN;
+    count++;
+  }
+
+  watcher = count;
+  fd = appdb_watcher_fd();
+  if (fd != -1)
+  {
+    fds[count].fd = fd;
+    fds[count].events = POLLIN;
+    fds[count].revents = 0;
+    count++;
+  }
+
+  if (poll(fds, count, timeout) == -1)
+  {
+    if (errno != EINTR)
+    {
+      log_error("poll() failed: %s", strerror(errno));
+    }
+
+    return false;
+  }
+
+  return watcher < count && (fds[watcher].revents & POLLIN) != 0;
+}
+
+static time_t monotonic_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec;
+}
+
+/* returns false if the command line is invalid */
+static bool parse_command_line(int argc, char ** argv, unsigned long * idle_timeout_ptr)
+{
+  static const struct option options[] =
+  {
+    {"idle-timeout", required_argument, NULL, 't'},
+    {NULL, 0, NULL, 0}
+  };
+  int option;
+  char * end;
+
+  *idle_timeout_ptr = 0;
+
+  while ((option = getopt_long(argc, argv, "t:", options, NULL)) != -1)
+  {
+    switch (option)
+    {
+    case 't':
+      errno = 0;
+      *idle_timeout_ptr = strtoul(optarg, &end, 10);
+      if (errno != 0 || end == optarg || *end != 0)
+      {
+        log_error("Invalid idle timeout \"%s\"", optarg);
+        return false;
+      }
+      break;
+    default:
+      log_error("Usage: %s [--idle-timeout=SECONDS]", argv[0]);
+      return false;
+    }
+  }
+
+  if (optind < argc)
+  {
+    log_error("Unexpected argument \"%s\"", argv[optind]);
+    return false;
+  }
+
+  return true;
+}
+
 void term_signal_handler(int signum)
 {
   log_info("Caught signal %d (%s), terminating", signum, strsignal(signum));
@@ -122,13 +272,28 @@ bool install_term_signal_handler(int signum, bool ignore_if_already_ignored)
   return true;
 }
 
-int main(int UNUSED(argc), char ** UNUSED(argv))
+int main(int argc, char ** argv)
 {
   int ret;
-  struct list_head apps_list;
+  bool loaded;
+  unsigned long idle_timeout;
+  time_t last_activity;
+  bool released;
+  bool dispatched;
+  bool watcher_events;
 
   ret = EXIT_FAILURE;
 
+  /* 0 is no timeout, when started by D-Bus activation it is set in the .service file */
+  if (!parse_command_line(argc, argv, &idle_timeout))
+  {
+    goto exit;
+  }
+
+  /* case folding and sorting of names follow the locale of the session */
+  setlocale(LC_CTYPE, "");
+  setlocale(LC_COLLATE, "");
+
   /* install the signal handlers */
   install_term_signal_handler(SIGTERM, false);
   install_term_signal_handler(SIGINT, true);
@@ -138,30 +303,161 @@ int main(int UNUSED(argc), char ** UNUSED(argv))
     log_error("signal(SIGPIPE, SIG_IGN).");
   }
 
-  if (!appdb_load(&apps_list))
+  /* applications started by the Launch method are not waited for */
+  if (signal(SIGCHLD, SIG_IGN) == SIG_ERR)
+  {
+    log_error("signal(SIGCHLD, SIG_IGN).");
+  }
+
+  if (!appdb_watcher_init())
   {
-    log_error("Loading of appdb failed");
     goto exit;
   }
 
+  if (!appdb_icons_init())
+  {
+    log_error("Icon resolver initialization failed");
+    goto uninit_watcher;
+  }
+
+  if (!appdb_path_init())
+  {
+    log_error("Executable resolver initialization failed");
+    goto uninit_icons;
+  }
+
+  if (!appdb_qcache_init())
+  {
+    log_error("Query cache initialization failed");
+    goto uninit_path;
+  }
+
+  /* acquire the bus name first, so activation does not wait for the scan */
   if (!connect_dbus())
   {
     log_error("Failed to connect to D-Bus");
-    goto free_appdb;
+    goto uninit_qcache;
   }
 
+  if (!appdb_db_load_start(appdb_control_stream, NULL))
+  {
+    goto uninit_dbus;
+  }
+
+  /* loaded from the snapshot */
+  if (appdb_db_is_ready())
+  {
+    appdb_control_emit_ready();
+  }
+
+  /* optional, clients fall back to D-Bus */
+  appdb_fastpath_start();
+
+  /* optional, the main loop handles all method calls without it */
+  appdb_workers_start();
+
+  last_activity = monotonic_seconds();
+  released = false;
+
   while (!g_quit)
   {
-    dbus_connection_read_write_dispatch(cdbus_g_dbus_connection, 200);
+    /* while loading, poll more often so the streamed signals are sent without much delay */
+    watcher_events = wait_for_events(appdb_db_is_ready() ? 200 : 20);
+    dbus_connection_read_write(cdbus_g_dbus_connection, 0);
+
+    appdb_workers_dispatch();
+
+    dispatched = dbus_connection_get_dispatch_status(cdbus_g_dbus_connection) == DBUS_DISPATCH_DATA_REMAINS;
+
+    /* method calls only read the database, so the workers and the fast path thread can read it meanwhile */
+    appdb_db_lock_shared();
+    while (dbus_connection_dispatch(cdbus_g_dbus_connection) == DBUS_DISPATCH_DATA_REMAINS);
+    appdb_db_unlock();
+
+    if (dispatched || !appdb_workers_idle())
+    {
+      last_activity = monotonic_seconds();
+    }
+    else if (released)
+    {
+      /* calls that were sent to the name before it was released are answered, */
+      /* fast path clients reconnect to the next instance */
+      log_info("Exiting after %lu seconds of inactivity", idle_timeout);
+      dbus_connection_flush(cdbus_g_dbus_connection);
+      break;
+    }
+    else if (appdb_fastpath_clients() != 0 || !appdb_db_is_ready())
+    {
+      last_activity = monotonic_seconds();
+    }
+    else if (idle_timeout != 0 && monotonic_seconds() - last_activity >= (time_t)idle_timeout)
+    {
+      /* from now on, calls to the name start next instance of the daemon, through D-Bus activation */
+      if (dbus_bus_release_name(cdbus_g_dbus_connection, APPDB_DBUS_SERVICE_NAME, &cdbus_g_dbus_error) == -1)
+      {
+        log_error("Failed to release bus name: %s", cdbus_g_dbus_error.message);
+        dbus_error_free(&cdbus_g_dbus_error);
+        last_activity = monotonic_seconds();
+      }
+      else
+      {
+        released = true;
+      }
+    }
+
+    /* exclusive lock waits for queries of the workers and of the fast path thread to finish, */
+    /* and new queries wait for it, so it is taken only when there is something to change */
+    if (!watcher_events && !appdb_db_update_pending())
+    {
+      continue;
+    }
+
+    appdb_db_lock();
+
+    appdb_watcher_dispatch();
+
+    if (!appdb_db_is_ready())
+    {
+      if (!appdb_db_load_poll(&loaded))
+      {
+        appdb_db_unlock();
+        log_error("Loading of appdb failed");
+        goto free_appdb;
+      }
+
+      if (loaded)
+      {
+        appdb_control_emit_ready();
+      }
+    }
+    else
+    {
+      appdb_db_reload_if_changed();
+    }
+
+    appdb_db_unlock();
   }
 
   ret = EXIT_SUCCESS;
 
-//uninit_dbus:
-  disconnect_dbus();
-
 free_appdb:
-  appdb_free(&apps_list);
+  appdb_workers_stop();
+  appdb_fastpath_stop();
+
+  /* next instance starts from it, without scanning the .desktop files */
+  appdb_db_save_snapshot();
+
+  appdb_db_free();
+uninit_dbus:
+  disconnect_dbus();
+uninit_qcache:
+  appdb_qcache_uninit();
+uninit_path:
+  appdb_path_uninit();
+uninit_icons:
+  appdb_icons_uninit();
+uninit_watcher:
+  appdb_watcher_uninit();
 exit:
   return ret;
 }
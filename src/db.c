@@ -0,0 +1,1144 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ************************************************************
+ * This file contains implementation of the daemon database *
+ ************************************************************/
+
+#define _GNU_SOURCE              /* PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "db.h"
+#include "catdup.h"
+#include "digest.h"
+#include "fuzzy.h"
+#include "hash.h"
+#include "path.h"
+#include "qcache.h"
+#include "strlist.h"
+#include "watcher.h"
+#include "xdg.h"
+
+#define VISIBLE_CACHE_LIMIT 64
+
+#define SNAPSHOT_DIR "/appdb"
+#define SNAPSHOT_FILE "/snapshot"
+
+#define DB_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB)
+
+/* value of the visible cache */
+struct appdb_db_visible
+{
+  unsigned int path_generation; /* TryExec results depend on contents of $PATH directories */
+  size_t count;
+  struct appdb_entry * entries[];
+};
+
+struct list_head g_appdb;
+struct appdb_mime_index * g_appdb_mime_index;
+struct appdb_category_index * g_appdb_category_index;
+struct appdb_complete_index * g_appdb_complete_index;
+struct appdb_sorted_view * g_appdb_name_view;
+struct appdb_sorted_view * g_appdb_generic_name_view;
+struct appdb_fuzzy * g_appdb_fuzzy;
+struct appdb_entry ** g_appdb_session_entries;
+size_t g_appdb_session_entries_count;
+static struct appdb_hash * g_appdb_visible_cache; /* desktops -> struct appdb_db_visible */
+static struct appdb_hash * g_appdb_name_index; /* name -> entry, names are unique in g_appdb */
+static int * g_appdb_watches;
+static size_t g_appdb_watches_count;
+static bool g_appdb_dirty;            /* .desktop file in one of the applications directories changed */
+static bool g_appdb_indexes_dirty;    /* other file, like mimeapps.list, changed */
+static bool g_appdb_incremental_dirty; /* incremental update of the completion index or of a sorted view failed */
+static appdb_stream_callback g_appdb_callback;
+static void * g_appdb_callback_ctx;
+
+/* initial load runs in a thread, into a separate list that is moved to g_appdb when complete */
+static pthread_t g_appdb_loader_thread;
+static bool g_appdb_loader_running;   /* thread is not joined yet */
+static pthread_mutex_t g_appdb_loader_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool g_appdb_loader_finished;  /* protected by the mutex */
+static bool g_appdb_loader_result;    /* protected by the mutex */
+static struct list_head g_appdb_loading;
+/* readers are not let in while the main loop waits to change the database, so reloads are not delayed by a stream of queries */
+static pthread_rwlock_t g_appdb_lock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+/* the visible cache and the $PATH listings are filled on demand, by readers */
+static pthread_mutex_t g_appdb_visible_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool g_appdb_ready;
+static unsigned int g_appdb_generation;
+static time_t g_appdb_scan_time;      /* start of the scan that g_appdb reflects, 0 if the scan failed */
+
+/* Merkle-style digest: hashes of entries are summed per applications directory, so directory */
+/* digests are updated in place on reload, and the overall digest is hash of directory digests */
+static char ** g_appdb_digest_dirs;
+static size_t g_appdb_digest_dirs_count;
+static uint64_t * g_appdb_dir_digests;  /* one more than dirs, for entries from other paths */
+
+static bool appdb_db_index_sessions(void)
+{
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  size_t count;
+
+  count = 0;
+  list_for_each(node_ptr, &g_appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+    if (entry_ptr->session_protocols != 0)
+    {
+      count++;
+    }
+  }
+
+  g_appdb_session_entries = malloc((count + 1) * sizeof(struct appdb_entry *));
+  if (g_appdb_session_entries == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  g_appdb_session_entries_count = 0;
+  list_for_each(node_ptr, &g_appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+    if (entry_ptr->session_protocols != 0)
+    {
+      g_appdb_session_entries[g_appdb_session_entries_count++] = entry_ptr;
+    }
+  }
+
+  log_info("%zu applications support session management", count);
+
+  return true;
+}
+
+static void appdb_db_free_indexes(void)
+{
+  appdb_hash_destroy(g_appdb_visible_cache);
+  g_appdb_visible_cache = NULL;
+  free(g_appdb_session_entries);
+  g_appdb_session_entries = NULL;
+  g_appdb_session_entries_count = 0;
+  appdb_category_index_destroy(g_appdb_category_index);
+  g_appdb_category_index = NULL;
+  appdb_fuzzy_destroy(g_appdb_fuzzy);
+  g_appdb_fuzzy = NULL;
+  appdb_mime_index_destroy(g_appdb_mime_index);
+  g_appdb_mime_index = NULL;
+}
+
+static bool appdb_db_build_indexes(void)
+{
+  g_appdb_mime_index = appdb_mime_index_new(&g_appdb);
+  if (g_appdb_mime_index == NULL)
+  {
+    log_error("Failed to build the MIME type index");
+    goto fail;
+  }
+
+  g_appdb_category_index = appdb_category_index_new(&g_appdb);
+  if (g_appdb_category_index == NULL)
+  {
+    log_error("Failed to build the category index");
+    goto fail;
+  }
+
+  g_appdb_fuzzy = appdb_fuzzy_new(&g_appdb);
+  if (g_appdb_fuzzy == NULL)
+  {
+    log_error("Failed to build the fuzzy matcher");
+    goto fail;
+  }
+
+  if (!appdb_db_index_sessions())
+  {
+    goto fail;
+  }
+
+  return true;
+
+fail:
+  appdb_db_free_indexes();
+  return false;
+}
+
+static bool appdb_db_build_name_index(void)
+{
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+
+  g_appdb_name_index = appdb_hash_new(NULL);
+  if (g_appdb_name_index == NULL)
+  {
+    return false;
+  }
+
+  list_for_each(node_ptr, &g_appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+    if (!appdb_hash_set(g_appdb_name_index, entry_ptr->name, entry_ptr))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* indexes that are updated on reload, instead of being built again */
+static void appdb_db_free_incremental(void)
+{
+  appdb_hash_destroy(g_appdb_name_index);
+  g_appdb_name_index = NULL;
+  appdb_complete_index_destroy(g_appdb_complete_index);
+  g_appdb_complete_index = NULL;
+  appdb_sorted_view_destroy(g_appdb_name_view);
+  g_appdb_name_view = NULL;
+  appdb_sorted_view_destroy(g_appdb_generic_name_view);
+  g_appdb_generic_name_view = NULL;
+}
+
+static bool appdb_db_build_incremental(void)
+{
+  if (!appdb_db_build_name_index())
+  {
+    log_error("Failed to build the name index");
+    goto fail;
+  }
+
+  g_appdb_complete_index = appdb_complete_index_new(&g_appdb);
+  if (g_appdb_complete_index == NULL)
+  {
+    log_error("Failed to build the completion index");
+    goto fail;
+  }
+
+  g_appdb_name_view = appdb_sorted_view_new(&g_appdb, APPDB_FIELD_NAME);
+  g_appdb_generic_name_view = appdb_sorted_view_new(&g_appdb, APPDB_FIELD_GENERIC_NAME);
+  if (g_appdb_name_view == NULL || g_appdb_generic_name_view == NULL)
+  {
+    log_error("Failed to build the sorted views");
+    goto fail;
+  }
+
+  return true;
+
+fail:
+  appdb_db_free_incremental();
+  return false;
+}
+
+static uint64_t appdb_db_entry_digest(struct appdb_entry * entry_ptr)
+{
+  return appdb_digest64(entry_ptr->desktop_id, strlen(entry_ptr->desktop_id), entry_ptr->content_hash);
+}
+
+static void appdb_db_digest_update(struct appdb_entry * entry_ptr, bool add)
+{
+  size_t len;
+  size_t i;
+
+  if (g_appdb_dir_digests == NULL)
+  {
+    return;
+  }
+
+  /* files can be in subdirectories of the applications directories */
+  for (i = 0; i < g_appdb_digest_dirs_count; i++)
+  {
+    len = strlen(g_appdb_digest_dirs[i]);
+    if (strncmp(entry_ptr->file_path, g_appdb_digest_dirs[i], len) == 0 && entry_ptr->file_path[len] == '/')
+    {
+      break;
+    }
+  }
+
+  if (add)
+  {
+    g_appdb_dir_digests[i] += appdb_db_entry_digest(entry_ptr);
+  }
+  else
+  {
+    g_appdb_dir_digests[i] -= appdb_db_entry_digest(entry_ptr);
+  }
+}
+
+static void appdb_db_digest_free(void)
+{
+  appdb_xdg_dirs_free(g_appdb_digest_dirs);
+  g_appdb_digest_dirs = NULL;
+  free(g_appdb_dir_digests);
+  g_appdb_dir_digests = NULL;
+  g_appdb_digest_dirs_count = 0;
+}
+
+static bool appdb_db_digest_init(void)
+{
+  struct list_head * node_ptr;
+
+  g_appdb_digest_dirs = appdb_xdg_data_dirs("/applications");
+  if (g_appdb_digest_dirs == NULL)
+  {
+    return false;
+  }
+
+  for (g_appdb_digest_dirs_count = 0; g_appdb_digest_dirs[g_appdb_digest_dirs_count] != NULL; g_appdb_digest_dirs_count++);
+
+  g_appdb_dir_digests = calloc(g_appdb_digest_dirs_count + 1, sizeof(uint64_t));
+  if (g_appdb_dir_digests == NULL)
+  {
+    log_error("calloc() failed");
+    appdb_db_digest_free();
+    return false;
+  }
+
+  list_for_each(node_ptr, &g_appdb)
+  {
+    appdb_db_digest_update(list_entry(node_ptr, struct appdb_entry, siblings), true);
+  }
+
+  return true;
+}
+
+static void appdb_db_watch_callback(void * UNUSED(ctx), const char * UNUSED(path), const char * name, uint32_t UNUSED(mask))
+{
+  size_t len;
+
+  /* name is NULL for events about the directory itself and on queue overflow */
+  if (name == NULL)
+  {
+    g_appdb_dirty = true;
+    return;
+  }
+
+  len = strlen(name);
+  if (len > 8 && strcmp(name + len - 8, ".desktop") == 0)
+  {
+    g_appdb_dirty = true;
+  }
+  else
+  {
+    /* mimeapps.list or mimeinfo.cache */
+    g_appdb_indexes_dirty = true;
+  }
+}
+
+static void appdb_db_watch(void)
+{
+  char ** dirs;
+  char ** dir_ptr;
+  int handle;
+  int * watches;
+
+  dirs = appdb_xdg_data_dirs("/applications");
+  if (dirs == NULL)
+  {
+    return;
+  }
+
+  for (dir_ptr = dirs; *dir_ptr != NULL; dir_ptr++)
+  {
+    handle = appdb_watcher_add(*dir_ptr, DB_WATCH_MASK, appdb_db_watch_callback, NULL);
+    if (handle == -1)
+    {
+      continue;
+    }
+
+    watches = realloc(g_appdb_watches, (g_appdb_watches_count + 1) * sizeof(int));
+    if (watches == NULL)
+    {
+      log_error("realloc() failed");
+      appdb_watcher_remove(handle);
+      break;
+    }
+
+    g_appdb_watches = watches;
+    g_appdb_watches[g_appdb_watches_count++] = handle;
+  }
+
+  appdb_xdg_dirs_free(dirs);
+}
+
+static size_t appdb_db_visible_memory(void * value)
+{
+  return malloc_usable_size(value);
+}
+
+bool appdb_db_memory_get(struct appdb_db_memory * memory_ptr)
+{
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  size_t count;
+  size_t size;
+  size_t len;
+  size_t i;
+
+  memset(memory_ptr, 0, sizeof(struct appdb_db_memory));
+
+  memory_ptr->dirs = appdb_xdg_data_dirs("/applications");
+  if (memory_ptr->dirs == NULL)
+  {
+    return false;
+  }
+
+  for (count = 0; memory_ptr->dirs[count] != NULL; count++);
+
+  memory_ptr->dirs_usage = calloc(count + 1, sizeof(size_t));
+  if (memory_ptr->dirs_usage == NULL)
+  {
+    log_error("calloc() failed");
+    appdb_xdg_dirs_free(memory_ptr->dirs);
+    return false;
+  }
+
+  list_for_each(node_ptr, &g_appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    size = appdb_entry_memory(entry_ptr, memory_ptr->fields);
+    memory_ptr->entries += size;
+    memory_ptr->entries_count++;
+
+    /* files can be in subdirectories of the applications directories */
+    for (i = 0; i < count; i++)
+    {
+      len = strlen(memory_ptr->dirs[i]);
+      if (strncmp(entry_ptr->file_path, memory_ptr->dirs[i], len) == 0 && entry_ptr->file_path[len] == '/')
+      {
+        memory_ptr->dirs_usage[i] += size;
+        break;
+      }
+    }
+  }
+
+  if (g_appdb_mime_index != NULL)
+  {
+    memory_ptr->mime_index = appdb_mime_index_memory(g_appdb_mime_index);
+  }
+
+  if (g_appdb_category_index != NULL)
+  {
+    memory_ptr->category_index = appdb_category_index_memory(g_appdb_category_index);
+  }
+
+  if (g_appdb_complete_index != NULL)
+  {
+    memory_ptr->complete_index = appdb_complete_index_memory(g_appdb_complete_index);
+    memory_ptr->sorted_views = appdb_sorted_view_memory(g_appdb_name_view) + appdb_sorted_view_memory(g_appdb_generic_name_view);
+    memory_ptr->name_index = appdb_hash_memory(g_appdb_name_index, NULL);
+  }
+
+  if (g_appdb_fuzzy != NULL)
+  {
+    memory_ptr->fuzzy_index = appdb_fuzzy_memory(g_appdb_fuzzy);
+  }
+
+  memory_ptr->session_index = malloc_usable_size(g_appdb_session_entries);
+
+  pthread_mutex_lock(&g_appdb_visible_mutex);
+
+  if (g_appdb_visible_cache != NULL)
+  {
+    memory_ptr->visible_cache = appdb_hash_memory(g_appdb_visible_cache, appdb_db_visible_memory);
+  }
+
+  memory_ptr->path_cache = appdb_path_memory();
+
+  pthread_mutex_unlock(&g_appdb_visible_mutex);
+
+  memory_ptr->query_cache = appdb_qcache_memory();
+  memory_ptr->parser_buffer_peak = appdb_parser_buffer_peak();
+
+  return true;
+}
+
+void appdb_db_memory_free(struct appdb_db_memory * memory_ptr)
+{
+  appdb_xdg_dirs_free(memory_ptr->dirs);
+  free(memory_ptr->dirs_usage);
+}
+
+/* log summary of memory usage and return memory that is no longer used to the OS */
+static void appdb_db_memory_update(void)
+{
+  struct appdb_db_memory memory;
+  unsigned int i;
+
+#if defined(HAVE_MALLOC_TRIM)
+  /* freed entries and parser buffers are scattered over the heap, and over the arena of */
+  /* the loader thread, so without this RSS only grows with each reload */
+  malloc_trim(0);
+#endif
+
+  if (!appdb_db_memory_get(&memory))
+  {
+    return;
+  }
+
+  log_info(
+    "Memory: %zu bytes in %zu entries, indexes %zu, caches %zu, largest parser buffer %zu",
+    memory.entries,
+    memory.entries_count,
+    memory.mime_index + memory.category_index + memory.complete_index + memory.fuzzy_index + memory.sorted_views + memory.session_index + memory.name_index,
+    memory.visible_cache + memory.path_cache + memory.query_cache,
+    memory.parser_buffer_peak);
+
+  for (i = 0; i < APPDB_MEMORY_COUNT; i++)
+  {
+    log_debug("  %s: %zu bytes", appdb_memory_category_name(i), memory.fields[i]);
+  }
+
+  for (i = 0; memory.dirs[i] != NULL; i++)
+  {
+    log_debug("  %s: %zu bytes", memory.dirs[i], memory.dirs_usage[i]);
+  }
+
+  appdb_db_memory_free(&memory);
+}
+
+/* build the indexes of loaded g_appdb and make it available; on failure g_appdb is freed */
+static bool appdb_db_load_finish(void)
+{
+  if (!appdb_db_build_indexes())
+  {
+    appdb_free(&g_appdb);
+    return false;
+  }
+
+  if (!appdb_db_build_incremental())
+  {
+    appdb_db_free_indexes();
+    appdb_free(&g_appdb);
+    return false;
+  }
+
+  if (!appdb_db_digest_init())
+  {
+    /* digest stays 0, clients just can't skip fetching */
+    log_error("Failed to compute the database digest");
+  }
+
+  g_appdb_ready = true;
+  g_appdb_generation++;
+
+  appdb_db_memory_update();
+
+  return true;
+}
+
+/* $XDG_CACHE_HOME/appdb/snapshot, to be freed by the caller; directories are created if create is true */
+static char * appdb_db_snapshot_path(bool create)
+{
+  const char * cache_home;
+  const char * home_dir;
+  char * cache_dir;
+  char * dir;
+  char * path;
+
+  cache_home = getenv("XDG_CACHE_HOME");
+  if (cache_home != NULL && *cache_home != 0)
+  {
+    cache_dir = strdup(cache_home);
+  }
+  else
+  {
+    home_dir = getenv("HOME");
+    if (home_dir == NULL)
+    {
+      log_error("HOME environment variable is not set.");
+      return NULL;
+    }
+
+    cache_dir = catdup(home_dir, "/.cache");
+  }
+
+  if (cache_dir == NULL)
+  {
+    log_error("Failed to compose the cache directory path");
+    return NULL;
+  }
+
+  path = NULL;
+
+  dir = catdup(cache_dir, SNAPSHOT_DIR);
+  if (dir == NULL)
+  {
+    log_error("catdup() failed to compose the snapshot directory path");
+    goto free_cache_dir;
+  }
+
+  if (create &&
+      ((mkdir(cache_dir, S_IRWXU) != 0 && errno != EEXIST) ||
+       (mkdir(dir, S_IRWXU) != 0 && errno != EEXIST)))
+  {
+    log_error("Failed to create '%s': %s", dir, strerror(errno));
+    goto free_dir;
+  }
+
+  path = catdup(dir, SNAPSHOT_FILE);
+  if (path == NULL)
+  {
+    log_error("catdup() failed to compose the snapshot path");
+  }
+
+free_dir:
+  free(dir);
+free_cache_dir:
+  free(cache_dir);
+  return path;
+}
+
+/* warm start, the entries are ready without a scan if the applications directories did not change */
+static bool appdb_db_load_snapshot(void)
+{
+  char * path;
+  bool ret;
+
+  path = appdb_db_snapshot_path(false);
+  if (path == NULL)
+  {
+    return false;
+  }
+
+  /* a file changed after its state is checked is going to have later change time */
+  g_appdb_scan_time = time(NULL);
+
+  ret = appdb_snapshot_load(&g_appdb, path) && appdb_db_load_finish();
+
+  free(path);
+
+  return ret;
+}
+
+bool appdb_db_save_snapshot(void)
+{
+  char * path;
+  bool ret;
+
+  if (!g_appdb_ready || g_appdb_scan_time == 0)
+  {
+    return false;
+  }
+
+  path = appdb_db_snapshot_path(true);
+  if (path == NULL)
+  {
+    return false;
+  }
+
+  ret = appdb_snapshot_save(&g_appdb, g_appdb_scan_time, path);
+
+  free(path);
+
+  return ret;
+}
+
+static void * appdb_db_loader_thread(void * UNUSED(arg))
+{
+  bool ret;
+
+  ret = appdb_load_stream(&g_appdb_loading, 0, g_appdb_callback, g_appdb_callback_ctx);
+
+  pthread_mutex_lock(&g_appdb_loader_mutex);
+  g_appdb_loader_result = ret;
+  g_appdb_loader_finished = true;
+  pthread_mutex_unlock(&g_appdb_loader_mutex);
+
+  return NULL;
+}
+
+bool appdb_db_load_start(appdb_stream_callback callback, void * ctx)
+{
+  int ret;
+
+  INIT_LIST_HEAD(&g_appdb);
+  INIT_LIST_HEAD(&g_appdb_loading);
+
+  g_appdb_callback = callback;
+  g_appdb_callback_ctx = ctx;
+  g_appdb_ready = false;
+  g_appdb_loader_finished = false;
+
+  /* watch before the snapshot is validated or the scan starts; changes meanwhile are not */
+  /* reflected in the loaded entries, they are picked up by appdb_db_reload_if_changed() */
+  /* once loading is finished */
+  appdb_db_watch();
+
+  if (appdb_db_load_snapshot())
+  {
+    return true;
+  }
+
+  g_appdb_scan_time = time(NULL);
+
+  ret = pthread_create(&g_appdb_loader_thread, NULL, appdb_db_loader_thread, NULL);
+  if (ret != 0)
+  {
+    log_error("Failed to start the loader thread: %s", strerror(ret));
+    return false;
+  }
+
+  g_appdb_loader_running = true;
+
+  return true;
+}
+
+bool appdb_db_load_poll(bool * finished_ptr)
+{
+  bool finished;
+  bool result;
+
+  *finished_ptr = false;
+
+  if (!g_appdb_loader_running)
+  {
+    return g_appdb_ready;
+  }
+
+  pthread_mutex_lock(&g_appdb_loader_mutex);
+  finished = g_appdb_loader_finished;
+  result = g_appdb_loader_result;
+  pthread_mutex_unlock(&g_appdb_loader_mutex);
+
+  if (!finished)
+  {
+    return true;
+  }
+
+  pthread_join(g_appdb_loader_thread, NULL);
+  g_appdb_loader_running = false;
+
+  if (!result)
+  {
+    return false;
+  }
+
+  list_splice_init(&g_appdb_loading, &g_appdb);
+
+  if (!appdb_db_load_finish())
+  {
+    return false;
+  }
+
+  *finished_ptr = true;
+
+  return true;
+}
+
+bool appdb_db_update_pending(void)
+{
+  bool finished;
+
+  if (g_appdb_loader_running)
+  {
+    pthread_mutex_lock(&g_appdb_loader_mutex);
+    finished = g_appdb_loader_finished;
+    pthread_mutex_unlock(&g_appdb_loader_mutex);
+
+    return finished;
+  }
+
+  return g_appdb_ready && (g_appdb_dirty || g_appdb_indexes_dirty || g_appdb_incremental_dirty);
+}
+
+bool appdb_db_is_ready(void)
+{
+  return g_appdb_ready;
+}
+
+void appdb_db_lock(void)
+{
+  pthread_rwlock_wrlock(&g_appdb_lock);
+}
+
+void appdb_db_lock_shared(void)
+{
+  pthread_rwlock_rdlock(&g_appdb_lock);
+}
+
+void appdb_db_unlock(void)
+{
+  pthread_rwlock_unlock(&g_appdb_lock);
+}
+
+unsigned int appdb_db_generation(void)
+{
+  return g_appdb_generation;
+}
+
+uint64_t appdb_db_digest(void)
+{
+  uint64_t digest;
+  size_t i;
+
+  if (g_appdb_dir_digests == NULL)
+  {
+    return 0;
+  }
+
+  /* empty directories don't change the digest, so it depends only on where the entries are */
+  digest = 0;
+  for (i = 0; i <= g_appdb_digest_dirs_count; i++)
+  {
+    if (g_appdb_dir_digests[i] != 0)
+    {
+      digest = appdb_digest64(&g_appdb_dir_digests[i], sizeof(uint64_t), digest);
+    }
+  }
+
+  return digest;
+}
+
+char * const * appdb_db_dir_digests(const uint64_t ** digests_ptr)
+{
+  static char * const empty = NULL;
+
+  if (g_appdb_dir_digests == NULL)
+  {
+    *digests_ptr = NULL;
+    return &empty;
+  }
+
+  *digests_ptr = g_appdb_dir_digests;
+  return g_appdb_digest_dirs;
+}
+
+static void appdb_db_reload_callback(void * ctx, unsigned int event, struct appdb_entry * entry_ptr)
+{
+  (*(size_t *)ctx)++;
+
+  appdb_db_digest_update(entry_ptr, event != APPDB_STREAM_RETRACT);
+
+  if (g_appdb_incremental_dirty || g_appdb_complete_index == NULL)
+  {
+    /* indexes are built again when reload is finished */
+    g_appdb_incremental_dirty = true;
+  }
+  else if (event == APPDB_STREAM_RETRACT)
+  {
+    appdb_complete_index_remove(g_appdb_complete_index, entry_ptr);
+    appdb_sorted_view_remove(g_appdb_name_view, entry_ptr);
+    appdb_sorted_view_remove(g_appdb_generic_name_view, entry_ptr);
+    /* removals are reported before additions, so this does not remove new version of a changed entry */
+    appdb_hash_remove(g_appdb_name_index, entry_ptr->name);
+  }
+  else if (!appdb_hash_set(g_appdb_name_index, entry_ptr->name, entry_ptr) ||
+           !appdb_complete_index_add(g_appdb_complete_index, entry_ptr) ||
+           !appdb_sorted_view_add(g_appdb_name_view, entry_ptr) ||
+           !appdb_sorted_view_add(g_appdb_generic_name_view, entry_ptr))
+  {
+    g_appdb_incremental_dirty = true;
+  }
+
+  if (g_appdb_callback != NULL)
+  {
+    g_appdb_callback(g_appdb_callback_ctx, event, entry_ptr);
+  }
+}
+
+void appdb_db_reload_if_changed(void)
+{
+  size_t changes;
+
+  if (!g_appdb_ready)
+  {
+    return;
+  }
+
+  changes = 0;
+
+  if (g_appdb_dirty)
+  {
+    g_appdb_dirty = false;
+
+    log_info("Applications directory changed, reloading");
+
+    g_appdb_scan_time = time(NULL);
+
+    /* on failure the list is empty, but still consistent; it is not saved in a snapshot then */
+    if (!appdb_reload(&g_appdb, 0, appdb_db_reload_callback, &changes))
+    {
+      g_appdb_scan_time = 0;
+    }
+
+    log_info("%zu changes", changes);
+  }
+
+  if (g_appdb_incremental_dirty)
+  {
+    appdb_db_free_incremental();
+    if (appdb_db_build_incremental())
+    {
+      g_appdb_incremental_dirty = false;
+    }
+  }
+
+  if (changes == 0 && !g_appdb_indexes_dirty)
+  {
+    return;
+  }
+
+  g_appdb_indexes_dirty = false;
+  g_appdb_generation++;
+
+  appdb_db_free_indexes();
+  if (!appdb_db_build_indexes())
+  {
+    /* will be tried again on next change */
+    log_error("Failed to rebuild the indexes");
+    g_appdb_indexes_dirty = true;
+  }
+
+  appdb_db_memory_update();
+}
+
+void appdb_db_free(void)
+{
+  size_t i;
+
+  if (g_appdb_loader_running)
+  {
+    log_info("Waiting for the loader thread");
+    pthread_join(g_appdb_loader_thread, NULL);
+    g_appdb_loader_running = false;
+
+    /* list is empty if loading failed */
+    appdb_free(&g_appdb_loading);
+  }
+
+  g_appdb_ready = false;
+
+  for (i = 0; i < g_appdb_watches_count; i++)
+  {
+    appdb_watcher_remove(g_appdb_watches[i]);
+  }
+
+  free(g_appdb_watches);
+  g_appdb_watches = NULL;
+  g_appdb_watches_count = 0;
+
+  appdb_db_free_indexes();
+  appdb_db_free_incremental();
+  appdb_db_digest_free();
+  appdb_free(&g_appdb);
+}
+
+struct appdb_entry * appdb_db_find(const char * name)
+{
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+
+  if (g_appdb_name_index != NULL)
+  {
+    return appdb_hash_get(g_appdb_name_index, name);
+  }
+
+  /* the index is missing only while loading, when g_appdb is empty, or when building it failed */
+  list_for_each(node_ptr, &g_appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    if (strcmp(entry_ptr->name, name) == 0)
+    {
+      return entry_ptr;
+    }
+  }
+
+  return NULL;
+}
+
+static bool appdb_db_desktops_match(char ** list, char ** desktops)
+{
+  char ** desktop_ptr;
+
+  for (desktop_ptr = desktops; *desktop_ptr != NULL; desktop_ptr++)
+  {
+    if (appdb_strlist_contains(list, *desktop_ptr))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool appdb_db_is_visible(struct appdb_entry * entry_ptr, char ** desktops)
+{
+  if (entry_ptr->hidden || entry_ptr->no_display)
+  {
+    return false;
+  }
+
+  if (entry_ptr->only_show_in != NULL && !appdb_db_desktops_match(entry_ptr->only_show_in, desktops))
+  {
+    return false;
+  }
+
+  if (entry_ptr->not_show_in != NULL && appdb_db_desktops_match(entry_ptr->not_show_in, desktops))
+  {
+    return false;
+  }
+
+  if (entry_ptr->try_exec != NULL && !appdb_path_exists(entry_ptr->try_exec))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+static struct appdb_db_visible * appdb_db_visible_get(const char * desktops)
+{
+  struct appdb_db_visible * visible_ptr;
+  char ** list;
+  char * desktops_list;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  struct appdb_entry * const * sorted;
+  size_t count;
+
+  if (g_appdb_visible_cache == NULL)
+  {
+    g_appdb_visible_cache = appdb_hash_new(free);
+    if (g_appdb_visible_cache == NULL)
+    {
+      return NULL;
+    }
+  }
+
+  visible_ptr = appdb_hash_get(g_appdb_visible_cache, desktops);
+  if (visible_ptr != NULL && visible_ptr->path_generation == appdb_path_generation())
+  {
+    return visible_ptr;
+  }
+
+  /* XDG_CURRENT_DESKTOP format, colon separated */
+  desktops_list = strdup(desktops);
+  if (desktops_list == NULL)
+  {
+    log_error("strdup() failed");
+    return NULL;
+  }
+
+  for (count = 0; desktops_list[count] != 0; count++)
+  {
+    if (desktops_list[count] == ':')
+    {
+      desktops_list[count] = ';';
+    }
+  }
+
+  list = appdb_strlist_split(desktops_list);
+  free(desktops_list);
+  if (list == NULL)
+  {
+    return NULL;
+  }
+
+  /* in order of the name view; in order of loading if the view could not be built */
+  sorted = NULL;
+  if (g_appdb_name_view != NULL)
+  {
+    sorted = appdb_sorted_view_get(g_appdb_name_view, &count);
+  }
+  else
+  {
+    count = 0;
+    list_for_each(node_ptr, &g_appdb)
+    {
+      count++;
+    }
+  }
+
+  visible_ptr = malloc(sizeof(struct appdb_db_visible) + count * sizeof(struct appdb_entry *));
+  if (visible_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    free(list);
+    return NULL;
+  }
+
+  visible_ptr->count = 0;
+  if (sorted != NULL)
+  {
+    for (; *sorted != NULL; sorted++)
+    {
+      if (appdb_db_is_visible(*sorted, list))
+      {
+        visible_ptr->entries[visible_ptr->count++] = *sorted;
+      }
+    }
+  }
+  else
+  {
+    list_for_each(node_ptr, &g_appdb)
+    {
+      entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+      if (appdb_db_is_visible(entry_ptr, list))
+      {
+        visible_ptr->entries[visible_ptr->count++] = entry_ptr;
+      }
+    }
+  }
+
+  free(list);
+
+  /* TryExec checks may have read $PATH directories, generation is taken after them */
+  visible_ptr->path_generation = appdb_path_generation();
+
+  if (appdb_hash_count(g_appdb_visible_cache) >= VISIBLE_CACHE_LIMIT)
+  {
+    appdb_hash_clear(g_appdb_visible_cache);
+  }
+
+  if (!appdb_hash_set(g_appdb_visible_cache, desktops, visible_ptr))
+  {
+    free(visible_ptr);
+    return NULL;
+  }
+
+  log_debug("%zu of %zu applications are visible in '%s'", visible_ptr->count, count, desktops);
+
+  return visible_ptr;
+}
+
+struct appdb_entry ** appdb_db_visible(const char * desktops, size_t * count_ptr)
+{
+  struct appdb_db_visible * visible_ptr;
+  struct appdb_entry ** entries;
+
+  /* the cached result can be replaced by another reader as soon as the mutex is released, so it is copied */
+  pthread_mutex_lock(&g_appdb_visible_mutex);
+
+  entries = NULL;
+  visible_ptr = appdb_db_visible_get(desktops);
+  if (visible_ptr != NULL)
+  {
+    entries = malloc((visible_ptr->count + 1) * sizeof(struct appdb_entry *));
+    if (entries == NULL)
+    {
+      log_error("malloc() failed");
+    }
+    else
+    {
+      memcpy(entries, visible_ptr->entries, visible_ptr->count * sizeof(struct appdb_entry *));
+      entries[visible_ptr->count] = NULL;
+      *count_ptr = visible_ptr->count;
+    }
+  }
+
+  pthread_mutex_unlock(&g_appdb_visible_mutex);
+
+  return entries;
+}
@@ -0,0 +1,122 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *******************************************************
+ * This file contains interface to the daemon database *
+ *******************************************************/
+
+#ifndef DB_H__A7C3D2E1_4B8F_4F6A_9D0E_3C5B7A1F2E84__INCLUDED
+#define DB_H__A7C3D2E1_4B8F_4F6A_9D0E_3C5B7A1F2E84__INCLUDED
+
+#include "common.h"
+
+/* list of struct appdb_entry, as loaded by appdb_load() */
+extern struct list_head g_appdb;
+
+/* index of g_appdb entries by MIME type */
+extern struct appdb_mime_index * g_appdb_mime_index;
+
+/* index of g_appdb entries by category */
+extern struct appdb_category_index * g_appdb_category_index;
+
+/* index of g_appdb entries for completion of names, updated on reload instead of being rebuilt */
+extern struct appdb_complete_index * g_appdb_complete_index;
+
+/* g_appdb entries ordered by name and by generic name, according to the locale, updated on reload */
+extern struct appdb_sorted_view * g_appdb_name_view;
+extern struct appdb_sorted_view * g_appdb_generic_name_view;
+
+/* fuzzy matcher of g_appdb entry names */
+extern struct appdb_fuzzy * g_appdb_fuzzy;
+
+/* g_appdb entries that support session management, in g_appdb order */
+extern struct appdb_entry ** g_appdb_session_entries;
+extern size_t g_appdb_session_entries_count;
+
+/* start loading of the database in a background thread */
+/* callback, if not NULL, is called for each entry while loading (in the loader thread), */
+/* and for each changed entry when the applications directories change (in the main thread) */
+/* until loading is finished, g_appdb is empty and the indexes are NULL; the applications directories */
+/* are watched from the start, also while the snapshot is validated, so changes during loading cause */
+/* a reload when it is finished */
+/* if the snapshot saved by appdb_db_save_snapshot() is still valid, the database is loaded from it */
+/* instead, the callback is not called then and the database is ready when this function returns */
+bool appdb_db_load_start(appdb_stream_callback callback, void * ctx);
+
+/* check whether the loader thread finished, and if so, make the loaded entries available */
+/* *finished_ptr is set to true when this happened in this call; returns false if loading failed */
+bool appdb_db_load_poll(bool * finished_ptr);
+
+/* whether the loader thread finished, or the watcher reported changes that are not applied yet; */
+/* if not, appdb_db_load_poll() and appdb_db_reload_if_changed() have nothing to do */
+bool appdb_db_update_pending(void);
+
+bool appdb_db_is_ready(void);
+
+/* The main loop holds the lock exclusively while it changes the database. Readers, the main loop
+ * while it dispatches method calls and the worker and fast path threads, hold it shared, so the
+ * database does not change while a query runs. */
+void appdb_db_lock(void);
+void appdb_db_lock_shared(void);
+void appdb_db_unlock(void);
+
+/* incremented when loading is finished and when a reload changes the entries or the indexes */
+/* results that reference entries are valid only until the generation changes */
+unsigned int appdb_db_generation(void);
+
+/* Merkle-style digest of names and contents of the .desktop files of the entries, 0 while loading */
+/* paths of the directories are not part of it, so digests of different machines can be compared */
+uint64_t appdb_db_digest(void);
+
+/* applications directories, NULL terminated, and digest of entries in each of them; */
+/* these are in *digests_ptr, which is NULL while loading */
+char * const * appdb_db_dir_digests(const uint64_t ** digests_ptr);
+
+/* reload the database if changes in the applications directories were reported by the watcher */
+/* files with same contents as before are not parsed again and are not reported to the callback */
+void appdb_db_reload_if_changed(void);
+void appdb_db_free(void);
+
+/* save the database to $XDG_CACHE_HOME/appdb/snapshot, for warm start of next instance of the daemon */
+/* nothing is saved if the applications directories changed since they were scanned */
+bool appdb_db_save_snapshot(void);
+
+/* entries that should be shown in desktop environments listed in desktops, in XDG_CURRENT_DESKTOP format, ordered by name */
+/* Hidden, NoDisplay, OnlyShowIn, NotShowIn and TryExec keys are evaluated */
+/* returned array is NULL terminated and is to be freed by the caller; NULL on failure */
+/* it can be called by more readers at once, the cache of results is protected by its own mutex */
+struct appdb_entry ** appdb_db_visible(const char * desktops, size_t * count_ptr);
+
+/* memory used by the database, in bytes of heap blocks, see appdb_entry_memory() */
+struct appdb_db_memory
+{
+  size_t entries_count;
+  size_t entries;                       /* sum of fields */
+  size_t fields[APPDB_MEMORY_COUNT];    /* indexed by APPDB_FIELD_xxx and APPDB_MEMORY_xxx */
+  char ** dirs;                         /* applications directories, in order of precedence */
+  size_t * dirs_usage;                  /* memory used by entries loaded from each of the dirs */
+  size_t mime_index;
+  size_t category_index;
+  size_t complete_index;
+  size_t fuzzy_index;
+  size_t sorted_views;
+  size_t session_index;
+  size_t name_index;
+  size_t visible_cache;
+  size_t path_cache;
+  size_t query_cache;
+  size_t parser_buffer_peak;            /* largest .desktop file buffer, these are freed after parsing */
+};
+
+/* to be freed with appdb_db_memory_free() if successful */
+bool appdb_db_memory_get(struct appdb_db_memory * memory_ptr);
+void appdb_db_memory_free(struct appdb_db_memory * memory_ptr);
+
+/* find entry by name, NULL if not found */
+struct appdb_entry * appdb_db_find(const char * name);
+
+#endif /* #ifndef DB_H__A7C3D2E1_4B8F_4F6A_9D0E_3C5B7A1F2E84__INCLUDED */
@@ -0,0 +1,129 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *********************************************************************
+ * This file contains implementation of the content digest functions *
+ *********************************************************************/
+
+#include <string.h>
+#include <endian.h>
+
+#include "digest.h"
+
+/* XXH64, as described in https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md */
+
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t appdb_digest_read64(const unsigned char * ptr)
+{
+  uint64_t value;
+
+  memcpy(&value, ptr, sizeof(value));
+  return le64toh(value);
+}
+
+static inline uint32_t appdb_digest_read32(const unsigned char * ptr)
+{
+  uint32_t value;
+
+  memcpy(&value, ptr, sizeof(value));
+  return le32toh(value);
+}
+
+static inline uint64_t appdb_digest_round(uint64_t acc, uint64_t input)
+{
+  acc += input * PRIME64_2;
+  acc = ROTL64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static inline uint64_t appdb_digest_merge(uint64_t acc, uint64_t value)
+{
+  acc ^= appdb_digest_round(0, value);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t
+appdb_digest64(
+  const void * data,
+  size_t size,
+  uint64_t seed)
+{
+  const unsigned char * ptr;
+  const unsigned char * end;
+  uint64_t v1;
+  uint64_t v2;
+  uint64_t v3;
+  uint64_t v4;
+  uint64_t h;
+
+  ptr = data;
+  end = ptr + size;
+
+  if (size >= 32)
+  {
+    v1 = seed + PRIME64_1 + PRIME64_2;
+    v2 = seed + PRIME64_2;
+    v3 = seed;
+    v4 = seed - PRIME64_1;
+
+    do
+    {
+      v1 = appdb_digest_round(v1, appdb_digest_read64(ptr));
+      v2 = appdb_digest_round(v2, appdb_digest_read64(ptr + 8));
+      v3 = appdb_digest_round(v3, appdb_digest_read64(ptr + 16));
+      v4 = appdb_digest_round(v4, appdb_digest_read64(ptr + 24));
+      ptr += 32;
+    }
+    while (ptr + 32 <= end);
+
+    h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+    h = appdb_digest_merge(h, v1);
+    h = appdb_digest_merge(h, v2);
+    h = appdb_digest_merge(h, v3);
+    h = appdb_digest_merge(h, v4);
+  }
+  else
+  {
+    h = seed + PRIME64_5;
+  }
+
+  h += size;
+
+  for (; ptr + 8 <= end; ptr += 8)
+  {
+    h ^= appdb_digest_round(0, appdb_digest_read64(ptr));
+    h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+
+  if (ptr + 4 <= end)
+  {
+    h ^= (uint64_t)appdb_digest_read32(ptr) * PRIME64_1;
+    h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+    ptr += 4;
+  }
+
+  for (; ptr < end; ptr++)
+  {
+    h ^= *ptr * PRIME64_5;
+    h = ROTL64(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
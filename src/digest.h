@@ -0,0 +1,25 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ****************************************************************
+ * This file contains interface to the content digest functions *
+ ****************************************************************/
+
+#ifndef DIGEST_H__E0C47A19_3B5D_4F82_9A6E_71D2B8C5F034__INCLUDED
+#define DIGEST_H__E0C47A19_3B5D_4F82_9A6E_71D2B8C5F034__INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* 64-bit non-cryptographic hash of data, XXH64 algorithm */
+uint64_t
+appdb_digest64(
+  const void * data,
+  size_t size,
+  uint64_t seed);
+
+#endif /* #ifndef DIGEST_H__E0C47A19_3B5D_4F82_9A6E_71D2B8C5F034__INCLUDED */
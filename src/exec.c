@@ -0,0 +1,634 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *******************************************************************
+ * This file contains code for the Exec key of the desktop entries *
+ *******************************************************************/
+
+#define _GNU_SOURCE              /* posix_spawn_file_actions_addchdir_np() */
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <spawn.h>
+
+#include "common.h"
+#include "exec.h"
+
+extern char ** environ;
+
+#define APPDB_DEFAULT_TERMINAL "xterm"
+
+/* Exec is a string value, so the general escape rules (\s, \n, \t, \r, \\) apply before the quoting rules */
+static
+void
+appdb_exec_unescape(
+  const char * src,
+  char * dst)
+{
+  while (*src != 0)
+  {
+    if (*src == '\\')
+    {
+      switch (src[1])
+      {
+      case 's':
+        *dst++ = ' ';
+        src += 2;
+        continue;
+      case 'n':
+        *dst++ = '\n';
+        src += 2;
+        continue;
+      case 't':
+        *dst++ = '\t';
+        src += 2;
+        continue;
+      case 'r':
+        *dst++ = '\r';
+        src += 2;
+        continue;
+      case '\\':
+        *dst++ = '\\';
+        src += 2;
+        continue;
+      }
+    }
+
+    *dst++ = *src++;
+  }
+
+  *dst = 0;
+}
+
+char **
+appdb_exec_tokenize(
+  const char * exec)
+{
+  size_t len;
+  char * buffer;
+  char * src;
+  char * dst;
+  size_t argc;
+  bool quoted;
+  char ** argv;
+  char * strings;
+  size_t i;
+
+  len = strlen(exec);
+
+  /* unescaped data first, tokenized data after it, tokenizing never makes string longer */
+  buffer = malloc(2 * (len + 1));
+  if (buffer == NULL)
+  {
+    log_error("malloc() failed");
+    return NULL;
+  }
+
+  appdb_exec_unescape(exec, buffer);
+
+  src = buffer;
+  dst = buffer + len + 1;
+  argc = 0;
+  quoted = false;
+
+  for (;;)
+  {
+    while (*src == ' ' || *src == '\t' || *src == '\n')
+    {
+      src++;
+    }
+
+    if (*src == 0)
+    {
+      break;
+    }
+
+    while (*src != 0 && (quoted || (*src != ' ' && *src != '\t' && *src != '\n')))
+    {
+      if (*src == '"')
+      {
+        quoted = !quoted;
+        src++;
+        continue;
+      }
+
+      /* inside quotes, backslash escapes the double quote, backtick, dollar sign and backslash */
+      if (quoted && *src == '\\' && src[1] != 0 && strchr("\"`$\\", src[1]) != NULL)
+      {
+        src++;
+      }
+
+      *dst++ = *src++;
+    }
+
+    if (quoted)
+    {
+      log_error("Unterminated quoted argument in Exec '%s'", exec);
+      free(buffer);
+      return NULL;
+    }
+
+    *dst++ = 0;
+    argc++;
+  }
+
+  if (argc == 0)
+  {
+    log_error("Empty Exec value");
+    free(buffer);
+    return NULL;
+  }
+
+  /* pointers and strings in one block, so the template is freed with a single free() */
+  len = dst - (buffer + len + 1);
+  argv = malloc((argc + 1) * sizeof(char *) + len);
+  if (argv == NULL)
+  {
+    log_error("malloc() failed");
+    free(buffer);
+    return NULL;
+  }
+
+  strings = (char *)(argv + argc + 1);
+  memcpy(strings, dst - len, len);
+
+  for (i = 0; i < argc; i++)
+  {
+    argv[i] = strings;
+    strings += strlen(strings) + 1;
+  }
+
+  argv[argc] = NULL;
+
+  free(buffer);
+
+  log_debug("Exec '%s' tokenized to %zu arguments", exec, argc);
+
+  return argv;
+}
+
+struct appdb_argv
+{
+  char ** argv;
+  size_t count;
+  size_t size;
+};
+
+static
+bool
+appdb_argv_append(
+  struct appdb_argv * argv_ptr,
+  char * arg)
+{
+  char ** new_argv;
+
+  if (arg == NULL)
+  {
+    log_error("Out of memory");
+    return false;
+  }
+
+  if (argv_ptr->count + 1 >= argv_ptr->size)
+  {
+    new_argv = realloc(argv_ptr->argv, (argv_ptr->size + 8) * sizeof(char *));
+    if (new_argv == NULL)
+    {
+      log_error("realloc() failed");
+      free(arg);
+      return false;
+    }
+
+    argv_ptr->argv = new_argv;
+    argv_ptr->size += 8;
+  }
+
+  argv_ptr->argv[argv_ptr->count++] = arg;
+  argv_ptr->argv[argv_ptr->count] = NULL;
+
+  return true;
+}
+
+static
+int
+appdb_hex_value(
+  char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+
+  return -1;
+}
+
+/* %f and %F take local paths, file:// URIs are converted, anything else is passed as is */
+static
+char *
+appdb_uri_to_file(
+  const char * uri)
+{
+  char * path;
+  char * dst;
+  int hi;
+  int lo;
+
+  if (strncmp(uri, "file://", 7) != 0)
+  {
+    return strdup(uri);
+  }
+
+  /* skip the host part */
+  uri = strchr(uri + 7, '/');
+  if (uri == NULL)
+  {
+    return strdup("/");
+  }
+
+  path = malloc(strlen(uri) + 1);
+  if (path == NULL)
+  {
+    return NULL;
+  }
+
+  for (dst = path; *uri != 0; uri++)
+  {
+    if (*uri == '%' && (hi = appdb_hex_value(uri[1])) != -1 && (lo = appdb_hex_value(uri[2])) != -1)
+    {
+      *dst++ = (char)(hi * 16 + lo);
+      uri += 2;
+      continue;
+    }
+
+    *dst++ = *uri;
+  }
+
+  *dst = 0;
+
+  return path;
+}
+
+static
+bool
+appdb_string_append(
+  char ** string_ptr,
+  size_t * len_ptr,
+  const char * suffix,
+  size_t suffix_len)
+{
+  char * string;
+
+  string = realloc(*string_ptr, *len_ptr + suffix_len + 1);
+  if (string == NULL)
+  {
+    log_error("realloc() failed");
+    return false;
+  }
+
+  memcpy(string + *len_ptr, suffix, suffix_len);
+  *len_ptr += suffix_len;
+  string[*len_ptr] = 0;
+
+  *string_ptr = string;
+
+  return true;
+}
+
+/* expand field codes embedded in a single argument, returns false on failure */
+/* *arg_ptr is set to NULL if argument consists of field codes only and they expanded to nothing */
+static
+bool
+appdb_exec_expand_arg(
+  struct appdb_entry * entry_ptr,
+  const char * template,
+  const char * uri,
+  char ** arg_ptr)
+{
+  char * arg;
+  size_t len;
+  const char * value;
+  char * file;
+  bool literal;
+  bool ok;
+
+  arg = NULL;
+  len = 0;
+  literal = false;
+
+  if (!appdb_string_append(&arg, &len, "", 0))
+  {
+    return false;
+  }
+
+  while (*template != 0)
+  {
+    if (*template != '%' || template[1] == 0)
+    {
+      value = strchr(template + 1, '%');
+      if (value == NULL)
+      {
+        value = template + strlen(template);
+      }
+
+      if (!appdb_string_append(&arg, &len, template, value - template))
+      {
+        goto fail;
+      }
+
+      literal = true;
+      template = value;
+      continue;
+    }
+
+    ok = true;
+    switch (template[1])
+    {
+    case '%':
+      ok = appdb_string_append(&arg, &len, "%", 1);
+      literal = true;
+      break;
+    case 'f':
+      if (uri != NULL)
+      {
+        file = appdb_uri_to_file(uri);
+        ok = file != NULL && appdb_string_append(&arg, &len, file, strlen(file));
+        free(file);
+      }
+      break;
+    case 'u':
+      if (uri != NULL)
+      {
+        ok = appdb_string_append(&arg, &len, uri, strlen(uri));
+      }
+      break;
+    case 'c':
+      ok = appdb_string_append(&arg, &len, entry_ptr->name, strlen(entry_ptr->name));
+      break;
+    case 'k':
+      ok = appdb_string_append(&arg, &len, entry_ptr->file_path, strlen(entry_ptr->file_path));
+      break;
+    default:
+      /* deprecated (%d, %D, %n, %N, %v, %m), misplaced (%F, %U, %i) or unknown */
+      log_debug("Ignoring field code '%%%c' in Exec of '%s'", template[1], entry_ptr->name);
+    }
+
+    if (!ok)
+    {
+      goto fail;
+    }
+
+    template += 2;
+  }
+
+  if (len == 0 && !literal)
+  {
+    free(arg);
+    arg = NULL;
+  }
+
+  *arg_ptr = arg;
+  return true;
+
+fail:
+  free(arg);
+  return false;
+}
+
+static
+bool
+appdb_exec_takes_uri_list(
+  char ** exec_argv)
+{
+  for (; *exec_argv != NULL; exec_argv++)
+  {
+    if (strcmp(*exec_argv, "%F") == 0 || strcmp(*exec_argv, "%U") == 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+char **
+appdb_entry_expand_exec(
+  struct appdb_entry * entry_ptr,
+  const char * const * uris,
+  size_t uris_count)
+{
+  struct appdb_argv argv;
+  char ** template_ptr;
+  const char * terminal;
+  char * arg;
+  size_t i;
+
+  if (appdb_entry_get(entry_ptr, APPDB_FIELD_EXEC) == NULL || entry_ptr->exec_argv == NULL)
+  {
+    log_error("'%s' has no valid Exec", entry_ptr->name);
+    return NULL;
+  }
+
+  argv.argv = NULL;
+  argv.count = 0;
+  argv.size = 0;
+
+  if (entry_ptr->terminal)
+  {
+    terminal = getenv("TERMINAL");
+    if (terminal == NULL || *terminal == 0)
+    {
+      terminal = APPDB_DEFAULT_TERMINAL;
+    }
+
+    if (!appdb_argv_append(&argv, strdup(terminal)) ||
+        !appdb_argv_append(&argv, strdup("-e")))
+    {
+      goto fail;
+    }
+  }
+
+  for (template_ptr = entry_ptr->exec_argv; *template_ptr != NULL; template_ptr++)
+  {
+    if (strcmp(*template_ptr, "%F") == 0 || strcmp(*template_ptr, "%U") == 0)
+    {
+      for (i = 0; i < uris_count; i++)
+      {
+        if (!appdb_argv_append(&argv, (*template_ptr)[1] == 'F' ? appdb_uri_to_file(uris[i]) : strdup(uris[i])))
+        {
+          goto fail;
+        }
+      }
+
+      continue;
+    }
+
+    if (strcmp(*template_ptr, "%i") == 0)
+    {
+      if (entry_ptr->icon != NULL &&
+          (!appdb_argv_append(&argv, strdup("--icon")) ||
+           !appdb_argv_append(&argv, strdup(entry_ptr->icon))))
+      {
+        goto fail;
+      }
+
+      continue;
+    }
+
+    if (!appdb_exec_expand_arg(entry_ptr, *template_ptr, uris_count > 0 ? uris[0] : NULL, &arg))
+    {
+      goto fail;
+    }
+
+    if (arg != NULL && !appdb_argv_append(&argv, arg))
+    {
+      goto fail;
+    }
+  }
+
+  return argv.argv;
+
+fail:
+  appdb_argv_free(argv.argv);
+  return NULL;
+}
+
+void
+appdb_argv_free(
+  char ** argv)
+{
+  char ** arg_ptr;
+
+  if (argv == NULL)
+  {
+    return;
+  }
+
+  for (arg_ptr = argv; *arg_ptr != NULL; arg_ptr++)
+  {
+    free(*arg_ptr);
+  }
+
+  free(argv);
+}
+
+static
+bool
+appdb_spawn(
+  char ** argv,
+  const char * cwd,
+  pid_t * pid_ptr)
+{
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  sigset_t signals;
+  int ret;
+
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
+
+  if (cwd != NULL)
+  {
+#if defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP)
+    posix_spawn_file_actions_addchdir_np(&actions, cwd);
+#else
+    log_warn("Cannot change working directory of '%s' to '%s', posix_spawn_file_actions_addchdir_np() is not available", argv[0], cwd);
+#endif
+  }
+
+  /* the child must not inherit signal dispositions and mask of the daemon */
+  sigemptyset(&signals);
+  posix_spawnattr_setsigmask(&attr, &signals);
+  sigaddset(&signals, SIGPIPE);
+  sigaddset(&signals, SIGCHLD);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGHUP);
+  sigaddset(&signals, SIGTERM);
+  posix_spawnattr_setsigdefault(&attr, &signals);
+
+  /* own process group, so signals sent to our group do not reach it */
+  posix_spawnattr_setpgroup(&attr, 0);
+
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+  ret = posix_spawnp(pid_ptr, argv[0], &actions, &attr, argv, environ);
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (ret != 0)
+  {
+    log_error("posix_spawnp('%s') failed: %s", argv[0], strerror(ret));
+    return false;
+  }
+
+  log_info("Started '%s' with pid %llu", argv[0], (unsigned long long)*pid_ptr);
+
+  return true;
+}
+
+bool
+appdb_entry_launch(
+  struct appdb_entry * entry_ptr,
+  const char * const * uris,
+  size_t uris_count,
+  pid_t * pids,
+  size_t * pids_count_ptr)
+{
+  char ** argv;
+  size_t i;
+  size_t launches;
+  bool ret;
+
+  *pids_count_ptr = 0;
+
+  if (appdb_entry_get(entry_ptr, APPDB_FIELD_EXEC) == NULL || entry_ptr->exec_argv == NULL)
+  {
+    log_error("'%s' has no valid Exec", entry_ptr->name);
+    return false;
+  }
+
+  /* applications that take single file or URI are started once per URI */
+  launches = 1;
+  if (uris_count > 1 && !appdb_exec_takes_uri_list(entry_ptr->exec_argv))
+  {
+    launches = uris_count;
+  }
+
+  for (i = 0; i < launches; i++)
+  {
+    argv = appdb_entry_expand_exec(
+      entry_ptr,
+      launches == 1 ? uris : uris + i,
+      launches == 1 ? uris_count : 1);
+    if (argv == NULL)
+    {
+      return false;
+    }
+
+    ret = appdb_spawn(argv, appdb_entry_get(entry_ptr, APPDB_FIELD_PATH), pids + *pids_count_ptr);
+    appdb_argv_free(argv);
+    if (!ret)
+    {
+      return false;
+    }
+
+    (*pids_count_ptr)++;
+  }
+
+  return true;
+}
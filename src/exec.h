@@ -0,0 +1,22 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ************************************************************************
+ * This file contains interface to the Exec key tokenizer of the loader *
+ ************************************************************************/
+
+#ifndef EXEC_H__5B0E1F44_7D1A_4C37_8E51_2A9C6F0D3B17__INCLUDED
+#define EXEC_H__5B0E1F44_7D1A_4C37_8E51_2A9C6F0D3B17__INCLUDED
+
+/* split Exec value to arguments according to the quoting rules of the Desktop Entry Specification */
+/* field codes are left as they are, to be expanded by appdb_entry_expand_exec() */
+/* returns NULL terminated array, pointers and strings are in one block to be freed with free() */
+char **
+appdb_exec_tokenize(
+  const char * exec);
+
+#endif /* #ifndef EXEC_H__5B0E1F44_7D1A_4C37_8E51_2A9C6F0D3B17__INCLUDED */
@@ -0,0 +1,548 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *************************************************************
+ * This file contains implementation of the fast path server *
+ *************************************************************/
+
+#define _GNU_SOURCE              /* accept4(), pipe2() */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "appdb/fastpath.h"
+#include "fastpath.h"
+#include "catdup.h"
+#include "db.h"
+#include "fuzzy.h"
+
+#define FASTPATH_SOCKET_NAME "/appdb-fastpath"
+#define FASTPATH_MAX_CLIENTS 32
+#define FASTPATH_MAX_MATCHES 1024
+#define FASTPATH_BURST 64       /* pipelined requests of a client that are handled before others get a turn */
+
+static char * g_fastpath_path;
+static int g_fastpath_listen_fd = -1;
+static int g_fastpath_wakeup[2] = {-1, -1};
+static pthread_t g_fastpath_thread;
+static ino_t g_fastpath_ino;         /* of the socket, the path can be taken over by next instance of the daemon */
+static unsigned int g_fastpath_clients;  /* written by the thread */
+
+/* used only by the thread; one byte more, so strings at the end of a payload can be zero terminated in place */
+static char g_fastpath_request[APPDB_FASTPATH_MAX_PACKET + 1];
+static char g_fastpath_response[APPDB_FASTPATH_MAX_PACKET];
+static size_t g_fastpath_response_length;
+
+static bool appdb_fastpath_put(const void * data, size_t size)
+{
+  if (size > sizeof(g_fastpath_response) - g_fastpath_response_length)
+  {
+    return false;
+  }
+
+  memcpy(g_fastpath_response + g_fastpath_response_length, data, size);
+  g_fastpath_response_length += size;
+
+  return true;
+}
+
+static bool appdb_fastpath_put_string(const char * string)
+{
+  size_t length;
+  uint16_t length16;
+
+  /* values longer than that are not used in practice, they are truncated */
+  length = strlen(string);
+  length16 = length > UINT16_MAX ? UINT16_MAX : length;
+
+  return
+    sizeof(length16) + length16 <= sizeof(g_fastpath_response) - g_fastpath_response_length &&
+    appdb_fastpath_put(&length16, sizeof(length16)) &&
+    appdb_fastpath_put(string, length16);
+}
+
+static bool appdb_fastpath_put_fields(struct appdb_entry * entry_ptr, uint32_t fields)
+{
+  const char * value;
+  unsigned int field;
+
+  for (field = 0; field < APPDB_FIELD_COUNT; field++)
+  {
+    if ((fields & (1 << field)) == 0)
+    {
+      continue;
+    }
+
+    value = appdb_entry_get(entry_ptr, field);
+    if (!appdb_fastpath_put_string(value != NULL ? value : ""))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* payload is zero terminated */
+static uint16_t appdb_fastpath_lookup_request(const char * payload, size_t UNUSED(length), uint16_t * count_ptr)
+{
+  struct appdb_entry * entry_ptr;
+
+  /* hash lookup, see appdb_db_find() */
+  entry_ptr = appdb_db_find(payload);
+
+  if (entry_ptr == NULL)
+  {
+    return APPDB_FASTPATH_NOT_FOUND;
+  }
+
+  if (!appdb_fastpath_put_fields(entry_ptr, (1 << APPDB_FIELD_COUNT) - 1))
+  {
+    return APPDB_FASTPATH_FAILED;
+  }
+
+  *count_ptr = APPDB_FIELD_COUNT;
+
+  return APPDB_FASTPATH_OK;
+}
+
+static uint16_t appdb_fastpath_search_request(const char * payload, size_t length, uint16_t * count_ptr)
+{
+  const char * end;
+  uint32_t k;
+  struct appdb_fuzzy_match * matches;
+  size_t count;
+  size_t i;
+  uint32_t score;
+  size_t response_length;
+
+  end = payload + length;
+  if (!appdb_fastpath_read_uint32(&payload, end, &k))
+  {
+    return APPDB_FASTPATH_INVALID;
+  }
+
+  if (g_appdb_fuzzy == NULL)
+  {
+    return APPDB_FASTPATH_FAILED;
+  }
+
+  if (k > FASTPATH_MAX_MATCHES)
+  {
+    k = FASTPATH_MAX_MATCHES;
+  }
+
+  if (k > appdb_fuzzy_count(g_appdb_fuzzy))
+  {
+    k = appdb_fuzzy_count(g_appdb_fuzzy);
+  }
+
+  matches = malloc((k + 1) * sizeof(struct appdb_fuzzy_match));
+  if (matches == NULL)
+  {
+    log_error("malloc() failed");
+    return APPDB_FASTPATH_FAILED;
+  }
+
+  /* query is rest of the payload, which is zero terminated */
+  if (!appdb_fuzzy_search(g_appdb_fuzzy, payload, matches, k, &count))
+  {
+    free(matches);
+    return APPDB_FASTPATH_FAILED;
+  }
+
+  /* matches that don't fit are dropped, worst first */
+  for (i = 0; i < count; i++)
+  {
+    response_length = g_fastpath_response_length;
+    score = matches[i].score;
+
+    if (!appdb_fastpath_put(&score, sizeof(score)) ||
+        !appdb_fastpath_put_string(matches[i].entry_ptr->name))
+    {
+      g_fastpath_response_length = response_length;
+      break;
+    }
+  }
+
+  *count_ptr = i;
+
+  free(matches);
+
+  return APPDB_FASTPATH_OK;
+}
+
+static uint16_t appdb_fastpath_list_request(const char * payload, size_t length, uint16_t * count_ptr)
+{
+  const char * end;
+  uint32_t position;
+  uint32_t fields;
+  struct appdb_entry * const * entries;
+  size_t count;
+  uint32_t total;
+  size_t response_length;
+  uint16_t rows;
+
+  end = payload + length;
+  if (!appdb_fastpath_read_uint32(&payload, end, &position) ||
+      !appdb_fastpath_read_uint32(&payload, end, &fields) ||
+      payload != end ||
+      fields >= (1 << APPDB_FIELD_COUNT))
+  {
+    return APPDB_FASTPATH_INVALID;
+  }
+
+  if (fields == 0)
+  {
+    fields = (1 << APPDB_FIELD_COUNT) - 1;
+  }
+
+  if (g_appdb_name_view == NULL)
+  {
+    return APPDB_FASTPATH_FAILED;
+  }
+
+  entries = appdb_sorted_view_get(g_appdb_name_view, &count);
+  total = count;
+  if (!appdb_fastpath_put(&total, sizeof(total)))
+  {
+    return APPDB_FASTPATH_FAILED;
+  }
+
+  /* as many as fit, client asks for the rest with next request */
+  for (rows = 0; position < count && rows < UINT16_MAX; position++, rows++)
+  {
+    response_length = g_fastpath_response_length;
+    if (!appdb_fastpath_put_fields(entries[position], fields))
+    {
+      g_fastpath_response_length = response_length;
+      break;
+    }
+  }
+
+  *count_ptr = rows;
+
+  return APPDB_FASTPATH_OK;
+}
+
+/* returns 1 if a request was handled, 0 if there is none pending, -1 if the client is to be disconnected */
+static int appdb_fastpath_handle(int fd)
+{
+  ssize_t ret;
+  struct appdb_fastpath_header request;
+  struct appdb_fastpath_header response;
+  struct iovec iov[2];
+  struct msghdr message;
+
+  ret = recv(fd, g_fastpath_request, APPDB_FASTPATH_MAX_PACKET, MSG_DONTWAIT);
+  if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
+    return 0;
+  }
+
+  if (ret <= 0)
+  {
+    return -1;
+  }
+
+  g_fastpath_response_length = 0;
+  response.id = 0;
+  response.count = 0;
+
+  memcpy(&request, g_fastpath_request, ret < (ssize_t)sizeof(request) ? (size_t)ret : sizeof(request));
+  if (ret < (ssize_t)sizeof(request) || request.length != ret - sizeof(request))
+  {
+    response.code = APPDB_FASTPATH_INVALID;
+    goto send;
+  }
+
+  response.id = request.id;
+  g_fastpath_request[ret] = 0;
+
+  appdb_db_lock_shared();
+
+  if (!appdb_db_is_ready())
+  {
+    response.code = APPDB_FASTPATH_LOADING;
+  }
+  else
+  {
+    switch (request.code)
+    {
+    case APPDB_FASTPATH_LOOKUP:
+      response.code = appdb_fastpath_lookup_request(g_fastpath_request + sizeof(request), request.length, &response.count);
+      break;
+    case APPDB_FASTPATH_SEARCH:
+      response.code = appdb_fastpath_search_request(g_fastpath_request + sizeof(request), request.length, &response.count);
+      break;
+    case APPDB_FASTPATH_LIST:
+      response.code = appdb_fastpath_list_request(g_fastpath_request + sizeof(request), request.length, &response.count);
+      break;
+    default:
+      response.code = APPDB_FASTPATH_INVALID;
+    }
+  }
+
+  appdb_db_unlock();
+
+  if (response.code != APPDB_FASTPATH_OK)
+  {
+    g_fastpath_response_length = 0;
+    response.count = 0;
+  }
+
+send:
+  response.length = g_fastpath_response_length;
+
+  iov[0].iov_base = &response;
+  iov[0].iov_len = sizeof(response);
+  iov[1].iov_base = g_fastpath_response;
+  iov[1].iov_len = g_fastpath_response_length;
+
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = iov;
+  message.msg_iovlen = 2;
+
+  /* the thread serves all clients, it can't wait for one that does not read */
+  if (sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)(sizeof(response) + g_fastpath_response_length))
+  {
+    log_info("Fast path client does not read responses, disconnecting it");
+    return -1;
+  }
+
+  return 1;
+}
+
+static void * appdb_fastpath_thread(void * UNUSED(arg))
+{
+  struct pollfd fds[2 + FASTPATH_MAX_CLIENTS];
+  nfds_t count;
+  nfds_t i;
+  int fd;
+  int burst;
+  int ret;
+
+  fds[0].fd = g_fastpath_wakeup[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = g_fastpath_listen_fd;
+  fds[1].events = POLLIN;
+  count = 2;
+
+  for (;;)
+  {
+    if (poll(fds, count, -1) == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      log_error("poll() failed: %s", strerror(errno));
+      break;
+    }
+
+    if (fds[0].revents != 0)
+    {
+      break;
+    }
+
+    for (i = 2; i < count; i++)
+    {
+      if (fds[i].revents == 0)
+      {
+        continue;
+      }
+
+      /* pending requests are handled before the hangup */
+      ret = (fds[i].revents & POLLIN) != 0 ? 1 : -1;
+      for (burst = 0; burst < FASTPATH_BURST && ret == 1; burst++)
+      {
+        ret = appdb_fastpath_handle(fds[i].fd);
+      }
+
+      if (ret == -1)
+      {
+        close(fds[i].fd);
+        fds[i--] = fds[--count];
+      }
+    }
+
+    if ((fds[1].revents & POLLIN) != 0)
+    {
+      fd = accept4(g_fastpath_listen_fd, NULL, NULL, SOCK_CLOEXEC);
+      if (fd == -1)
+      {
+        log_error("accept() failed: %s", strerror(errno));
+      }
+      else if (count == 2 + FASTPATH_MAX_CLIENTS)
+      {
+        log_error("Too many fast path clients");
+        close(fd);
+      }
+      else
+      {
+        fds[count].fd = fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        count++;
+      }
+    }
+
+    __atomic_store_n(&g_fastpath_clients, count - 2, __ATOMIC_RELAXED);
+  }
+
+  for (i = 2; i < count; i++)
+  {
+    close(fds[i].fd);
+  }
+
+  return NULL;
+}
+
+bool appdb_fastpath_start(void)
+{
+  const char * runtime_dir;
+  struct sockaddr_un address;
+  struct stat st;
+  int ret;
+
+  runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if (runtime_dir == NULL || *runtime_dir == 0)
+  {
+    log_info("XDG_RUNTIME_DIR is not set, fast path is disabled");
+    return false;
+  }
+
+  g_fastpath_path = catdup(runtime_dir, FASTPATH_SOCKET_NAME);
+  if (g_fastpath_path == NULL)
+  {
+    return false;
+  }
+
+  if (strlen(g_fastpath_path) >= sizeof(address.sun_path))
+  {
+    log_error("Fast path socket path '%s' is too long", g_fastpath_path);
+    goto free_path;
+  }
+
+  g_fastpath_listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (g_fastpath_listen_fd == -1)
+  {
+    log_error("socket() failed: %s", strerror(errno));
+    goto free_path;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, g_fastpath_path);
+
+  /* socket of previous instance; bus name is already acquired, so no other instance is running */
+  unlink(g_fastpath_path);
+
+  if (bind(g_fastpath_listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+  {
+    log_error("bind() to '%s' failed: %s", g_fastpath_path, strerror(errno));
+    goto close_socket;
+  }
+
+  chmod(g_fastpath_path, S_IRUSR | S_IWUSR);
+
+  if (stat(g_fastpath_path, &st) == 0)
+  {
+    g_fastpath_ino = st.st_ino;
+  }
+
+  if (listen(g_fastpath_listen_fd, 16) != 0)
+  {
+    log_error("listen() failed: %s", strerror(errno));
+    goto unlink_socket;
+  }
+
+  if (pipe2(g_fastpath_wakeup, O_CLOEXEC) != 0)
+  {
+    log_error("pipe() failed: %s", strerror(errno));
+    goto unlink_socket;
+  }
+
+  ret = pthread_create(&g_fastpath_thread, NULL, appdb_fastpath_thread, NULL);
+  if (ret != 0)
+  {
+    log_error("Failed to start the fast path thread: %s", strerror(ret));
+    goto close_pipe;
+  }
+
+  log_info("Fast path is listening on '%s'", g_fastpath_path);
+
+  return true;
+
+close_pipe:
+  close(g_fastpath_wakeup[0]);
+  close(g_fastpath_wakeup[1]);
+  g_fastpath_wakeup[0] = -1;
+  g_fastpath_wakeup[1] = -1;
+unlink_socket:
+  unlink(g_fastpath_path);
+close_socket:
+  close(g_fastpath_listen_fd);
+  g_fastpath_listen_fd = -1;
+free_path:
+  free(g_fastpath_path);
+  g_fastpath_path = NULL;
+  return false;
+}
+
+void appdb_fastpath_stop(void)
+{
+  struct stat st;
+
+  /* not started */
+  if (g_fastpath_listen_fd == -1)
+  {
+    return;
+  }
+
+  if (write(g_fastpath_wakeup[1], "", 1) != 1)
+  {
+    log_error("Failed to wake up the fast path thread: %s", strerror(errno));
+  }
+
+  pthread_join(g_fastpath_thread, NULL);
+
+  close(g_fastpath_wakeup[0]);
+  close(g_fastpath_wakeup[1]);
+  g_fastpath_wakeup[0] = -1;
+  g_fastpath_wakeup[1] = -1;
+
+  /* after idle exit, the next instance can be already listening on the path */
+  if (stat(g_fastpath_path, &st) == 0 && st.st_ino == g_fastpath_ino)
+  {
+    unlink(g_fastpath_path);
+  }
+
+  close(g_fastpath_listen_fd);
+  g_fastpath_listen_fd = -1;
+  free(g_fastpath_path);
+  g_fastpath_path = NULL;
+}
+
+const char * appdb_fastpath_socket(void)
+{
+  return g_fastpath_path;
+}
+
+unsigned int appdb_fastpath_clients(void)
+{
+  return __atomic_load_n(&g_fastpath_clients, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,28 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ********************************************************
+ * This file contains interface to the fast path server *
+ ********************************************************/
+
+#ifndef FASTPATH_H__2F7C4D19_8B3E_4A65_9C0D_E1A6B5F8372C__INCLUDED
+#define FASTPATH_H__2F7C4D19_8B3E_4A65_9C0D_E1A6B5F8372C__INCLUDED
+
+#include "common.h"
+
+/* Serve the protocol of appdb/fastpath.h on a socket in $XDG_RUNTIME_DIR, in a thread.
+ * The thread reads the database with appdb_db_lock_shared() held. */
+bool appdb_fastpath_start(void);
+void appdb_fastpath_stop(void);
+
+/* path of the socket, NULL if the fast path is not running */
+const char * appdb_fastpath_socket(void);
+
+/* number of connected clients */
+unsigned int appdb_fastpath_clients(void);
+
+#endif /* #ifndef FASTPATH_H__2F7C4D19_8B3E_4A65_9C0D_E1A6B5F8372C__INCLUDED */
@@ -0,0 +1,501 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ **********************************************************
+ * This file contains implementation of the fuzzy matcher *
+ **********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "fuzzy.h"
+
+/* Matching is done in two steps. First, each name has a 64-bit mask of
+ * characters it contains, and names that lack a character of the query are
+ * rejected by testing the masks of FUZZY_LANES names at a time, with GCC
+ * vector extensions that compile to SSE2/AVX2 or NEON instructions. The
+ * remaining names are then checked and scored one by one, in the buffer with
+ * all names, case folded with appdb_casefold() like the query, so matching
+ * ignores case same as the completion index does. With many entries, the
+ * work is split to threads. */
+
+#define FUZZY_LANES 4
+
+#define FUZZY_THREADS_MAX 4
+#define FUZZY_THREAD_ENTRIES_MIN 16384  /* below this, starting of threads costs more than it saves */
+
+#define SCORE_MATCH 16
+#define SCORE_BOUNDARY 8               /* matched character starts a word */
+#define SCORE_PREFIX 8                 /* matched character starts the name */
+#define SCORE_CONSECUTIVE 4            /* matched character follows previous matched one */
+#define SCORE_GAP_START 3
+#define SCORE_GAP 1
+
+typedef uint64_t appdb_fuzzy_lanes __attribute__((vector_size(FUZZY_LANES * sizeof(uint64_t))));
+
+struct appdb_fuzzy
+{
+  char * names;                 /* case folded names, each NUL terminated */
+  size_t * offsets;             /* entry number -> start of name in names */
+  appdb_fuzzy_lanes * masks;    /* entry number -> characters present in the name, padded to FUZZY_LANES */
+  struct appdb_entry ** entries;
+  size_t count;
+};
+
+struct appdb_fuzzy_candidate
+{
+  size_t no;                    /* entry number */
+  unsigned int score;
+};
+
+/* state of one search, or of one thread of a search */
+struct appdb_fuzzy_search
+{
+  struct appdb_fuzzy * fuzzy_ptr;
+  const char * query;
+  size_t query_len;
+  uint64_t query_mask;
+  size_t first;                 /* range of entries, first is multiple of FUZZY_LANES */
+  size_t last;
+  struct appdb_fuzzy_candidate * heap;  /* min-heap of the best matches, worst on top */
+  size_t k;
+  size_t count;
+};
+
+/* different characters can share a bit, so the mask only tells which names can't match */
+static inline uint64_t appdb_fuzzy_char_bit(char c)
+{
+  return UINT64_C(1) << ((unsigned char)c & 63);
+}
+
+static inline bool appdb_fuzzy_is_word_char(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (unsigned char)c >= 0x80;
+}
+
+/* entry with higher score is better, with same score the one that comes first in appdb list */
+static inline bool appdb_fuzzy_better(const struct appdb_fuzzy_candidate * a, const struct appdb_fuzzy_candidate * b)
+{
+  return a->score > b->score || (a->score == b->score && a->no < b->no);
+}
+
+/* returns 0 if query is not a subsequence of name */
+static unsigned int appdb_fuzzy_score(const char * name, const char * query, size_t query_len)
+{
+  const char * end;
+  const char * start;
+  const char * ptr;
+  size_t i;
+  int score;
+  bool gap;
+
+  /* find end of the first match... */
+  i = 0;
+  for (end = name; *end != 0 && i < query_len; end++)
+  {
+    if (*end == query[i])
+    {
+      i++;
+    }
+  }
+
+  if (i < query_len)
+  {
+    return 0;
+  }
+
+  /* ...and go back to find the shortest match that ends there */
+  i = query_len;
+  for (start = end; i > 0; )
+  {
+    start--;
+    if (*start == query[i - 1])
+    {
+      i--;
+    }
+  }
+
+  score = 0;
+  gap = false;
+  i = 0;
+  for (ptr = start; ptr < end; ptr++)
+  {
+    if (*ptr != query[i])
+    {
+      score -= gap ? SCORE_GAP : SCORE_GAP_START;
+      gap = true;
+      continue;
+    }
+
+    score += SCORE_MATCH;
+
+    if (ptr == name)
+    {
+      score += SCORE_BOUNDARY + SCORE_PREFIX;
+    }
+    else if (!appdb_fuzzy_is_word_char(ptr[-1]))
+    {
+      score += SCORE_BOUNDARY;
+    }
+    else if (ptr != start && !gap)
+    {
+      score += SCORE_CONSECUTIVE;
+    }
+
+    gap = false;
+    i++;
+  }
+
+  /* every match scores at least 1 */
+  return score > 0 ? (unsigned int)score : 1;
+}
+
+static void appdb_fuzzy_heap_sift_down(struct appdb_fuzzy_candidate * heap, size_t count, size_t i)
+{
+  struct appdb_fuzzy_candidate candidate;
+  size_t child;
+
+  candidate = heap[i];
+
+  for (;;)
+  {
+    child = 2 * i + 1;
+    if (child >= count)
+    {
+      break;
+    }
+
+    /* pick the worse child */
+    if (child + 1 < count && appdb_fuzzy_better(heap + child, heap + child + 1))
+    {
+      child++;
+    }
+
+    if (!appdb_fuzzy_better(&candidate, heap + child))
+    {
+      break;
+    }
+
+    heap[i] = heap[child];
+    i = child;
+  }
+
+  heap[i] = candidate;
+}
+
+static void appdb_fuzzy_heap_push(struct appdb_fuzzy_candidate * heap, size_t k, size_t * count_ptr, const struct appdb_fuzzy_candidate * candidate_ptr)
+{
+  size_t i;
+
+  if (*count_ptr < k)
+  {
+    /* sift up */
+    i = (*count_ptr)++;
+    while (i > 0 && appdb_fuzzy_better(heap + (i - 1) / 2, candidate_ptr))
+    {
+      heap[i] = heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+
+    heap[i] = *candidate_ptr;
+    return;
+  }
+
+  /* replace the worst one */
+  if (appdb_fuzzy_better(candidate_ptr, heap))
+  {
+    heap[0] = *candidate_ptr;
+    appdb_fuzzy_heap_sift_down(heap, k, 0);
+  }
+}
+
+static void * appdb_fuzzy_search_range(void * arg)
+{
+  struct appdb_fuzzy_search * search_ptr;
+  struct appdb_fuzzy * fuzzy_ptr;
+  appdb_fuzzy_lanes query_mask;
+  appdb_fuzzy_lanes rejected;
+  struct appdb_fuzzy_candidate candidate;
+  size_t block;
+  size_t lane;
+
+  search_ptr = arg;
+  fuzzy_ptr = search_ptr->fuzzy_ptr;
+
+  query_mask = (appdb_fuzzy_lanes){ 0 } + search_ptr->query_mask;
+
+  for (block = search_ptr->first / FUZZY_LANES; block * FUZZY_LANES < search_ptr->last; block++)
+  {
+    /* lane is all ones for names that lack a character of the query */
+    rejected = (appdb_fuzzy_lanes)((fuzzy_ptr->masks[block] & query_mask) != query_mask);
+
+    for (lane = 0; lane < FUZZY_LANES; lane++)
+    {
+      candidate.no = block * FUZZY_LANES + lane;
+      if (rejected[lane] != 0 || candidate.no >= search_ptr->last)
+      {
+        continue;
+      }
+
+      candidate.score = appdb_fuzzy_score(fuzzy_ptr->names + fuzzy_ptr->offsets[candidate.no], search_ptr->query, search_ptr->query_len);
+      if (candidate.score != 0)
+      {
+        appdb_fuzzy_heap_push(search_ptr->heap, search_ptr->k, &search_ptr->count, &candidate);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+struct appdb_fuzzy * appdb_fuzzy_new(struct list_head * appdb)
+{
+  struct appdb_fuzzy * fuzzy_ptr;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  size_t size;
+  size_t blocks;
+  size_t no;
+  char * dst;
+  const char * src;
+  uint64_t mask;
+  char ** folded;
+
+  fuzzy_ptr = calloc(1, sizeof(struct appdb_fuzzy));
+  if (fuzzy_ptr == NULL)
+  {
+    log_error("calloc() failed");
+    return NULL;
+  }
+
+  list_for_each(node_ptr, appdb)
+  {
+    fuzzy_ptr->count++;
+  }
+
+  /* folded name can be longer than the name, so names are folded before the buffer is allocated */
+  folded = calloc(fuzzy_ptr->count + 1, sizeof(char *));
+  if (folded == NULL)
+  {
+    log_error("calloc() failed");
+    free(fuzzy_ptr);
+    return NULL;
+  }
+
+  size = 0;
+  no = 0;
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    folded[no] = appdb_casefold(entry_ptr->name);
+    if (folded[no] == NULL)
+    {
+      appdb_fuzzy_destroy(fuzzy_ptr);
+      fuzzy_ptr = NULL;
+      goto free_folded;
+    }
+
+    size += strlen(folded[no]) + 1;
+    no++;
+  }
+
+  blocks = (fuzzy_ptr->count + FUZZY_LANES - 1) / FUZZY_LANES;
+
+  fuzzy_ptr->names = malloc(size + 1);
+  fuzzy_ptr->offsets = malloc((fuzzy_ptr->count + 1) * sizeof(size_t));
+  fuzzy_ptr->entries = malloc((fuzzy_ptr->count + 1) * sizeof(struct appdb_entry *));
+  /* masks of the padding names are 0, they match only empty query, which is not searched for */
+  fuzzy_ptr->masks = aligned_alloc(sizeof(appdb_fuzzy_lanes), (blocks + 1) * sizeof(appdb_fuzzy_lanes));
+  if (fuzzy_ptr->names == NULL || fuzzy_ptr->offsets == NULL || fuzzy_ptr->entries == NULL || fuzzy_ptr->masks == NULL)
+  {
+    log_error("malloc() failed");
+    appdb_fuzzy_destroy(fuzzy_ptr);
+    fuzzy_ptr = NULL;
+    goto free_folded;
+  }
+
+  memset(fuzzy_ptr->masks, 0, (blocks + 1) * sizeof(appdb_fuzzy_lanes));
+
+  no = 0;
+  dst = fuzzy_ptr->names;
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    fuzzy_ptr->entries[no] = entry_ptr;
+    fuzzy_ptr->offsets[no] = dst - fuzzy_ptr->names;
+
+    mask = 0;
+    for (src = folded[no]; *src != 0; src++)
+    {
+      *dst = *src;
+      mask |= appdb_fuzzy_char_bit(*dst);
+      dst++;
+    }
+
+    *dst++ = 0;
+
+    fuzzy_ptr->masks[no / FUZZY_LANES][no % FUZZY_LANES] = mask;
+    no++;
+  }
+
+free_folded:
+  for (no = 0; folded[no] != NULL; no++)
+  {
+    free(folded[no]);
+  }
+
+  free(folded);
+
+  return fuzzy_ptr;
+}
+
+void appdb_fuzzy_destroy(struct appdb_fuzzy * fuzzy_ptr)
+{
+  if (fuzzy_ptr == NULL)
+  {
+    return;
+  }
+
+  free(fuzzy_ptr->names);
+  free(fuzzy_ptr->offsets);
+  free(fuzzy_ptr->masks);
+  free(fuzzy_ptr->entries);
+  free(fuzzy_ptr);
+}
+
+bool appdb_fuzzy_search(struct appdb_fuzzy * fuzzy_ptr, const char * query, struct appdb_fuzzy_match * matches, size_t k, size_t * count_ptr)
+{
+  struct appdb_fuzzy_search searches[FUZZY_THREADS_MAX];
+  pthread_t threads[FUZZY_THREADS_MAX];
+  struct appdb_fuzzy_candidate * heap;
+  char * folded;
+  size_t threads_count;
+  size_t started;
+  size_t range;
+  size_t count;
+  size_t i;
+  size_t j;
+  long cpus;
+  bool ret;
+
+  *count_ptr = 0;
+
+  if (*query == 0 || k == 0 || fuzzy_ptr->count == 0)
+  {
+    return true;
+  }
+
+  ret = false;
+
+  threads_count = 1;
+  if (fuzzy_ptr->count >= FUZZY_THREAD_ENTRIES_MIN)
+  {
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads_count = cpus > FUZZY_THREADS_MAX ? FUZZY_THREADS_MAX : (cpus > 1 ? (size_t)cpus : 1);
+  }
+
+  folded = appdb_casefold(query);
+  /* one heap per thread, and one for merging */
+  heap = malloc((threads_count + 1) * k * sizeof(struct appdb_fuzzy_candidate));
+  if (folded == NULL || heap == NULL)
+  {
+    log_error("malloc() failed");
+    goto exit;
+  }
+
+  /* ranges start at block boundaries */
+  range = (fuzzy_ptr->count + threads_count - 1) / threads_count;
+  range = (range + FUZZY_LANES - 1) / FUZZY_LANES * FUZZY_LANES;
+
+  for (i = 0; i < threads_count; i++)
+  {
+    searches[i].fuzzy_ptr = fuzzy_ptr;
+    searches[i].query = folded;
+    searches[i].query_len = strlen(folded);
+    searches[i].query_mask = 0;
+    for (j = 0; folded[j] != 0; j++)
+    {
+      searches[i].query_mask |= appdb_fuzzy_char_bit(folded[j]);
+    }
+
+    searches[i].first = i * range < fuzzy_ptr->count ? i * range : fuzzy_ptr->count;
+    searches[i].last = (i + 1) * range < fuzzy_ptr->count ? (i + 1) * range : fuzzy_ptr->count;
+    searches[i].heap = heap + i * k;
+    searches[i].k = k;
+    searches[i].count = 0;
+  }
+
+  /* first range is searched in this thread, if a thread fails to start, its range is searched here too */
+  for (started = 1; started < threads_count; started++)
+  {
+    if (pthread_create(threads + started, NULL, appdb_fuzzy_search_range, searches + started) != 0)
+    {
+      log_error("Failed to start fuzzy search thread");
+      break;
+    }
+  }
+
+  appdb_fuzzy_search_range(searches);
+  for (i = started; i < threads_count; i++)
+  {
+    appdb_fuzzy_search_range(searches + i);
+  }
+
+  for (i = 1; i < started; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  /* merge heaps of the threads */
+  count = 0;
+  for (i = 0; i < threads_count; i++)
+  {
+    for (j = 0; j < searches[i].count; j++)
+    {
+      appdb_fuzzy_heap_push(heap + threads_count * k, k, &count, searches[i].heap + j);
+    }
+  }
+
+  /* pop the worst one until heap is empty, so the best one ends up first */
+  *count_ptr = count;
+  while (count > 0)
+  {
+    count--;
+    matches[count].entry_ptr = fuzzy_ptr->entries[heap[threads_count * k].no];
+    matches[count].score = heap[threads_count * k].score;
+    heap[threads_count * k] = heap[threads_count * k + count];
+    appdb_fuzzy_heap_sift_down(heap + threads_count * k, count, 0);
+  }
+
+  ret = true;
+
+exit:
+  free(heap);
+  free(folded);
+  return ret;
+}
+
+size_t appdb_fuzzy_count(struct appdb_fuzzy * fuzzy_ptr)
+{
+  return fuzzy_ptr->count;
+}
+
+size_t appdb_fuzzy_memory(struct appdb_fuzzy * fuzzy_ptr)
+{
+  return
+    malloc_usable_size(fuzzy_ptr) +
+    malloc_usable_size(fuzzy_ptr->names) +
+    malloc_usable_size(fuzzy_ptr->offsets) +
+    malloc_usable_size(fuzzy_ptr->masks) +
+    malloc_usable_size(fuzzy_ptr->entries);
+}
@@ -0,0 +1,38 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *****************************************************
+ * This file contains interface to the fuzzy matcher *
+ *****************************************************/
+
+#ifndef FUZZY_H__C85E2F17_9A3B_4D60_B1E4_6F0D83A27C59__INCLUDED
+#define FUZZY_H__C85E2F17_9A3B_4D60_B1E4_6F0D83A27C59__INCLUDED
+
+#include "common.h"
+
+struct appdb_fuzzy;
+
+struct appdb_fuzzy_match
+{
+  struct appdb_entry * entry_ptr;
+  unsigned int score;           /* higher is better */
+};
+
+/* the matcher references the entries, so it must be destroyed before appdb_free() */
+struct appdb_fuzzy * appdb_fuzzy_new(struct list_head * appdb);
+void appdb_fuzzy_destroy(struct appdb_fuzzy * fuzzy_ptr);
+
+/* Find entries whose name contains characters of the query in same order, ignoring case as appdb_casefold() does.
+ * Up to k best matches are stored in matches, best first; empty query matches nothing. */
+bool appdb_fuzzy_search(struct appdb_fuzzy * fuzzy_ptr, const char * query, struct appdb_fuzzy_match * matches, size_t k, size_t * count_ptr);
+
+/* number of entries, there can't be more matches */
+size_t appdb_fuzzy_count(struct appdb_fuzzy * fuzzy_ptr);
+
+size_t appdb_fuzzy_memory(struct appdb_fuzzy * fuzzy_ptr);
+
+#endif /* #ifndef FUZZY_H__C85E2F17_9A3B_4D60_B1E4_6F0D83A27C59__INCLUDED */
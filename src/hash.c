@@ -0,0 +1,327 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *******************************************************
+ * This file contains implementation of the hash table *
+ *******************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <malloc.h>
+
+#include "common.h"
+#include "hash.h"
+
+#define APPDB_HASH_INITIAL_BUCKETS 64
+
+struct appdb_hash_node
+{
+  struct appdb_hash_node * next;
+  uint32_t hash;
+  void * value;
+  char key[];
+};
+
+struct appdb_hash
+{
+  struct appdb_hash_node ** buckets;
+  size_t buckets_count;         /* always power of two */
+  size_t count;
+  appdb_hash_value_free value_free;
+};
+
+/* FNV-1a */
+static
+uint32_t
+appdb_hash_string(
+  const char * key)
+{
+  uint32_t hash;
+
+  hash = 2166136261U;
+
+  while (*key != 0)
+  {
+    hash ^= (unsigned char)*key++;
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+struct appdb_hash *
+appdb_hash_new(
+  appdb_hash_value_free value_free)
+{
+  struct appdb_hash * hash_ptr;
+
+  hash_ptr = malloc(sizeof(struct appdb_hash));
+  if (hash_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    return NULL;
+  }
+
+  hash_ptr->buckets = calloc(APPDB_HASH_INITIAL_BUCKETS, sizeof(struct appdb_hash_node *));
+  if (hash_ptr->buckets == NULL)
+  {
+    log_error("calloc() failed");
+    free(hash_ptr);
+    return NULL;
+  }
+
+  hash_ptr->buckets_count = APPDB_HASH_INITIAL_BUCKETS;
+  hash_ptr->count = 0;
+  hash_ptr->value_free = value_free;
+
+  return hash_ptr;
+}
+
+void
+appdb_hash_destroy(
+  struct appdb_hash * hash_ptr)
+{
+  if (hash_ptr == NULL)
+  {
+    return;
+  }
+
+  appdb_hash_clear(hash_ptr);
+  free(hash_ptr->buckets);
+  free(hash_ptr);
+}
+
+static
+struct appdb_hash_node **
+appdb_hash_find(
+  struct appdb_hash * hash_ptr,
+  const char * key,
+  uint32_t hash)
+{
+  struct appdb_hash_node ** node_ptr_ptr;
+
+  node_ptr_ptr = hash_ptr->buckets + (hash & (hash_ptr->buckets_count - 1));
+
+  while (*node_ptr_ptr != NULL)
+  {
+    if ((*node_ptr_ptr)->hash == hash && strcmp((*node_ptr_ptr)->key, key) == 0)
+    {
+      break;
+    }
+
+    node_ptr_ptr = &(*node_ptr_ptr)->next;
+  }
+
+  return node_ptr_ptr;
+}
+
+static
+void
+appdb_hash_grow(
+  struct appdb_hash * hash_ptr)
+{
+  struct appdb_hash_node ** buckets;
+  struct appdb_hash_node * node_ptr;
+  struct appdb_hash_node * next_ptr;
+  size_t buckets_count;
+  size_t i;
+
+  buckets_count = hash_ptr->buckets_count * 2;
+
+  buckets = calloc(buckets_count, sizeof(struct appdb_hash_node *));
+  if (buckets == NULL)
+  {
+    /* not fatal, chains just get longer */
+    log_error("calloc() failed");
+    return;
+  }
+
+  for (i = 0; i < hash_ptr->buckets_count; i++)
+  {
+    for (node_ptr = hash_ptr->buckets[i]; node_ptr != NULL; node_ptr = next_ptr)
+    {
+      next_ptr = node_ptr->next;
+      node_ptr->next = buckets[node_ptr->hash & (buckets_count - 1)];
+      buckets[node_ptr->hash & (buckets_count - 1)] = node_ptr;
+    }
+  }
+
+  free(hash_ptr->buckets);
+  hash_ptr->buckets = buckets;
+  hash_ptr->buckets_count = buckets_count;
+}
+
+bool
+appdb_hash_set(
+  struct appdb_hash * hash_ptr,
+  const char * key,
+  void * value)
+{
+  uint32_t hash;
+  struct appdb_hash_node ** node_ptr_ptr;
+  struct appdb_hash_node * node_ptr;
+  size_t key_size;
+
+  hash = appdb_hash_string(key);
+  node_ptr_ptr = appdb_hash_find(hash_ptr, key, hash);
+
+  if (*node_ptr_ptr != NULL)
+  {
+    if (hash_ptr->value_free != NULL && (*node_ptr_ptr)->value != value)
+    {
+      hash_ptr->value_free((*node_ptr_ptr)->value);
+    }
+
+    (*node_ptr_ptr)->value = value;
+    return true;
+  }
+
+  key_size = strlen(key) + 1;
+
+  node_ptr = malloc(sizeof(struct appdb_hash_node) + key_size);
+  if (node_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  node_ptr->next = NULL;
+  node_ptr->hash = hash;
+  node_ptr->value = value;
+  memcpy(node_ptr->key, key, key_size);
+
+  *node_ptr_ptr = node_ptr;
+  hash_ptr->count++;
+
+  if (hash_ptr->count > hash_ptr->buckets_count)
+  {
+    appdb_hash_grow(hash_ptr);
+  }
+
+  return true;
+}
+
+void *
+appdb_hash_get(
+  struct appdb_hash * hash_ptr,
+  const char * key)
+{
+  struct appdb_hash_node * node_ptr;
+
+  node_ptr = *appdb_hash_find(hash_ptr, key, appdb_hash_string(key));
+
+  return node_ptr != NULL ? node_ptr->value : NULL;
+}
+
+bool
+appdb_hash_remove(
+  struct appdb_hash * hash_ptr,
+  const char * key)
+{
+  struct appdb_hash_node ** node_ptr_ptr;
+  struct appdb_hash_node * node_ptr;
+
+  node_ptr_ptr = appdb_hash_find(hash_ptr, key, appdb_hash_string(key));
+  node_ptr = *node_ptr_ptr;
+  if (node_ptr == NULL)
+  {
+    return false;
+  }
+
+  *node_ptr_ptr = node_ptr->next;
+  hash_ptr->count--;
+
+  if (hash_ptr->value_free != NULL)
+  {
+    hash_ptr->value_free(node_ptr->value);
+  }
+
+  free(node_ptr);
+
+  return true;
+}
+
+void
+appdb_hash_clear(
+  struct appdb_hash * hash_ptr)
+{
+  struct appdb_hash_node * node_ptr;
+  struct appdb_hash_node * next_ptr;
+  size_t i;
+
+  for (i = 0; i < hash_ptr->buckets_count; i++)
+  {
+    for (node_ptr = hash_ptr->buckets[i]; node_ptr != NULL; node_ptr = next_ptr)
+    {
+      next_ptr = node_ptr->next;
+
+      if (hash_ptr->value_free != NULL)
+      {
+        hash_ptr->value_free(node_ptr->value);
+      }
+
+      free(node_ptr);
+    }
+
+    hash_ptr->buckets[i] = NULL;
+  }
+
+  hash_ptr->count = 0;
+}
+
+size_t
+appdb_hash_count(
+  struct appdb_hash * hash_ptr)
+{
+  return hash_ptr->count;
+}
+
+void
+appdb_hash_foreach(
+  struct appdb_hash * hash_ptr,
+  appdb_hash_callback callback,
+  void * ctx)
+{
+  struct appdb_hash_node * node_ptr;
+  size_t i;
+
+  for (i = 0; i < hash_ptr->buckets_count; i++)
+  {
+    for (node_ptr = hash_ptr->buckets[i]; node_ptr != NULL; node_ptr = node_ptr->next)
+    {
+      callback(ctx, node_ptr->key, node_ptr->value);
+    }
+  }
+}
+
+size_t
+appdb_hash_memory(
+  struct appdb_hash * hash_ptr,
+  appdb_hash_value_memory value_memory)
+{
+  struct appdb_hash_node * node_ptr;
+  size_t size;
+  size_t i;
+
+  size = malloc_usable_size(hash_ptr) + malloc_usable_size(hash_ptr->buckets);
+
+  for (i = 0; i < hash_ptr->buckets_count; i++)
+  {
+    for (node_ptr = hash_ptr->buckets[i]; node_ptr != NULL; node_ptr = node_ptr->next)
+    {
+      size += malloc_usable_size(node_ptr);
+
+      if (value_memory != NULL)
+      {
+        size += value_memory(node_ptr->value);
+      }
+    }
+  }
+
+  return size;
+}
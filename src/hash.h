@@ -0,0 +1,74 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ **************************************************
+ * This file contains interface to the hash table *
+ **************************************************/
+
+#ifndef HASH_H__3F9E2B61_0C4D_4A7B_8E15_D6A2C9B4E703__INCLUDED
+#define HASH_H__3F9E2B61_0C4D_4A7B_8E15_D6A2C9B4E703__INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* string keyed hash table, keys are copied, values are owned by the table if value_free is not NULL */
+struct appdb_hash;
+
+typedef void (* appdb_hash_value_free)(void * value);
+typedef void (* appdb_hash_callback)(void * ctx, const char * key, void * value);
+typedef size_t (* appdb_hash_value_memory)(void * value);
+
+struct appdb_hash *
+appdb_hash_new(
+  appdb_hash_value_free value_free);
+
+void
+appdb_hash_destroy(
+  struct appdb_hash * hash_ptr);
+
+/* replaces (and frees) the old value if key is already present */
+bool
+appdb_hash_set(
+  struct appdb_hash * hash_ptr,
+  const char * key,
+  void * value);
+
+/* NULL if key is not present */
+void *
+appdb_hash_get(
+  struct appdb_hash * hash_ptr,
+  const char * key);
+
+/* returns false if key is not present */
+bool
+appdb_hash_remove(
+  struct appdb_hash * hash_ptr,
+  const char * key);
+
+void
+appdb_hash_clear(
+  struct appdb_hash * hash_ptr);
+
+size_t
+appdb_hash_count(
+  struct appdb_hash * hash_ptr);
+
+/* callback must not modify the table */
+void
+appdb_hash_foreach(
+  struct appdb_hash * hash_ptr,
+  appdb_hash_callback callback,
+  void * ctx);
+
+/* heap bytes used by the table, its nodes and keys, */
+/* plus size of each value as returned by value_memory, if not NULL */
+size_t
+appdb_hash_memory(
+  struct appdb_hash * hash_ptr,
+  appdb_hash_value_memory value_memory);
+
+#endif /* #ifndef HASH_H__3F9E2B61_0C4D_4A7B_8E15_D6A2C9B4E703__INCLUDED */
@@ -0,0 +1,1406 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ **********************************************************
+ * This file contains implementation of the icon resolver *
+ **********************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "icons.h"
+#include "hash.h"
+#include "watcher.h"
+#include "catdup.h"
+
+#define ICON_DIR_TYPE_FIXED      0
+#define ICON_DIR_TYPE_SCALABLE   1
+#define ICON_DIR_TYPE_THRESHOLD  2
+
+/* same values as the flags in icon-theme.cache */
+#define ICON_SUFFIX_XPM  1
+#define ICON_SUFFIX_SVG  2
+#define ICON_SUFFIX_PNG  4
+
+#define ICON_MAX_IMAGES   256
+#define ICON_MAX_THEMES   32
+#define ICON_CACHE_LIMIT  10000
+
+#define ICON_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB)
+
+struct appdb_icon_dir
+{
+  char * name;
+  int size;
+  int min_size;
+  int max_size;
+  int threshold;
+  int scale;
+  unsigned int type;
+};
+
+struct appdb_icon_image
+{
+  unsigned int dir;             /* index in dirs array of the theme */
+  unsigned int suffixes;        /* ICON_SUFFIX_xxx */
+};
+
+/* value of the own index, used when there is no usable icon-theme.cache */
+struct appdb_icon_images
+{
+  size_t count;
+  struct appdb_icon_image images[];
+};
+
+/* the theme directory in one of the base directories, for example /usr/share/icons/hicolor */
+struct appdb_icon_theme_location
+{
+  char * path;
+  const unsigned char * cache;  /* mmaped icon-theme.cache, NULL if not present or older than the directory */
+  size_t cache_size;
+  int * cache_dirs;             /* cache directory index -> theme directory index, -1 if not in index.theme */
+  uint32_t cache_dirs_count;
+  struct appdb_hash * index;    /* icon name -> struct appdb_icon_images, when cache is not used */
+  time_t mtime;                 /* of the directory, icon-theme.cache older than it is stale */
+};
+
+struct appdb_icon_theme
+{
+  struct list_head siblings;
+  char * name;
+  struct appdb_icon_dir * dirs;
+  size_t dirs_count;
+  char * inherits;              /* comma separated list of theme names, NULL if not present */
+  struct appdb_icon_theme_location * locations;
+  size_t locations_count;
+};
+
+static char ** g_icon_base_dirs;    /* NULL terminated */
+static struct list_head g_icon_themes;
+static struct appdb_hash * g_icon_cache; /* "size/name" -> path, empty string if icon was not found */
+static int * g_icon_watches;
+static size_t g_icon_watches_count;
+static bool g_icons_dirty;
+static bool g_icons_base_dirs_watched; /* for themes that get installed later */
+
+static
+void
+appdb_icons_watch_callback(
+  void * UNUSED(ctx),
+  const char * UNUSED(path),
+  const char * UNUSED(name),
+  uint32_t UNUSED(mask))
+{
+  g_icons_dirty = true;
+}
+
+static
+void
+appdb_icons_watch(
+  const char * path)
+{
+  int handle;
+  int * watches;
+
+  handle = appdb_watcher_add(path, ICON_WATCH_MASK, appdb_icons_watch_callback, NULL);
+  if (handle == -1)
+  {
+    return;
+  }
+
+  watches = realloc(g_icon_watches, (g_icon_watches_count + 1) * sizeof(int));
+  if (watches == NULL)
+  {
+    log_error("realloc() failed");
+    appdb_watcher_remove(handle);
+    return;
+  }
+
+  g_icon_watches = watches;
+  g_icon_watches[g_icon_watches_count++] = handle;
+}
+
+static
+bool
+appdb_icons_add_base_dir(
+  size_t * count_ptr,
+  const char * dir1,
+  const char * dir2)
+{
+  char ** dirs;
+
+  dirs = realloc(g_icon_base_dirs, (*count_ptr + 2) * sizeof(char *));
+  if (dirs == NULL)
+  {
+    log_error("realloc() failed");
+    return false;
+  }
+
+  g_icon_base_dirs = dirs;
+
+  dirs[*count_ptr] = catdup(dir1, dir2);
+  if (dirs[*count_ptr] == NULL)
+  {
+    return false;
+  }
+
+  (*count_ptr)++;
+  dirs[*count_ptr] = NULL;
+
+  return true;
+}
+
+bool appdb_icons_init(void)
+{
+  const char * home;
+  const char * data_home;
+  const char * data_dirs;
+  char * dirs;
+  char * dir;
+  char * limiter;
+  size_t count;
+  bool ret;
+
+  INIT_LIST_HEAD(&g_icon_themes);
+
+  g_icon_cache = appdb_hash_new(free);
+  if (g_icon_cache == NULL)
+  {
+    return false;
+  }
+
+  /* base directories, in order of the Icon Theme Specification */
+  count = 0;
+  home = getenv("HOME");
+  if (home != NULL && !appdb_icons_add_base_dir(&count, home, "/.icons"))
+  {
+    goto fail;
+  }
+
+  data_home = getenv("XDG_DATA_HOME");
+  if (data_home != NULL && *data_home != 0)
+  {
+    ret = appdb_icons_add_base_dir(&count, data_home, "/icons");
+  }
+  else
+  {
+    ret = home == NULL || appdb_icons_add_base_dir(&count, home, "/.local/share/icons");
+  }
+
+  if (!ret)
+  {
+    goto fail;
+  }
+
+  data_dirs = getenv("XDG_DATA_DIRS");
+  dirs = strdup(data_dirs != NULL && *data_dirs != 0 ? data_dirs : "/usr/local/share/:/usr/share/");
+  if (dirs == NULL)
+  {
+    log_error("strdup() failed");
+    goto fail;
+  }
+
+  for (dir = dirs; dir != NULL; dir = limiter)
+  {
+    limiter = strchr(dir, ':');
+    if (limiter != NULL)
+    {
+      *limiter++ = 0;
+    }
+
+    if (*dir != 0 && !appdb_icons_add_base_dir(&count, dir, "/icons"))
+    {
+      free(dirs);
+      goto fail;
+    }
+  }
+
+  free(dirs);
+
+  if (!appdb_icons_add_base_dir(&count, "/usr/share/pixmaps", ""))
+  {
+    goto fail;
+  }
+
+  return true;
+
+fail:
+  appdb_icons_uninit();
+  return false;
+}
+
+static
+void
+appdb_icon_theme_destroy(
+  struct appdb_icon_theme * theme_ptr)
+{
+  size_t i;
+
+  for (i = 0; i < theme_ptr->locations_count; i++)
+  {
+    if (theme_ptr->locations[i].cache != NULL)
+    {
+      munmap((void *)theme_ptr->locations[i].cache, theme_ptr->locations[i].cache_size);
+    }
+
+    free(theme_ptr->locations[i].cache_dirs);
+    appdb_hash_destroy(theme_ptr->locations[i].index);
+    free(theme_ptr->locations[i].path);
+  }
+
+  for (i = 0; i < theme_ptr->dirs_count; i++)
+  {
+    free(theme_ptr->dirs[i].name);
+  }
+
+  free(theme_ptr->locations);
+  free(theme_ptr->dirs);
+  free(theme_ptr->inherits);
+  free(theme_ptr->name);
+  free(theme_ptr);
+}
+
+/* drop everything that was loaded and resolved, it will be loaded again on demand */
+static
+void
+appdb_icons_flush(void)
+{
+  struct appdb_icon_theme * theme_ptr;
+  size_t i;
+
+  log_debug("Flushing icon themes and resolved icons");
+
+  while (!list_empty(&g_icon_themes))
+  {
+    theme_ptr = list_entry(g_icon_themes.next, struct appdb_icon_theme, siblings);
+    list_del(&theme_ptr->siblings);
+    appdb_icon_theme_destroy(theme_ptr);
+  }
+
+  for (i = 0; i < g_icon_watches_count; i++)
+  {
+    appdb_watcher_remove(g_icon_watches[i]);
+  }
+
+  free(g_icon_watches);
+  g_icon_watches = NULL;
+  g_icon_watches_count = 0;
+
+  if (g_icon_cache != NULL)
+  {
+    appdb_hash_clear(g_icon_cache);
+  }
+
+  g_icons_dirty = false;
+  g_icons_base_dirs_watched = false;
+}
+
+void appdb_icons_uninit(void)
+{
+  char ** dir_ptr;
+
+  appdb_icons_flush();
+
+  appdb_hash_destroy(g_icon_cache);
+  g_icon_cache = NULL;
+
+  if (g_icon_base_dirs != NULL)
+  {
+    for (dir_ptr = g_icon_base_dirs; *dir_ptr != NULL; dir_ptr++)
+    {
+      free(*dir_ptr);
+    }
+
+    free(g_icon_base_dirs);
+    g_icon_base_dirs = NULL;
+  }
+}
+
+static
+char *
+appdb_icons_strip(
+  char * string)
+{
+  char * end;
+
+  while (*string == ' ' || *string == '\t')
+  {
+    string++;
+  }
+
+  end = string + strlen(string);
+  while (end > string && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+  {
+    *--end = 0;
+  }
+
+  return string;
+}
+
+static
+bool
+appdb_icon_theme_add_dirs(
+  struct appdb_icon_theme * theme_ptr,
+  const char * list)
+{
+  const char * end;
+  struct appdb_icon_dir * dirs;
+  struct appdb_icon_dir * dir_ptr;
+
+  while (*list != 0)
+  {
+    end = strchr(list, ',');
+    if (end == NULL)
+    {
+      end = list + strlen(list);
+    }
+
+    if (end > list)
+    {
+      dirs = realloc(theme_ptr->dirs, (theme_ptr->dirs_count + 1) * sizeof(struct appdb_icon_dir));
+      if (dirs == NULL)
+      {
+        log_error("realloc() failed");
+        return false;
+      }
+
+      theme_ptr->dirs = dirs;
+      dir_ptr = dirs + theme_ptr->dirs_count;
+
+      dir_ptr->name = strndup(list, end - list);
+      if (dir_ptr->name == NULL)
+      {
+        log_error("strndup() failed");
+        return false;
+      }
+
+      dir_ptr->size = 0;
+      dir_ptr->min_size = -1;
+      dir_ptr->max_size = -1;
+      dir_ptr->threshold = 2;
+      dir_ptr->scale = 1;
+      dir_ptr->type = ICON_DIR_TYPE_THRESHOLD;
+
+      theme_ptr->dirs_count++;
+    }
+
+    list = *end != 0 ? end + 1 : end;
+  }
+
+  return true;
+}
+
+static
+struct appdb_icon_dir *
+appdb_icon_theme_find_dir(
+  struct appdb_icon_theme * theme_ptr,
+  const char * name,
+  size_t name_len)
+{
+  size_t i;
+
+  for (i = 0; i < theme_ptr->dirs_count; i++)
+  {
+    if (strncmp(theme_ptr->dirs[i].name, name, name_len) == 0 && theme_ptr->dirs[i].name[name_len] == 0)
+    {
+      return theme_ptr->dirs + i;
+    }
+  }
+
+  return NULL;
+}
+
+static
+bool
+appdb_icon_theme_parse_index(
+  struct appdb_icon_theme * theme_ptr,
+  const char * path)
+{
+  FILE * file;
+  char * buffer;
+  size_t buffer_size;
+  char * line;
+  char * value;
+  char * end;
+  bool theme_group;
+  struct appdb_icon_dir * dir_ptr;
+  size_t i;
+  bool ret;
+
+  file = fopen(path, "r");
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  buffer = NULL;
+  buffer_size = 0;
+  theme_group = false;
+  dir_ptr = NULL;
+  ret = true;
+
+  while (getline(&buffer, &buffer_size, file) != -1)
+  {
+    line = appdb_icons_strip(buffer);
+    if (*line == 0 || *line == '#')
+    {
+      continue;
+    }
+
+    if (*line == '[')
+    {
+      end = strchr(line, ']');
+      line++;
+      theme_group = end != NULL && strncmp(line, "Icon Theme", end - line) == 0 && end - line == 10;
+      dir_ptr = end != NULL && !theme_group ? appdb_icon_theme_find_dir(theme_ptr, line, end - line) : NULL;
+      continue;
+    }
+
+    value = strchr(line, '=');
+    if (value == NULL)
+    {
+      continue;
+    }
+
+    *value++ = 0;
+    line = appdb_icons_strip(line);
+    value = appdb_icons_strip(value);
+
+    if (theme_group)
+    {
+      if (strcmp(line, "Directories") == 0 || strcmp(line, "ScaledDirectories") == 0)
+      {
+        if (!appdb_icon_theme_add_dirs(theme_ptr, value))
+        {
+          ret = false;
+          break;
+        }
+      }
+      else if (strcmp(line, "Inherits") == 0 && theme_ptr->inherits == NULL)
+      {
+        theme_ptr->inherits = strdup(value);
+      }
+    }
+    else if (dir_ptr != NULL)
+    {
+      if (strcmp(line, "Size") == 0)
+      {
+        dir_ptr->size = atoi(value);
+      }
+      else if (strcmp(line, "MinSize") == 0)
+      {
+        dir_ptr->min_size = atoi(value);
+      }
+      else if (strcmp(line, "MaxSize") == 0)
+      {
+        dir_ptr->max_size = atoi(value);
+      }
+      else if (strcmp(line, "Threshold") == 0)
+      {
+        dir_ptr->threshold = atoi(value);
+      }
+      else if (strcmp(line, "Scale") == 0)
+      {
+        dir_ptr->scale = atoi(value);
+      }
+      else if (strcmp(line, "Type") == 0)
+      {
+        if (strcmp(value, "Fixed") == 0)
+        {
+          dir_ptr->type = ICON_DIR_TYPE_FIXED;
+        }
+        else if (strcmp(value, "Scalable") == 0)
+        {
+          dir_ptr->type = ICON_DIR_TYPE_SCALABLE;
+        }
+        else
+        {
+          dir_ptr->type = ICON_DIR_TYPE_THRESHOLD;
+        }
+      }
+    }
+  }
+
+  free(buffer);
+  fclose(file);
+
+  for (i = 0; i < theme_ptr->dirs_count; i++)
+  {
+    if (theme_ptr->dirs[i].min_size == -1)
+    {
+      theme_ptr->dirs[i].min_size = theme_ptr->dirs[i].size;
+    }
+
+    if (theme_ptr->dirs[i].max_size == -1)
+    {
+      theme_ptr->dirs[i].max_size = theme_ptr->dirs[i].size;
+    }
+  }
+
+  return ret;
+}
+
+static
+uint32_t
+appdb_icon_cache_get32(
+  const struct appdb_icon_theme_location * location_ptr,
+  size_t offset,
+  bool * ok_ptr)
+{
+  const unsigned char * p;
+
+  if (offset + 4 > location_ptr->cache_size)
+  {
+    *ok_ptr = false;
+    return 0;
+  }
+
+  p = location_ptr->cache + offset;
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static
+uint16_t
+appdb_icon_cache_get16(
+  const struct appdb_icon_theme_location * location_ptr,
+  size_t offset,
+  bool * ok_ptr)
+{
+  const unsigned char * p;
+
+  if (offset + 2 > location_ptr->cache_size)
+  {
+    *ok_ptr = false;
+    return 0;
+  }
+
+  p = location_ptr->cache + offset;
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/* string at offset, NULL if it is not terminated within the cache */
+static
+const char *
+appdb_icon_cache_string(
+  const struct appdb_icon_theme_location * location_ptr,
+  size_t offset)
+{
+  if (offset >= location_ptr->cache_size ||
+      memchr(location_ptr->cache + offset, 0, location_ptr->cache_size - offset) == NULL)
+  {
+    return NULL;
+  }
+
+  return (const char *)location_ptr->cache + offset;
+}
+
+/* same hash function as the one used by gtk-update-icon-cache */
+static
+uint32_t
+appdb_icon_cache_hash(
+  const char * key)
+{
+  const signed char * p;
+  uint32_t h;
+
+  p = (const signed char *)key;
+  h = *p;
+
+  if (h != 0)
+  {
+    for (p++; *p != 0; p++)
+    {
+      h = (h << 5) - h + *p;
+    }
+  }
+
+  return h;
+}
+
+/* mmap icon-theme.cache of a theme location, if it is up to date, and map its directories to the theme ones */
+static
+void
+appdb_icon_location_open_cache(
+  struct appdb_icon_theme * theme_ptr,
+  struct appdb_icon_theme_location * location_ptr)
+{
+  char * path;
+  int fd;
+  struct stat st;
+  void * map;
+  uint32_t dirs_offset;
+  uint32_t i;
+  const char * dir_name;
+  struct appdb_icon_dir * dir_ptr;
+  bool ok;
+
+  path = catdup(location_ptr->path, "/icon-theme.cache");
+  if (path == NULL)
+  {
+    return;
+  }
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+  {
+    goto free_path;
+  }
+
+  if (fstat(fd, &st) != 0 || st.st_size < 12)
+  {
+    goto close;
+  }
+
+  /* same staleness check as gtk does */
+  if (st.st_mtime < location_ptr->mtime)
+  {
+    log_debug("'%s' is older than the theme directory, not using it", path);
+    goto close;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+  {
+    log_error("mmap('%s') failed", path);
+    goto close;
+  }
+
+  location_ptr->cache = map;
+  location_ptr->cache_size = st.st_size;
+
+  ok = true;
+  if (appdb_icon_cache_get16(location_ptr, 0, &ok) != 1)
+  {
+    log_error("'%s' has unsupported version", path);
+    goto unmap;
+  }
+
+  dirs_offset = appdb_icon_cache_get32(location_ptr, 8, &ok);
+  location_ptr->cache_dirs_count = appdb_icon_cache_get32(location_ptr, dirs_offset, &ok);
+  if (!ok || location_ptr->cache_dirs_count > location_ptr->cache_size / 4)
+  {
+    log_error("'%s' is corrupt", path);
+    goto unmap;
+  }
+
+  location_ptr->cache_dirs = malloc(location_ptr->cache_dirs_count * sizeof(int) + 1);
+  if (location_ptr->cache_dirs == NULL)
+  {
+    log_error("malloc() failed");
+    goto unmap;
+  }
+
+  for (i = 0; i < location_ptr->cache_dirs_count; i++)
+  {
+    dir_name = appdb_icon_cache_string(
+      location_ptr,
+      appdb_icon_cache_get32(location_ptr, (size_t)dirs_offset + 4 + 4 * (size_t)i, &ok));
+    dir_ptr = ok && dir_name != NULL ? appdb_icon_theme_find_dir(theme_ptr, dir_name, strlen(dir_name)) : NULL;
+    location_ptr->cache_dirs[i] = dir_ptr != NULL ? (int)(dir_ptr - theme_ptr->dirs) : -1;
+  }
+
+  if (!ok)
+  {
+    log_error("'%s' is corrupt", path);
+    free(location_ptr->cache_dirs);
+    location_ptr->cache_dirs = NULL;
+    goto unmap;
+  }
+
+  log_debug("Using '%s'", path);
+  goto close;
+
+unmap:
+  munmap(map, st.st_size);
+  location_ptr->cache = NULL;
+  location_ptr->cache_size = 0;
+close:
+  close(fd);
+free_path:
+  free(path);
+}
+
+static
+bool
+appdb_icon_index_add(
+  struct appdb_hash * index,
+  const char * name,
+  unsigned int dir,
+  unsigned int suffix)
+{
+  struct appdb_icon_images * images_ptr;
+  struct appdb_icon_images * new_images_ptr;
+  size_t i;
+
+  images_ptr = appdb_hash_get(index, name);
+  if (images_ptr != NULL)
+  {
+    for (i = 0; i < images_ptr->count; i++)
+    {
+      if (images_ptr->images[i].dir == dir)
+      {
+        images_ptr->images[i].suffixes |= suffix;
+        return true;
+      }
+    }
+  }
+
+  i = images_ptr != NULL ? images_ptr->count : 0;
+
+  new_images_ptr = malloc(sizeof(struct appdb_icon_images) + (i + 1) * sizeof(struct appdb_icon_image));
+  if (new_images_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  if (images_ptr != NULL)
+  {
+    memcpy(new_images_ptr->images, images_ptr->images, i * sizeof(struct appdb_icon_image));
+  }
+
+  new_images_ptr->count = i + 1;
+  new_images_ptr->images[i].dir = dir;
+  new_images_ptr->images[i].suffixes = suffix;
+
+  /* frees the old value */
+  if (!appdb_hash_set(index, name, new_images_ptr))
+  {
+    free(new_images_ptr);
+    return false;
+  }
+
+  return true;
+}
+
+/* there is no usable icon-theme.cache, so read the theme directories */
+static
+bool
+appdb_icon_location_build_index(
+  struct appdb_icon_theme * theme_ptr,
+  struct appdb_icon_theme_location * location_ptr)
+{
+  size_t i;
+  char * path;
+  DIR * dir;
+  struct dirent * dentry_ptr;
+  char * suffix;
+  unsigned int suffix_flag;
+
+  location_ptr->index = appdb_hash_new(free);
+  if (location_ptr->index == NULL)
+  {
+    return false;
+  }
+
+  for (i = 0; i < theme_ptr->dirs_count; i++)
+  {
+    path = catdup3(location_ptr->path, "/", theme_ptr->dirs[i].name);
+    if (path == NULL)
+    {
+      return false;
+    }
+
+    dir = opendir(path);
+    if (dir == NULL)
+    {
+      free(path);
+      continue;
+    }
+
+    appdb_icons_watch(path);
+
+    while ((dentry_ptr = readdir(dir)) != NULL)
+    {
+      suffix = strrchr(dentry_ptr->d_name, '.');
+      if (suffix == NULL || suffix == dentry_ptr->d_name)
+      {
+        continue;
+      }
+
+      if (strcmp(suffix, ".png") == 0)
+      {
+        suffix_flag = ICON_SUFFIX_PNG;
+      }
+      else if (strcmp(suffix, ".svg") == 0)
+      {
+        suffix_flag = ICON_SUFFIX_SVG;
+      }
+      else if (strcmp(suffix, ".xpm") == 0)
+      {
+        suffix_flag = ICON_SUFFIX_XPM;
+      }
+      else
+      {
+        continue;
+      }
+
+      *suffix = 0;
+      if (!appdb_icon_index_add(location_ptr->index, dentry_ptr->d_name, i, suffix_flag))
+      {
+        closedir(dir);
+        free(path);
+        return false;
+      }
+    }
+
+    closedir(dir);
+    free(path);
+  }
+
+  log_debug("Indexed %zu icons in '%s'", appdb_hash_count(location_ptr->index), location_ptr->path);
+
+  return true;
+}
+
+static
+struct appdb_icon_theme *
+appdb_icon_theme_load(
+  const char * name)
+{
+  struct appdb_icon_theme * theme_ptr;
+  struct appdb_icon_theme_location * location_ptr;
+  char ** base_dir_ptr;
+  char * path;
+  char * index_path;
+  struct stat st;
+  bool index_found;
+  size_t count;
+  size_t i;
+
+  theme_ptr = calloc(1, sizeof(struct appdb_icon_theme));
+  if (theme_ptr == NULL)
+  {
+    log_error("calloc() failed");
+    return NULL;
+  }
+
+  theme_ptr->name = strdup(name);
+  if (theme_ptr->name == NULL)
+  {
+    log_error("strdup() failed");
+    goto fail;
+  }
+
+  for (count = 0; g_icon_base_dirs[count] != NULL; count++);
+
+  theme_ptr->locations = calloc(count, sizeof(struct appdb_icon_theme_location));
+  if (theme_ptr->locations == NULL)
+  {
+    log_error("calloc() failed");
+    goto fail;
+  }
+
+  index_found = false;
+
+  for (base_dir_ptr = g_icon_base_dirs; *base_dir_ptr != NULL; base_dir_ptr++)
+  {
+    path = catdup3(*base_dir_ptr, "/", name);
+    if (path == NULL)
+    {
+      goto fail;
+    }
+
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+      free(path);
+      continue;
+    }
+
+    /* the first index.theme found defines the theme */
+    if (!index_found)
+    {
+      index_path = catdup(path, "/index.theme");
+      if (index_path == NULL)
+      {
+        free(path);
+        goto fail;
+      }
+
+      index_found = appdb_icon_theme_parse_index(theme_ptr, index_path);
+      free(index_path);
+    }
+
+    location_ptr = theme_ptr->locations + theme_ptr->locations_count++;
+    location_ptr->path = path;
+    location_ptr->mtime = st.st_mtime;
+    appdb_icons_watch(path);
+  }
+
+  if (!index_found)
+  {
+    log_debug("Icon theme '%s' not found", name);
+  }
+
+  for (i = 0; i < theme_ptr->locations_count; i++)
+  {
+    location_ptr = theme_ptr->locations + i;
+
+    appdb_icon_location_open_cache(theme_ptr, location_ptr);
+    if (location_ptr->cache == NULL && !appdb_icon_location_build_index(theme_ptr, location_ptr))
+    {
+      goto fail;
+    }
+  }
+
+  list_add_tail(&theme_ptr->siblings, &g_icon_themes);
+
+  return theme_ptr;
+
+fail:
+  appdb_icon_theme_destroy(theme_ptr);
+  return NULL;
+}
+
+static
+struct appdb_icon_theme *
+appdb_icon_theme_get(
+  const char * name)
+{
+  struct list_head * node_ptr;
+  struct appdb_icon_theme * theme_ptr;
+
+  list_for_each(node_ptr, &g_icon_themes)
+  {
+    theme_ptr = list_entry(node_ptr, struct appdb_icon_theme, siblings);
+    if (strcmp(theme_ptr->name, name) == 0)
+    {
+      return theme_ptr;
+    }
+  }
+
+  return appdb_icon_theme_load(name);
+}
+
+static
+size_t
+appdb_icon_location_lookup(
+  const struct appdb_icon_theme_location * location_ptr,
+  const char * name,
+  struct appdb_icon_image * images)
+{
+  const struct appdb_icon_images * images_ptr;
+  uint32_t hash_offset;
+  uint32_t buckets;
+  uint32_t icon_offset;
+  uint32_t list_offset;
+  uint32_t count;
+  uint32_t i;
+  unsigned int dir;
+  const char * icon_name;
+  size_t found;
+  bool ok;
+
+  if (location_ptr->cache == NULL)
+  {
+    images_ptr = appdb_hash_get(location_ptr->index, name);
+    if (images_ptr == NULL)
+    {
+      return 0;
+    }
+
+    found = images_ptr->count < ICON_MAX_IMAGES ? images_ptr->count : ICON_MAX_IMAGES;
+    memcpy(images, images_ptr->images, found * sizeof(struct appdb_icon_image));
+    return found;
+  }
+
+  ok = true;
+  hash_offset = appdb_icon_cache_get32(location_ptr, 4, &ok);
+  buckets = appdb_icon_cache_get32(location_ptr, hash_offset, &ok);
+  if (!ok || buckets == 0)
+  {
+    return 0;
+  }
+
+  icon_offset = appdb_icon_cache_get32(
+    location_ptr,
+    (size_t)hash_offset + 4 + 4 * (size_t)(appdb_icon_cache_hash(name) % buckets),
+    &ok);
+
+  found = 0;
+
+  /* chain_offset of 0xFFFFFFFF terminates the chain; limit iterations in case the cache is corrupt */
+  for (i = 0; ok && icon_offset != 0xFFFFFFFF && i < location_ptr->cache_size / 12; i++)
+  {
+    icon_name = appdb_icon_cache_string(location_ptr, appdb_icon_cache_get32(location_ptr, (size_t)icon_offset + 4, &ok));
+    if (icon_name != NULL && strcmp(icon_name, name) == 0)
+    {
+      list_offset = appdb_icon_cache_get32(location_ptr, (size_t)icon_offset + 8, &ok);
+      count = appdb_icon_cache_get32(location_ptr, list_offset, &ok);
+
+      for (i = 0; ok && i < count && found < ICON_MAX_IMAGES; i++)
+      {
+        dir = appdb_icon_cache_get16(location_ptr, (size_t)list_offset + 4 + 8 * (size_t)i, &ok);
+        if (dir < location_ptr->cache_dirs_count && location_ptr->cache_dirs[dir] != -1)
+        {
+          images[found].dir = location_ptr->cache_dirs[dir];
+          images[found].suffixes =
+            appdb_icon_cache_get16(location_ptr, (size_t)list_offset + 4 + 8 * (size_t)i + 2, &ok) &
+            (ICON_SUFFIX_PNG | ICON_SUFFIX_SVG | ICON_SUFFIX_XPM);
+          if (images[found].suffixes != 0)
+          {
+            found++;
+          }
+        }
+      }
+
+      break;
+    }
+
+    icon_offset = appdb_icon_cache_get32(location_ptr, icon_offset, &ok);
+  }
+
+  return ok ? found : 0;
+}
+
+static
+bool
+appdb_icon_dir_matches_size(
+  const struct appdb_icon_dir * dir_ptr,
+  int size)
+{
+  if (dir_ptr->scale != 1)
+  {
+    return false;
+  }
+
+  switch (dir_ptr->type)
+  {
+  case ICON_DIR_TYPE_FIXED:
+    return dir_ptr->size == size;
+  case ICON_DIR_TYPE_SCALABLE:
+    return dir_ptr->min_size <= size && size <= dir_ptr->max_size;
+  default:
+    return dir_ptr->size - dir_ptr->threshold <= size && size <= dir_ptr->size + dir_ptr->threshold;
+  }
+}
+
+static
+int
+appdb_icon_dir_size_distance(
+  const struct appdb_icon_dir * dir_ptr,
+  int size)
+{
+  int min;
+  int max;
+
+  switch (dir_ptr->type)
+  {
+  case ICON_DIR_TYPE_FIXED:
+    min = max = dir_ptr->size;
+    break;
+  case ICON_DIR_TYPE_SCALABLE:
+    min = dir_ptr->min_size;
+    max = dir_ptr->max_size;
+    break;
+  default:
+    min = dir_ptr->size - dir_ptr->threshold;
+    max = dir_ptr->size + dir_ptr->threshold;
+  }
+
+  min *= dir_ptr->scale;
+  max *= dir_ptr->scale;
+
+  if (size < min)
+  {
+    return min - size;
+  }
+
+  if (size > max)
+  {
+    return size - max;
+  }
+
+  return 0;
+}
+
+static
+const char *
+appdb_icon_suffix(
+  unsigned int suffixes)
+{
+  if ((suffixes & ICON_SUFFIX_PNG) != 0)
+  {
+    return ".png";
+  }
+
+  if ((suffixes & ICON_SUFFIX_SVG) != 0)
+  {
+    return ".svg";
+  }
+
+  return ".xpm";
+}
+
+static
+char *
+appdb_icon_theme_lookup(
+  struct appdb_icon_theme * theme_ptr,
+  const char * name,
+  int size)
+{
+  struct appdb_icon_image images[ICON_MAX_IMAGES];
+  const struct appdb_icon_theme_location * location_ptr;
+  const struct appdb_icon_dir * dir_ptr;
+  char * best_path;
+  char * path;
+  int best_distance;
+  int distance;
+  size_t count;
+  size_t i;
+  size_t j;
+
+  best_distance = INT_MAX;
+  best_path = NULL;
+
+  for (i = 0; i < theme_ptr->locations_count; i++)
+  {
+    location_ptr = theme_ptr->locations + i;
+
+    count = appdb_icon_location_lookup(location_ptr, name, images);
+    for (j = 0; j < count; j++)
+    {
+      dir_ptr = theme_ptr->dirs + images[j].dir;
+
+      if (appdb_icon_dir_matches_size(dir_ptr, size))
+      {
+        free(best_path);
+        return catdupv(location_ptr->path, "/", dir_ptr->name, "/", name, appdb_icon_suffix(images[j].suffixes), NULL);
+      }
+
+      distance = appdb_icon_dir_size_distance(dir_ptr, size);
+      if (distance < best_distance)
+      {
+        path = catdupv(location_ptr->path, "/", dir_ptr->name, "/", name, appdb_icon_suffix(images[j].suffixes), NULL);
+        if (path != NULL)
+        {
+          free(best_path);
+          best_path = path;
+          best_distance = distance;
+        }
+      }
+    }
+  }
+
+  return best_path;
+}
+
+/* depth first walk of the theme and its parents, as FindIconHelper() of the specification does */
+static
+char *
+appdb_icon_lookup_in_themes(
+  const char * theme_name,
+  const char * name,
+  int size,
+  const char ** visited,
+  size_t * visited_count_ptr)
+{
+  struct appdb_icon_theme * theme_ptr;
+  const char * parent;
+  const char * end;
+  char * parent_name;
+  char * path;
+  size_t i;
+
+  for (i = 0; i < *visited_count_ptr; i++)
+  {
+    if (strcmp(visited[i], theme_name) == 0)
+    {
+      return NULL;
+    }
+  }
+
+  if (*visited_count_ptr == ICON_MAX_THEMES)
+  {
+    return NULL;
+  }
+
+  theme_ptr = appdb_icon_theme_get(theme_name);
+  if (theme_ptr == NULL)
+  {
+    return NULL;
+  }
+
+  visited[(*visited_count_ptr)++] = theme_ptr->name;
+
+  path = appdb_icon_theme_lookup(theme_ptr, name, size);
+  if (path != NULL || theme_ptr->inherits == NULL)
+  {
+    return path;
+  }
+
+  for (parent = theme_ptr->inherits; *parent != 0; parent = *end != 0 ? end + 1 : end)
+  {
+    end = strchr(parent, ',');
+    if (end == NULL)
+    {
+      end = parent + strlen(parent);
+    }
+
+    if (end == parent)
+    {
+      continue;
+    }
+
+    parent_name = strndup(parent, end - parent);
+    if (parent_name == NULL)
+    {
+      log_error("strndup() failed");
+      return NULL;
+    }
+
+    path = appdb_icon_lookup_in_themes(parent_name, name, size, visited, visited_count_ptr);
+    free(parent_name);
+    if (path != NULL)
+    {
+      return path;
+    }
+  }
+
+  return NULL;
+}
+
+static
+char *
+appdb_icon_lookup(
+  const char * icon,
+  unsigned int size)
+{
+  static const char * suffixes[] = {".png", ".svg", ".xpm", NULL};
+  const char * visited[ICON_MAX_THEMES];
+  size_t visited_count;
+  const char * theme;
+  const char ** suffix_ptr;
+  char ** base_dir_ptr;
+  char * name;
+  char * suffix;
+  char * path;
+
+  if (*icon == '/')
+  {
+    return access(icon, R_OK) == 0 ? strdup(icon) : NULL;
+  }
+
+  /* some desktop files have the suffix in the Icon value, which is not allowed by the specification */
+  name = strdup(icon);
+  if (name == NULL)
+  {
+    log_error("strdup() failed");
+    return NULL;
+  }
+
+  suffix = strrchr(name, '.');
+  if (suffix != NULL && (strcmp(suffix, ".png") == 0 || strcmp(suffix, ".svg") == 0 || strcmp(suffix, ".xpm") == 0))
+  {
+    *suffix = 0;
+  }
+
+  theme = getenv("APPDB_ICON_THEME");
+  if (theme == NULL || *theme == 0)
+  {
+    theme = "hicolor";
+  }
+
+  visited_count = 0;
+
+  path = appdb_icon_lookup_in_themes(theme, name, size, visited, &visited_count);
+  if (path == NULL)
+  {
+    path = appdb_icon_lookup_in_themes("hicolor", name, size, visited, &visited_count);
+  }
+
+  /* unthemed icons directly in the base directories, /usr/share/pixmaps is one of them */
+  for (base_dir_ptr = g_icon_base_dirs; path == NULL && *base_dir_ptr != NULL; base_dir_ptr++)
+  {
+    for (suffix_ptr = suffixes; *suffix_ptr != NULL; suffix_ptr++)
+    {
+      path = catdup4(*base_dir_ptr, "/", name, *suffix_ptr);
+      if (path == NULL || access(path, R_OK) == 0)
+      {
+        break;
+      }
+
+      free(path);
+      path = NULL;
+    }
+  }
+
+  free(name);
+
+  return path;
+}
+
+const char *
+appdb_icons_resolve(
+  const char * name,
+  unsigned int size)
+{
+  char key[16];
+  char * cache_key;
+  char * path;
+  char ** base_dir_ptr;
+
+  if (g_icons_dirty)
+  {
+    appdb_icons_flush();
+  }
+
+  if (!g_icons_base_dirs_watched)
+  {
+    for (base_dir_ptr = g_icon_base_dirs; *base_dir_ptr != NULL; base_dir_ptr++)
+    {
+      appdb_icons_watch(*base_dir_ptr);
+    }
+
+    g_icons_base_dirs_watched = true;
+  }
+
+  snprintf(key, sizeof(key), "%u/", size);
+
+  cache_key = catdup(key, name);
+  if (cache_key == NULL)
+  {
+    return NULL;
+  }
+
+  path = appdb_hash_get(g_icon_cache, cache_key);
+  if (path == NULL)
+  {
+    path = appdb_icon_lookup(name, size);
+    log_debug("Icon '%s' of size %u resolved to '%s'", name, size, path != NULL ? path : "");
+
+    if (path == NULL)
+    {
+      path = strdup("");
+    }
+
+    if (appdb_hash_count(g_icon_cache) >= ICON_CACHE_LIMIT)
+    {
+      appdb_hash_clear(g_icon_cache);
+    }
+
+    if (path != NULL && !appdb_hash_set(g_icon_cache, cache_key, path))
+    {
+      free(path);
+      path = NULL;
+    }
+  }
+
+  free(cache_key);
+
+  return path != NULL && *path != 0 ? path : NULL;
+}
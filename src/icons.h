@@ -0,0 +1,29 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *****************************************************
+ * This file contains interface to the icon resolver *
+ *****************************************************/
+
+#ifndef ICONS_H__E4B27A90_6C1F_4D85_B3A9_0F7D2C8E5146__INCLUDED
+#define ICONS_H__E4B27A90_6C1F_4D85_B3A9_0F7D2C8E5146__INCLUDED
+
+#include "common.h"
+
+bool appdb_icons_init(void);
+void appdb_icons_uninit(void);
+
+/* Resolve icon name (as in the Icon key) to a file, according to the Icon Theme Specification.
+ * Theme is taken from the APPDB_ICON_THEME environment variable, hicolor is used as fallback.
+ * Returns NULL if icon is not found. Returned string is owned by the resolver cache
+ * and stays valid until next call of appdb_watcher_dispatch(). */
+const char *
+appdb_icons_resolve(
+  const char * name,
+  unsigned int size);
+
+#endif /* #ifndef ICONS_H__E4B27A90_6C1F_4D85_B3A9_0F7D2C8E5146__INCLUDED */
@@ -13,6 +13,8 @@
 #include "config.h"
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -35,6 +37,135 @@
 #define APPDB_XDG_SUBDIR "/" BASE_NAME
 #define APPDB_XDG_LOG "/" BASE_NAME ".log"
 
+#define LOG_MASK_FROM(level) (~((1U << (level)) - 1))
+
+/* everything except debug messages, unless changed through APPDB_LOG or D-Bus */
+unsigned int g_appdb_log_masks[LOG_SUBSYSTEM_COUNT] =
+{
+  [LOG_SUBSYSTEM_CORE]    = LOG_MASK_FROM(LOG_LEVEL_INFO),
+  [LOG_SUBSYSTEM_LOADER]  = LOG_MASK_FROM(LOG_LEVEL_INFO),
+  [LOG_SUBSYSTEM_PARSER]  = LOG_MASK_FROM(LOG_LEVEL_INFO),
+  [LOG_SUBSYSTEM_DBUS]    = LOG_MASK_FROM(LOG_LEVEL_INFO),
+  [LOG_SUBSYSTEM_WATCHER] = LOG_MASK_FROM(LOG_LEVEL_INFO),
+};
+
+static const char * g_appdb_log_subsystem_names[LOG_SUBSYSTEM_COUNT] =
+{
+  [LOG_SUBSYSTEM_CORE]    = "core",
+  [LOG_SUBSYSTEM_LOADER]  = "loader",
+  [LOG_SUBSYSTEM_PARSER]  = "parser",
+  [LOG_SUBSYSTEM_DBUS]    = "dbus",
+  [LOG_SUBSYSTEM_WATCHER] = "watcher",
+};
+
+static const char * g_appdb_log_level_names[] =
+{
+  [LOG_LEVEL_DEBUG] = "debug",
+  [LOG_LEVEL_INFO]  = "info",
+  [LOG_LEVEL_WARN]  = "warn",
+  [LOG_LEVEL_ERROR] = "error",
+};
+
+bool
+appdb_log_set_level(
+  const char * subsystem,
+  const char * level)
+{
+  unsigned int subsystem_index;
+  unsigned int level_index;
+  bool all;
+
+  for (level_index = 0; level_index < sizeof(g_appdb_log_level_names) / sizeof(g_appdb_log_level_names[0]); level_index++)
+  {
+    if (strcmp(g_appdb_log_level_names[level_index], level) == 0)
+    {
+      break;
+    }
+  }
+
+  if (level_index == sizeof(g_appdb_log_level_names) / sizeof(g_appdb_log_level_names[0]))
+  {
+    return false;
+  }
+
+  all = strcmp(subsystem, "all") == 0;
+
+  for (subsystem_index = 0; subsystem_index < LOG_SUBSYSTEM_COUNT; subsystem_index++)
+  {
+    if (all || strcmp(g_appdb_log_subsystem_names[subsystem_index], subsystem) == 0)
+    {
+      __atomic_store_n(&g_appdb_log_masks[subsystem_index], LOG_MASK_FROM(level_index), __ATOMIC_RELAXED);
+      if (!all)
+      {
+        return true;
+      }
+    }
+  }
+
+  return all;
+}
+
+bool
+appdb_log_configure(
+  const char * spec)
+{
+  char * buffer;
+  char * item;
+  char * next;
+  char * level;
+  bool ret;
+
+  buffer = strdup(spec);
+  if (buffer == NULL)
+  {
+    return false;
+  }
+
+  ret = true;
+
+  for (item = buffer; item != NULL; item = next)
+  {
+    next = strchr(item, ',');
+    if (next != NULL)
+    {
+      *next++ = 0;
+    }
+
+    if (*item == 0)
+    {
+      continue;
+    }
+
+    level = strchr(item, '=');
+    if (level != NULL)
+    {
+      *level++ = 0;
+    }
+
+    if (!appdb_log_set_level(level != NULL ? item : "all", level != NULL ? level : item))
+    {
+      ret = false;
+    }
+  }
+
+  free(buffer);
+
+  return ret;
+}
+
+static
+void
+appdb_log_configure_from_env(void)
+{
+  const char * spec;
+
+  spec = getenv("APPDB_LOG");
+  if (spec != NULL && !appdb_log_configure(spec))
+  {
+    log_warn("Ignoring unknown subsystem or level in APPDB_LOG='%s'", spec);
+  }
+}
+
 #if !defined(LOG_OUTPUT_STDOUT)
 static ino_t g_log_file_ino;
 static FILE * g_logfile;
@@ -129,6 +260,7 @@ void appdb_log_init()
   }
 
   appdb_log_open();
+  appdb_log_configure_from_env();
   //cdbus_log_setup(appdb_log);
 
 free_log_dir:
@@ -155,6 +287,7 @@ void appdb_log_uninit()
 void appdb_log_init() __attribute__ ((constructor));
 void appdb_log_init()
 {
+  appdb_log_configure_from_env();
   //cdbus_log_setup(appdb_log);
 }
 #endif  /* #if !defined(LOG_OUTPUT_STDOUT) */
@@ -167,17 +300,6 @@ void appdb_log_init()
 # define log_error_plain(fmt, args...) appdb_log(LOG_LEVEL_ERROR_PLAIN, ANSI_COLOR_RED "ERROR: " ANSI_RESET fmt "\n", ## args)
 #endif
 
-static
-bool
-appdb_log_enabled(
-  unsigned int level,
-  const char * UNUSED(file),
-  unsigned int UNUSED(line),
-  const char * UNUSED(func))
-{
-  return level != LOG_LEVEL_DEBUG;
-}
-
 void
 appdb_log(
   unsigned int level,
@@ -195,11 +317,6 @@ appdb_log(
 #endif
   const char * color;
 
-  if (!appdb_log_enabled(level, file, line, func))
-  {
-    return;
-  }
-
 #if !defined(LOG_OUTPUT_STDOUT)
   if (g_logfile != NULL && appdb_log_open())
   {
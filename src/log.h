@@ -14,6 +14,8 @@
 
 #include "config.h"
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C"
 #endif
@@ -36,15 +38,61 @@ appdb_log(
 #define LOG_LEVEL_ERROR        3
 #define LOG_LEVEL_ERROR_PLAIN  4
 
+#define LOG_SUBSYSTEM_CORE     0
+#define LOG_SUBSYSTEM_LOADER   1
+#define LOG_SUBSYSTEM_PARSER   2
+#define LOG_SUBSYSTEM_DBUS     3
+#define LOG_SUBSYSTEM_WATCHER  4
+#define LOG_SUBSYSTEM_COUNT    5
+
+/* Bitmask of enabled levels (bit N is LOG_LEVEL N), one per subsystem.
+ * Checked inline by the log macros, so disabled messages cost a load
+ * and a test, without a call and without evaluating the arguments.
+ * Threads log while the main loop changes the levels, so the masks are
+ * accessed with relaxed atomics. */
+extern unsigned int g_appdb_log_masks[LOG_SUBSYSTEM_COUNT];
+
+/* Set minimum level for a subsystem ("loader", "parser", ...) or for all of them ("all").
+ * Level is one of "debug", "info", "warn", "error".
+ * Returns false if subsystem or level name is not known. */
+bool
+appdb_log_set_level(
+  const char * subsystem,
+  const char * level);
+
+/* Apply comma separated list of "subsystem=level" items, as in the APPDB_LOG environment variable.
+ * Item without '=' sets the level of all subsystems. */
+bool
+appdb_log_configure(
+  const char * spec);
+
+/* Source files log as LOG_SUBSYSTEM_CORE unless they define LOG_SUBSYSTEM before including this header */
+#if !defined(LOG_SUBSYSTEM)
+# define LOG_SUBSYSTEM LOG_SUBSYSTEM_CORE
+#endif
+
+#define log_enabled(subsystem, level) \
+  ((__atomic_load_n(&g_appdb_log_masks[subsystem], __ATOMIC_RELAXED) & (1U << (level))) != 0)
+
+#define log_subsystem(subsystem, level, fmt, args...)                       \
+  do                                                                        \
+  {                                                                         \
+    if (log_enabled(subsystem, level))                                      \
+    {                                                                       \
+      appdb_log(level, __FILE__, __LINE__, __FUNCTION__, fmt, ## args);     \
+    }                                                                       \
+  }                                                                         \
+  while (false)
+
 #define log_debug(fmt, args...)       \
-  appdb_log(LOG_LEVEL_DEBUG,       __FILE__, __LINE__, __FUNCTION__, fmt, ## args)
+  log_subsystem(LOG_SUBSYSTEM, LOG_LEVEL_DEBUG,       fmt, ## args)
 #define log_info(fmt, args...)        \
-  appdb_log(LOG_LEVEL_INFO,        __FILE__, __LINE__, __FUNCTION__, fmt, ## args)
+  log_subsystem(LOG_SUBSYSTEM, LOG_LEVEL_INFO,        fmt, ## args)
 #define log_warn(fmt, args...)        \
-  appdb_log(LOG_LEVEL_WARN,        __FILE__, __LINE__, __FUNCTION__, fmt, ## args)
+  log_subsystem(LOG_SUBSYSTEM, LOG_LEVEL_WARN,        fmt, ## args)
 #define log_error(fmt, args...)       \
-  appdb_log(LOG_LEVEL_ERROR,       __FILE__, __LINE__, __FUNCTION__, fmt, ## args)
+  log_subsystem(LOG_SUBSYSTEM, LOG_LEVEL_ERROR,       fmt, ## args)
 #define log_error_plain(fmt, args...) \
-  appdb_log(LOG_LEVEL_ERROR_PLAIN, __FILE__, __LINE__, __FUNCTION__, fmt, ## args)
+  log_subsystem(LOG_SUBSYSTEM, LOG_LEVEL_ERROR_PLAIN, fmt, ## args)
 
 #endif /* #ifndef LOG_H__8338C154_E498_4F4F_A357_44C15EBEE750__INCLUDED */
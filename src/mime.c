@@ -0,0 +1,551 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ************************************************************
+ * This file contains implementation of the MIME type index *
+ ************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "common.h"
+#include "appdb/appdb.h"
+#include "hash.h"
+#include "strlist.h"
+#include "xdg.h"
+#include "catdup.h"
+
+#define MIME_GROUP_CACHE    "MIME Cache"
+#define MIME_GROUP_DEFAULT  "Default Applications"
+#define MIME_GROUP_ADDED    "Added Associations"
+#define MIME_GROUP_REMOVED  "Removed Associations"
+
+/* value of the handlers hash */
+struct appdb_mime_handlers
+{
+  size_t count;
+  size_t size;
+  struct appdb_entry ** entries;
+};
+
+struct appdb_mime_index
+{
+  struct appdb_hash * handlers;   /* MIME type -> struct appdb_mime_handlers */
+};
+
+/* state used only while the index is built */
+struct appdb_mime_build
+{
+  struct appdb_mime_index * index_ptr;
+  struct appdb_hash * ids;        /* desktop file ID -> struct appdb_entry, not owned */
+  struct appdb_hash * defaults;   /* MIME type -> ";" separated desktop file IDs, from all mimeapps.list files */
+  struct appdb_hash * added;      /* same, for the added associations */
+  struct appdb_hash * removed;    /* same, for the removed associations */
+  bool ok;
+};
+
+typedef void (* appdb_mime_key_callback)(struct appdb_mime_build * build_ptr, const char * group, const char * key, const char * value);
+
+static
+void
+appdb_mime_handlers_free(
+  void * value)
+{
+  struct appdb_mime_handlers * handlers_ptr;
+
+  handlers_ptr = value;
+  free(handlers_ptr->entries);
+  free(handlers_ptr);
+}
+
+static
+bool
+appdb_mime_is_removed(
+  struct appdb_mime_build * build_ptr,
+  const char * mime_type,
+  const char * desktop_id)
+{
+  const char * removed;
+  char ** list;
+  bool ret;
+
+  removed = appdb_hash_get(build_ptr->removed, mime_type);
+  if (removed == NULL)
+  {
+    return false;
+  }
+
+  list = appdb_strlist_split(removed);
+  if (list == NULL)
+  {
+    return false;
+  }
+
+  ret = appdb_strlist_contains(list, desktop_id);
+  free(list);
+  return ret;
+}
+
+/* appends entry to the handlers of the MIME type, unless it is already there */
+static
+bool
+appdb_mime_add_handler(
+  struct appdb_mime_index * index_ptr,
+  const char * mime_type,
+  struct appdb_entry * entry_ptr)
+{
+  struct appdb_mime_handlers * handlers_ptr;
+  struct appdb_entry ** entries;
+  size_t i;
+
+  handlers_ptr = appdb_hash_get(index_ptr->handlers, mime_type);
+  if (handlers_ptr == NULL)
+  {
+    handlers_ptr = calloc(1, sizeof(struct appdb_mime_handlers));
+    if (handlers_ptr == NULL)
+    {
+      log_error("calloc() failed");
+      return false;
+    }
+
+    if (!appdb_hash_set(index_ptr->handlers, mime_type, handlers_ptr))
+    {
+      free(handlers_ptr);
+      return false;
+    }
+  }
+
+  for (i = 0; i < handlers_ptr->count; i++)
+  {
+    if (handlers_ptr->entries[i] == entry_ptr)
+    {
+      return true;
+    }
+  }
+
+  if (handlers_ptr->count == handlers_ptr->size)
+  {
+    entries = realloc(handlers_ptr->entries, (handlers_ptr->size + 4) * sizeof(struct appdb_entry *));
+    if (entries == NULL)
+    {
+      log_error("realloc() failed");
+      return false;
+    }
+
+    handlers_ptr->entries = entries;
+    handlers_ptr->size += 4;
+  }
+
+  handlers_ptr->entries[handlers_ptr->count++] = entry_ptr;
+  return true;
+}
+
+/* ids is ";" separated list of desktop file IDs, IDs of not loaded entries are ignored */
+static
+void
+appdb_mime_add_ids(
+  struct appdb_mime_build * build_ptr,
+  const char * mime_type,
+  const char * ids,
+  bool check_removed)
+{
+  char ** list;
+  char ** id_ptr;
+  struct appdb_entry * entry_ptr;
+
+  list = appdb_strlist_split(ids);
+  if (list == NULL)
+  {
+    build_ptr->ok = false;
+    return;
+  }
+
+  for (id_ptr = list; *id_ptr != NULL; id_ptr++)
+  {
+    entry_ptr = appdb_hash_get(build_ptr->ids, *id_ptr);
+    if (entry_ptr == NULL)
+    {
+      log_debug("Ignoring association of '%s' with not installed '%s'", mime_type, *id_ptr);
+      continue;
+    }
+
+    if (check_removed && appdb_mime_is_removed(build_ptr, mime_type, *id_ptr))
+    {
+      continue;
+    }
+
+    if (!appdb_mime_add_handler(build_ptr->index_ptr, mime_type, entry_ptr))
+    {
+      build_ptr->ok = false;
+      break;
+    }
+  }
+
+  free(list);
+}
+
+/* append ids to the ";" separated list that is value of the hash */
+static
+void
+appdb_mime_append_ids(
+  struct appdb_mime_build * build_ptr,
+  struct appdb_hash * hash_ptr,
+  const char * mime_type,
+  const char * ids)
+{
+  const char * old;
+  char * value;
+
+  old = appdb_hash_get(hash_ptr, mime_type);
+  value = old == NULL ? strdup(ids) : catdup3(old, ";", ids);
+  if (value == NULL)
+  {
+    log_error("strdup() failed");
+    build_ptr->ok = false;
+    return;
+  }
+
+  if (!appdb_hash_set(hash_ptr, mime_type, value))
+  {
+    free(value);
+    build_ptr->ok = false;
+  }
+}
+
+static
+void
+appdb_mime_apps_key(
+  struct appdb_mime_build * build_ptr,
+  const char * group,
+  const char * key,
+  const char * value)
+{
+  if (strcmp(group, MIME_GROUP_DEFAULT) == 0)
+  {
+    appdb_mime_append_ids(build_ptr, build_ptr->defaults, key, value);
+  }
+  else if (strcmp(group, MIME_GROUP_ADDED) == 0)
+  {
+    appdb_mime_append_ids(build_ptr, build_ptr->added, key, value);
+  }
+  else if (strcmp(group, MIME_GROUP_REMOVED) == 0)
+  {
+    appdb_mime_append_ids(build_ptr, build_ptr->removed, key, value);
+  }
+}
+
+static
+void
+appdb_mime_cache_key(
+  struct appdb_mime_build * build_ptr,
+  const char * group,
+  const char * key,
+  const char * value)
+{
+  if (strcmp(group, MIME_GROUP_CACHE) == 0)
+  {
+    appdb_mime_add_ids(build_ptr, key, value, true);
+  }
+}
+
+/* read keys of all groups in a file, like mimeapps.list; not existing file is not an error */
+static
+void
+appdb_mime_read_file(
+  struct appdb_mime_build * build_ptr,
+  const char * path,
+  appdb_mime_key_callback callback)
+{
+  FILE * file;
+  char * line;
+  size_t line_size;
+  ssize_t len;
+  char * group;
+  char * value;
+  char * key_end;
+
+  file = fopen(path, "re");
+  if (file == NULL)
+  {
+    return;
+  }
+
+  log_debug("Reading '%s'", path);
+
+  line = NULL;
+  line_size = 0;
+  group = NULL;
+
+  while ((len = getline(&line, &line_size, file)) != -1)
+  {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' '))
+    {
+      line[--len] = 0;
+    }
+
+    if (len == 0 || line[0] == '#')
+    {
+      continue;
+    }
+
+    if (line[0] == '[' && line[len - 1] == ']')
+    {
+      free(group);
+      group = strndup(line + 1, len - 2);
+      if (group == NULL)
+      {
+        log_error("strndup() failed");
+        build_ptr->ok = false;
+        break;
+      }
+
+      continue;
+    }
+
+    value = strchr(line, '=');
+    if (group == NULL || value == NULL)
+    {
+      continue;
+    }
+
+    for (key_end = value; key_end > line && (key_end[-1] == ' ' || key_end[-1] == '\t'); key_end--);
+    *key_end = 0;
+
+    value++;
+    while (*value == ' ' || *value == '\t')
+    {
+      value++;
+    }
+
+    callback(build_ptr, group, line, value);
+  }
+
+  free(group);
+  free(line);
+  fclose(file);
+}
+
+static
+void
+appdb_mime_add_defaults(
+  void * ctx,
+  const char * key,
+  void * value)
+{
+  appdb_mime_add_ids(ctx, key, value, false);
+}
+
+static
+void
+appdb_mime_add_added(
+  void * ctx,
+  const char * key,
+  void * value)
+{
+  appdb_mime_add_ids(ctx, key, value, true);
+}
+
+static
+bool
+appdb_mime_read_files(
+  struct appdb_mime_build * build_ptr,
+  char ** dirs,
+  const char * name,
+  appdb_mime_key_callback callback)
+{
+  char ** dir_ptr;
+  char * path;
+
+  for (dir_ptr = dirs; *dir_ptr != NULL; dir_ptr++)
+  {
+    path = catdup(*dir_ptr, name);
+    if (path == NULL)
+    {
+      log_error("catdup() failed");
+      return false;
+    }
+
+    appdb_mime_read_file(build_ptr, path, callback);
+    free(path);
+  }
+
+  return build_ptr->ok;
+}
+
+struct appdb_mime_index *
+appdb_mime_index_new(
+  struct list_head * appdb)
+{
+  struct appdb_mime_build build;
+  struct list_head * node_ptr;
+  struct appdb_entry * entry_ptr;
+  char ** config_dirs;
+  char ** data_dirs;
+  char ** mime_type_ptr;
+
+  memset(&build, 0, sizeof(build));
+  build.ok = false;
+  config_dirs = NULL;
+  data_dirs = NULL;
+
+  build.index_ptr = malloc(sizeof(struct appdb_mime_index));
+  if (build.index_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    return NULL;
+  }
+
+  build.index_ptr->handlers = appdb_hash_new(appdb_mime_handlers_free);
+  build.ids = appdb_hash_new(NULL);
+  build.defaults = appdb_hash_new(free);
+  build.added = appdb_hash_new(free);
+  build.removed = appdb_hash_new(free);
+  if (build.index_ptr->handlers == NULL ||
+      build.ids == NULL ||
+      build.defaults == NULL ||
+      build.added == NULL ||
+      build.removed == NULL)
+  {
+    goto exit;
+  }
+
+  /* first entry with an ID wins, the list is in order of XDG directory precedence */
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    if (appdb_hash_get(build.ids, entry_ptr->desktop_id) == NULL &&
+        !appdb_hash_set(build.ids, entry_ptr->desktop_id, entry_ptr))
+    {
+      goto exit;
+    }
+  }
+
+  config_dirs = appdb_xdg_config_dirs("");
+  data_dirs = appdb_xdg_data_dirs("/applications");
+  if (config_dirs == NULL || data_dirs == NULL)
+  {
+    goto exit;
+  }
+
+  build.ok = true;
+
+  /* mimeapps.list files, user configuration first */
+  if (!appdb_mime_read_files(&build, config_dirs, "/mimeapps.list", appdb_mime_apps_key) ||
+      !appdb_mime_read_files(&build, data_dirs, "/mimeapps.list", appdb_mime_apps_key))
+  {
+    goto fail;
+  }
+
+  /* preference order: default applications, added associations, */
+  /* mimeinfo.cache files, MimeType keys of entries that are not in the caches */
+  appdb_hash_foreach(build.defaults, appdb_mime_add_defaults, &build);
+  appdb_hash_foreach(build.added, appdb_mime_add_added, &build);
+
+  if (!build.ok ||
+      !appdb_mime_read_files(&build, data_dirs, "/mimeinfo.cache", appdb_mime_cache_key))
+  {
+    goto fail;
+  }
+
+  list_for_each(node_ptr, appdb)
+  {
+    entry_ptr = list_entry(node_ptr, struct appdb_entry, siblings);
+
+    if (entry_ptr->mime_types == NULL)
+    {
+      continue;
+    }
+
+    for (mime_type_ptr = entry_ptr->mime_types; *mime_type_ptr != NULL; mime_type_ptr++)
+    {
+      if (!appdb_mime_is_removed(&build, *mime_type_ptr, entry_ptr->desktop_id) &&
+          !appdb_mime_add_handler(build.index_ptr, *mime_type_ptr, entry_ptr))
+      {
+        goto fail;
+      }
+    }
+  }
+
+  log_info("%zu MIME types in the index", appdb_hash_count(build.index_ptr->handlers));
+  goto exit;
+
+fail:
+  build.ok = false;
+
+exit:
+  appdb_xdg_dirs_free(config_dirs);
+  appdb_xdg_dirs_free(data_dirs);
+
+  appdb_hash_destroy(build.ids);
+  appdb_hash_destroy(build.defaults);
+  appdb_hash_destroy(build.added);
+  appdb_hash_destroy(build.removed);
+
+  if (!build.ok)
+  {
+    appdb_hash_destroy(build.index_ptr->handlers);
+    free(build.index_ptr);
+    return NULL;
+  }
+
+  return build.index_ptr;
+}
+
+void
+appdb_mime_index_destroy(
+  struct appdb_mime_index * index_ptr)
+{
+  if (index_ptr == NULL)
+  {
+    return;
+  }
+
+  appdb_hash_destroy(index_ptr->handlers);
+  free(index_ptr);
+}
+
+static
+size_t
+appdb_mime_handlers_memory(
+  void * value)
+{
+  struct appdb_mime_handlers * handlers_ptr;
+
+  handlers_ptr = value;
+  return malloc_usable_size(handlers_ptr) + malloc_usable_size(handlers_ptr->entries);
+}
+
+size_t
+appdb_mime_index_memory(
+  struct appdb_mime_index * index_ptr)
+{
+  return malloc_usable_size(index_ptr) + appdb_hash_memory(index_ptr->handlers, appdb_mime_handlers_memory);
+}
+
+struct appdb_entry * const *
+appdb_mime_index_lookup(
+  struct appdb_mime_index * index_ptr,
+  const char * mime_type,
+  size_t * count_ptr)
+{
+  struct appdb_mime_handlers * handlers_ptr;
+
+  handlers_ptr = appdb_hash_get(index_ptr->handlers, mime_type);
+  if (handlers_ptr == NULL)
+  {
+    *count_ptr = 0;
+    return NULL;
+  }
+
+  *count_ptr = handlers_ptr->count;
+  return handlers_ptr->entries;
+}
@@ -0,0 +1,260 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ****************************************************************
+ * This file contains implementation of the executable resolver *
+ ****************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "path.h"
+#include "hash.h"
+#include "watcher.h"
+
+#define PATH_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* one component of $PATH */
+struct appdb_path_dir
+{
+  char * path;
+  struct appdb_hash * names;    /* names of files in the directory, NULL when listing has to be (re)read */
+  int watch;                    /* -1 when directory is not watched (does not exist) */
+};
+
+static struct appdb_path_dir * g_path_dirs;
+static size_t g_path_dirs_count;
+static unsigned int g_path_generation;
+
+static
+void
+appdb_path_watch_callback(
+  void * ctx,
+  const char * UNUSED(path),
+  const char * UNUSED(name),
+  uint32_t mask)
+{
+  struct appdb_path_dir * dir_ptr;
+
+  dir_ptr = ctx;
+
+  if (dir_ptr->names != NULL)
+  {
+    appdb_hash_destroy(dir_ptr->names);
+    dir_ptr->names = NULL;
+  }
+
+  if ((mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0 && dir_ptr->watch != -1)
+  {
+    appdb_watcher_remove(dir_ptr->watch);
+    dir_ptr->watch = -1;
+  }
+
+  g_path_generation++;
+}
+
+static
+bool
+appdb_path_dir_read(
+  struct appdb_path_dir * dir_ptr)
+{
+  DIR * dir;
+  struct dirent * dentry_ptr;
+
+  dir_ptr->names = appdb_hash_new(NULL);
+  if (dir_ptr->names == NULL)
+  {
+    return false;
+  }
+
+  /* watch before reading, so changes during the read are not lost */
+  if (dir_ptr->watch == -1)
+  {
+    dir_ptr->watch = appdb_watcher_add(dir_ptr->path, PATH_WATCH_MASK, appdb_path_watch_callback, dir_ptr);
+  }
+
+  dir = opendir(dir_ptr->path);
+  if (dir == NULL)
+  {
+    /* not existing directory is cached as empty */
+    log_debug("failed to open PATH directory '%s'", dir_ptr->path);
+    return true;
+  }
+
+  while ((dentry_ptr = readdir(dir)) != NULL)
+  {
+    if (dentry_ptr->d_type == DT_DIR || dentry_ptr->d_name[0] == '.')
+    {
+      continue;
+    }
+
+    /* the value is not used, only presence of the key */
+    if (!appdb_hash_set(dir_ptr->names, dentry_ptr->d_name, dir_ptr))
+    {
+      closedir(dir);
+      appdb_hash_destroy(dir_ptr->names);
+      dir_ptr->names = NULL;
+      return false;
+    }
+  }
+
+  closedir(dir);
+
+  log_debug("%zu files in PATH directory '%s'", appdb_hash_count(dir_ptr->names), dir_ptr->path);
+
+  return true;
+}
+
+bool appdb_path_init(void)
+{
+  const char * path;
+  const char * end;
+  size_t count;
+  size_t i;
+
+  path = getenv("PATH");
+  if (path == NULL || *path == 0)
+  {
+    path = "/usr/local/bin:/usr/bin:/bin";
+  }
+
+  count = 1;
+  for (end = path; *end != 0; end++)
+  {
+    if (*end == ':')
+    {
+      count++;
+    }
+  }
+
+  g_path_dirs = calloc(count, sizeof(struct appdb_path_dir));
+  if (g_path_dirs == NULL)
+  {
+    log_error("calloc() failed");
+    return false;
+  }
+
+  g_path_dirs_count = 0;
+
+  for (; *path != 0; path = *end != 0 ? end + 1 : end)
+  {
+    end = strchr(path, ':');
+    if (end == NULL)
+    {
+      end = path + strlen(path);
+    }
+
+    /* relative components, including the empty one meaning current directory, are not used */
+    if (*path != '/')
+    {
+      continue;
+    }
+
+    for (i = 0; i < g_path_dirs_count; i++)
+    {
+      if (strlen(g_path_dirs[i].path) == (size_t)(end - path) &&
+          memcmp(g_path_dirs[i].path, path, end - path) == 0)
+      {
+        break;
+      }
+    }
+
+    if (i < g_path_dirs_count)
+    {
+      continue;
+    }
+
+    g_path_dirs[g_path_dirs_count].path = strndup(path, end - path);
+    if (g_path_dirs[g_path_dirs_count].path == NULL)
+    {
+      log_error("strndup() failed");
+      appdb_path_uninit();
+      return false;
+    }
+
+    g_path_dirs[g_path_dirs_count].names = NULL;
+    g_path_dirs[g_path_dirs_count].watch = -1;
+    g_path_dirs_count++;
+  }
+
+  return true;
+}
+
+void appdb_path_uninit(void)
+{
+  size_t i;
+
+  for (i = 0; i < g_path_dirs_count; i++)
+  {
+    if (g_path_dirs[i].watch != -1)
+    {
+      appdb_watcher_remove(g_path_dirs[i].watch);
+    }
+
+    appdb_hash_destroy(g_path_dirs[i].names);
+    free(g_path_dirs[i].path);
+  }
+
+  free(g_path_dirs);
+  g_path_dirs = NULL;
+  g_path_dirs_count = 0;
+}
+
+bool appdb_path_exists(const char * name)
+{
+  size_t i;
+
+  if (*name == '/')
+  {
+    return access(name, X_OK) == 0;
+  }
+
+  for (i = 0; i < g_path_dirs_count; i++)
+  {
+    if (g_path_dirs[i].names == NULL && !appdb_path_dir_read(g_path_dirs + i))
+    {
+      continue;
+    }
+
+    if (appdb_hash_get(g_path_dirs[i].names, name) != NULL)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+unsigned int appdb_path_generation(void)
+{
+  return g_path_generation;
+}
+
+size_t appdb_path_memory(void)
+{
+  size_t size;
+  size_t i;
+
+  size = malloc_usable_size(g_path_dirs);
+
+  for (i = 0; i < g_path_dirs_count; i++)
+  {
+    size += malloc_usable_size(g_path_dirs[i].path);
+
+    if (g_path_dirs[i].names != NULL)
+    {
+      size += appdb_hash_memory(g_path_dirs[i].names, NULL);
+    }
+  }
+
+  return size;
+}
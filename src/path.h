@@ -0,0 +1,30 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ***********************************************************
+ * This file contains interface to the executable resolver *
+ ***********************************************************/
+
+#ifndef PATH_H__5B1E7C38_D94A_4E26_8F0B_A3C6E2D15F97__INCLUDED
+#define PATH_H__5B1E7C38_D94A_4E26_8F0B_A3C6E2D15F97__INCLUDED
+
+#include "common.h"
+
+bool appdb_path_init(void);
+void appdb_path_uninit(void);
+
+/* Check whether executable exists, as TryExec requires. Absolute paths are checked
+ * with access(), other names are looked up in cached listings of the $PATH directories. */
+bool appdb_path_exists(const char * name);
+
+/* incremented when contents of a $PATH directory change */
+unsigned int appdb_path_generation(void);
+
+/* heap bytes used by the cached listings */
+size_t appdb_path_memory(void);
+
+#endif /* #ifndef PATH_H__5B1E7C38_D94A_4E26_8F0B_A3C6E2D15F97__INCLUDED */
@@ -0,0 +1,49 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *********************************************
+ * This file contains the static tracepoints *
+ *********************************************/
+
+#ifndef PROBES_H__1E6C9A42_B3D8_4F17_A0E5_7C29D4B861F3__INCLUDED
+#define PROBES_H__1E6C9A42_B3D8_4F17_A0E5_7C29D4B861F3__INCLUDED
+
+/* SystemTap SDT probes of the "appdb" provider, for perf, bpftrace and SystemTap.
+ * When not traced, a probe is a nop instruction, with arguments in registers
+ * or memory that are available anyway. Without sys/sdt.h, probes are compiled out.
+ *
+ * load__start(flags, reload)                       scan of the applications directories
+ * load__done(result)
+ * load__dir__start(path)
+ * load__dir__done(path, result)
+ * load__file(path, size, result)                   size is -1 if the file can't be read
+ * parse__error(path, reason)
+ * dedupe__content(path, original_path)             file is a copy of already loaded one
+ * dedupe__name(path, name)                         entry is shadowed by one with same name
+ * dbus__method(sender, interface, member, serial)  method call is being dispatched
+ */
+
+#if defined(HAVE_SYS_SDT_H)
+
+#include <sys/sdt.h>
+
+#define APPDB_PROBE1(name, a1) DTRACE_PROBE1(appdb, name, a1)
+#define APPDB_PROBE2(name, a1, a2) DTRACE_PROBE2(appdb, name, a1, a2)
+#define APPDB_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(appdb, name, a1, a2, a3)
+#define APPDB_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(appdb, name, a1, a2, a3, a4)
+
+#else
+
+/* arguments are referenced so they are not reported as unused */
+#define APPDB_PROBE1(name, a1) do { (void)(a1); } while (0)
+#define APPDB_PROBE2(name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define APPDB_PROBE3(name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#define APPDB_PROBE4(name, a1, a2, a3, a4) do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); } while (0)
+
+#endif
+
+#endif /* #ifndef PROBES_H__1E6C9A42_B3D8_4F17_A0E5_7C29D4B861F3__INCLUDED */
@@ -0,0 +1,233 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ***************************************************************
+ * This file contains implementation of the query result cache *
+ ***************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_DBUS
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include "qcache.h"
+#include "hash.h"
+#include "db.h"
+
+#define QUERY_CACHE_LIMIT 256
+#define QUERY_CACHE_SIZE_LIMIT (16 * 1024 * 1024)
+
+struct appdb_qcache_node
+{
+  struct list_head siblings;    /* in g_qcache_lru, most recently used first */
+  char * key;
+  void * value;
+  appdb_hash_value_free value_free;
+  size_t size;                  /* of the value */
+};
+
+static pthread_mutex_t g_qcache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct appdb_hash * g_qcache;   /* key -> struct appdb_qcache_node */
+static struct list_head g_qcache_lru;
+static unsigned int g_qcache_generation;
+static uint64_t g_qcache_hits;
+static uint64_t g_qcache_misses;
+static size_t g_qcache_size;            /* sum of sizes of the values */
+
+static void appdb_qcache_node_free(struct appdb_qcache_node * node_ptr)
+{
+  g_qcache_size -= node_ptr->size;
+  list_del(&node_ptr->siblings);
+  free(node_ptr->key);
+  node_ptr->value_free(node_ptr->value);
+  free(node_ptr);
+}
+
+/* nodes are freed through the LRU list, the table does not own them */
+static void appdb_qcache_clear(void)
+{
+  appdb_hash_clear(g_qcache);
+
+  while (!list_empty(&g_qcache_lru))
+  {
+    appdb_qcache_node_free(list_entry(g_qcache_lru.next, struct appdb_qcache_node, siblings));
+  }
+}
+
+/* any reload invalidates all results, entries they reference may be freed */
+static void appdb_qcache_check_generation(void)
+{
+  if (g_qcache_generation != appdb_db_generation())
+  {
+    appdb_qcache_clear();
+    g_qcache_generation = appdb_db_generation();
+  }
+}
+
+bool appdb_qcache_init(void)
+{
+  g_qcache = appdb_hash_new(NULL);
+  if (g_qcache == NULL)
+  {
+    return false;
+  }
+
+  INIT_LIST_HEAD(&g_qcache_lru);
+  g_qcache_generation = appdb_db_generation();
+
+  return true;
+}
+
+void appdb_qcache_uninit(void)
+{
+  appdb_qcache_clear();
+  appdb_hash_destroy(g_qcache);
+  g_qcache = NULL;
+
+  log_info("Query cache: %llu hits, %llu misses", (unsigned long long)g_qcache_hits, (unsigned long long)g_qcache_misses);
+}
+
+void appdb_qcache_lock(void)
+{
+  pthread_mutex_lock(&g_qcache_mutex);
+}
+
+void appdb_qcache_unlock(void)
+{
+  pthread_mutex_unlock(&g_qcache_mutex);
+}
+
+const void * appdb_qcache_get(const char * key)
+{
+  struct appdb_qcache_node * node_ptr;
+
+  appdb_qcache_check_generation();
+
+  node_ptr = appdb_hash_get(g_qcache, key);
+  if (node_ptr == NULL)
+  {
+    g_qcache_misses++;
+    return NULL;
+  }
+
+  g_qcache_hits++;
+
+  list_del(&node_ptr->siblings);
+  list_add(&node_ptr->siblings, &g_qcache_lru);
+
+  return node_ptr->value;
+}
+
+bool appdb_qcache_put(const char * key, void * value)
+{
+  return appdb_qcache_put_object(key, value, free, malloc_usable_size(value));
+}
+
+bool appdb_qcache_put_object(const char * key, void * value, appdb_hash_value_free value_free, size_t size)
+{
+  struct appdb_qcache_node * node_ptr;
+  struct appdb_qcache_node * old_ptr;
+
+  if (size > QUERY_CACHE_SIZE_LIMIT / 4)
+  {
+    log_debug("Result of %zu bytes is too large for the query cache", size);
+    return false;
+  }
+
+  pthread_mutex_lock(&g_qcache_mutex);
+
+  appdb_qcache_check_generation();
+
+  old_ptr = appdb_hash_get(g_qcache, key);
+  if (old_ptr != NULL)
+  {
+    appdb_hash_remove(g_qcache, old_ptr->key);
+    appdb_qcache_node_free(old_ptr);
+  }
+
+  while (!list_empty(&g_qcache_lru) &&
+         (appdb_hash_count(g_qcache) >= QUERY_CACHE_LIMIT || g_qcache_size + size > QUERY_CACHE_SIZE_LIMIT))
+  {
+    old_ptr = list_entry(g_qcache_lru.prev, struct appdb_qcache_node, siblings);
+    appdb_hash_remove(g_qcache, old_ptr->key);
+    appdb_qcache_node_free(old_ptr);
+  }
+
+  node_ptr = malloc(sizeof(struct appdb_qcache_node));
+  if (node_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    goto fail;
+  }
+
+  node_ptr->key = strdup(key);
+  if (node_ptr->key == NULL)
+  {
+    log_error("strdup() failed");
+    goto free_node;
+  }
+
+  if (!appdb_hash_set(g_qcache, key, node_ptr))
+  {
+    goto free_key;
+  }
+
+  node_ptr->value = value;
+  node_ptr->value_free = value_free;
+  node_ptr->size = size;
+  g_qcache_size += size;
+  list_add(&node_ptr->siblings, &g_qcache_lru);
+
+  pthread_mutex_unlock(&g_qcache_mutex);
+
+  return true;
+
+free_key:
+  free(node_ptr->key);
+free_node:
+  free(node_ptr);
+fail:
+  pthread_mutex_unlock(&g_qcache_mutex);
+  return false;
+}
+
+void appdb_qcache_stats(uint64_t * hits_ptr, uint64_t * misses_ptr, size_t * count_ptr)
+{
+  pthread_mutex_lock(&g_qcache_mutex);
+  *hits_ptr = g_qcache_hits;
+  *misses_ptr = g_qcache_misses;
+  *count_ptr = g_qcache != NULL ? appdb_hash_count(g_qcache) : 0;
+  pthread_mutex_unlock(&g_qcache_mutex);
+}
+
+size_t appdb_qcache_memory(void)
+{
+  struct list_head * node_ptr;
+  struct appdb_qcache_node * qnode_ptr;
+  size_t size;
+
+  if (g_qcache == NULL)
+  {
+    return 0;
+  }
+
+  pthread_mutex_lock(&g_qcache_mutex);
+
+  size = appdb_hash_memory(g_qcache, NULL);
+
+  list_for_each(node_ptr, &g_qcache_lru)
+  {
+    qnode_ptr = list_entry(node_ptr, struct appdb_qcache_node, siblings);
+    size += malloc_usable_size(qnode_ptr) + malloc_usable_size(qnode_ptr->key) + qnode_ptr->size;
+  }
+
+  pthread_mutex_unlock(&g_qcache_mutex);
+
+  return size;
+}
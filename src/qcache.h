@@ -0,0 +1,48 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ **********************************************************
+ * This file contains interface to the query result cache *
+ **********************************************************/
+
+#ifndef QCACHE_H__9D4B6E21_7F3A_4C58_A0E2_1B8C5D93F46A__INCLUDED
+#define QCACHE_H__9D4B6E21_7F3A_4C58_A0E2_1B8C5D93F46A__INCLUDED
+
+#include <stdint.h>
+
+#include "common.h"
+#include "hash.h"
+
+/* Results of queries and marshalled replies, keyed by method, arguments and locale, least
+ * recently used are evicted. Results reference entries, so they are valid only for the
+ * generation of the database they were computed for, see appdb_db_generation(). The cache
+ * is used by the main loop and by the workers, its functions lock it themselves, except for
+ * appdb_qcache_get(). */
+
+bool appdb_qcache_init(void);
+void appdb_qcache_uninit(void);
+
+/* the lock must be held while the value returned by appdb_qcache_get() is used, as */
+/* another thread could replace or evict it; it must not be held when calling the other functions */
+void appdb_qcache_lock(void);
+void appdb_qcache_unlock(void);
+
+/* NULL if the result is not cached, or was computed for an older generation of the database */
+const void * appdb_qcache_get(const char * key);
+
+/* value is a single heap block that is freed by the cache; on failure it is still owned by the caller */
+bool appdb_qcache_put(const char * key, void * value);
+
+/* same, for value that is freed with value_free, size is what it is accounted as */
+bool appdb_qcache_put_object(const char * key, void * value, appdb_hash_value_free value_free, size_t size);
+
+void appdb_qcache_stats(uint64_t * hits_ptr, uint64_t * misses_ptr, size_t * count_ptr);
+
+/* heap bytes used by the cache, including the results */
+size_t appdb_qcache_memory(void);
+
+#endif /* #ifndef QCACHE_H__9D4B6E21_7F3A_4C58_A0E2_1B8C5D93F46A__INCLUDED */
@@ -0,0 +1,912 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ***************************************************************
+ * This file contains implementation of the database snapshots *
+ ***************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_LOADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "appdb/appdb.h"
+#include "catdup.h"
+#include "digest.h"
+#include "exec.h"
+#include "xdg.h"
+
+/* Snapshot is the header followed by the payload. Numbers are in host byte order, strings
+ * are uint32_t length followed by that many bytes, SNAPSHOT_NULL length is a NULL string,
+ * lists are uint32_t count, SNAPSHOT_NULL for a NULL list, followed by the strings. Payload
+ * starts with the applications directories, each with fingerprint of its state, and then
+ * come the entries. Snapshot is used only when the directories are same as at the time it
+ * was saved, so it does not need to be invalidated explicitly. */
+
+#define SNAPSHOT_MAGIC "APPDBSN1"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_NULL UINT32_MAX
+
+#define SNAPSHOT_TERMINAL    1
+#define SNAPSHOT_HIDDEN      2
+#define SNAPSHOT_NO_DISPLAY  4
+
+struct appdb_snapshot_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t entries_count;
+  uint64_t size;                /* of the payload */
+  uint64_t checksum;            /* appdb_digest64() of the payload */
+};
+
+struct appdb_snapshot_writer
+{
+  char * data;
+  size_t size;
+  size_t allocated;
+  bool failed;                  /* ran out of memory, rest of the appends are ignored */
+};
+
+struct appdb_snapshot_reader
+{
+  const char * data;
+  const char * end;
+};
+
+/* Fingerprint of an applications directory covers the directory itself, so files that are
+ * added, removed or renamed change it, and each .desktop file the loader reads, so files
+ * that are rewritten in place change it too. Change time is used instead of modification
+ * time, because it is not restored by tools that preserve timestamps. The latest change
+ * time is returned, so files changed during the scan can be detected. */
+static
+uint64_t
+appdb_snapshot_fingerprint(
+  const char * dir_path,
+  time_t * ctime_ptr)
+{
+  struct stat st;
+  DIR * dir;
+  struct dirent * dentry_ptr;
+  uint64_t record[4];
+  uint64_t fingerprint;
+  size_t len;
+
+  *ctime_ptr = 0;
+
+  /* directory that does not exist is same as empty directory for the loader */
+  if (stat(dir_path, &st) != 0)
+  {
+    return 0;
+  }
+
+  record[0] = st.st_dev;
+  record[1] = st.st_ino;
+  record[2] = st.st_ctim.tv_sec;
+  record[3] = st.st_ctim.tv_nsec;
+  fingerprint = appdb_digest64(record, sizeof(record), 0);
+  *ctime_ptr = st.st_ctim.tv_sec;
+
+  dir = opendir(dir_path);
+  if (dir == NULL)
+  {
+    return fingerprint;
+  }
+
+  while ((dentry_ptr = readdir(dir)) != NULL)
+  {
+    /* same files as appdb_load_dir() reads */
+    len = strlen(dentry_ptr->d_name);
+    if (dentry_ptr->d_type != DT_REG || len < 8 || strcmp(dentry_ptr->d_name + len - 8, ".desktop") != 0)
+    {
+      continue;
+    }
+
+    if (fstatat(dirfd(dir), dentry_ptr->d_name, &st, 0) != 0)
+    {
+      continue;
+    }
+
+    record[0] = st.st_ino;
+    record[1] = st.st_size;
+    record[2] = st.st_ctim.tv_sec;
+    record[3] = st.st_ctim.tv_nsec;
+
+    /* sum does not depend on order of readdir() */
+    fingerprint += appdb_digest64(record, sizeof(record), appdb_digest64(dentry_ptr->d_name, len, 0));
+
+    if (st.st_ctim.tv_sec > *ctime_ptr)
+    {
+      *ctime_ptr = st.st_ctim.tv_sec;
+    }
+  }
+
+  closedir(dir);
+
+  return fingerprint;
+}
+
+static
+void
+appdb_snapshot_put(
+  struct appdb_snapshot_writer * writer_ptr,
+  const void * data,
+  size_t size)
+{
+  char * buffer;
+  size_t allocated;
+
+  if (writer_ptr->failed)
+  {
+    return;
+  }
+
+  if (writer_ptr->size + size > writer_ptr->allocated)
+  {
+    allocated = writer_ptr->allocated != 0 ? writer_ptr->allocated * 2 : 65536;
+    while (allocated < writer_ptr->size + size)
+    {
+      allocated *= 2;
+    }
+
+    buffer = realloc(writer_ptr->data, allocated);
+    if (buffer == NULL)
+    {
+      log_error("realloc() failed");
+      writer_ptr->failed = true;
+      return;
+    }
+
+    writer_ptr->data = buffer;
+    writer_ptr->allocated = allocated;
+  }
+
+  memcpy(writer_ptr->data + writer_ptr->size, data, size);
+  writer_ptr->size += size;
+}
+
+static
+void
+appdb_snapshot_put_uint32(
+  struct appdb_snapshot_writer * writer_ptr,
+  uint32_t value)
+{
+  appdb_snapshot_put(writer_ptr, &value, sizeof(value));
+}
+
+static
+void
+appdb_snapshot_put_uint64(
+  struct appdb_snapshot_writer * writer_ptr,
+  uint64_t value)
+{
+  appdb_snapshot_put(writer_ptr, &value, sizeof(value));
+}
+
+static
+void
+appdb_snapshot_put_string(
+  struct appdb_snapshot_writer * writer_ptr,
+  const char * string)
+{
+  uint32_t len;
+
+  if (string == NULL)
+  {
+    appdb_snapshot_put_uint32(writer_ptr, SNAPSHOT_NULL);
+    return;
+  }
+
+  len = strlen(string);
+  appdb_snapshot_put_uint32(writer_ptr, len);
+  appdb_snapshot_put(writer_ptr, string, len);
+}
+
+static
+void
+appdb_snapshot_put_list(
+  struct appdb_snapshot_writer * writer_ptr,
+  char ** list)
+{
+  uint32_t count;
+
+  if (list == NULL)
+  {
+    appdb_snapshot_put_uint32(writer_ptr, SNAPSHOT_NULL);
+    return;
+  }
+
+  for (count = 0; list[count] != NULL; count++);
+
+  appdb_snapshot_put_uint32(writer_ptr, count);
+  while (*list != NULL)
+  {
+    appdb_snapshot_put_string(writer_ptr, *list++);
+  }
+}
+
+static
+void
+appdb_snapshot_put_entry(
+  struct appdb_snapshot_writer * writer_ptr,
+  struct appdb_entry * entry_ptr)
+{
+  unsigned int field;
+  uint32_t flags;
+  size_t i;
+
+  /* fields of lazy loaded entries are read now, snapshot has all of them */
+  for (field = 0; field < APPDB_FIELD_COUNT; field++)
+  {
+    appdb_snapshot_put_string(writer_ptr, appdb_entry_get(entry_ptr, field));
+  }
+
+  appdb_snapshot_put_string(writer_ptr, entry_ptr->file_path);
+  appdb_snapshot_put_string(writer_ptr, entry_ptr->desktop_id);
+  appdb_snapshot_put_string(writer_ptr, entry_ptr->lash_class);
+  appdb_snapshot_put_string(writer_ptr, entry_ptr->nsm_exec);
+  appdb_snapshot_put_list(writer_ptr, entry_ptr->mime_types);
+  appdb_snapshot_put_list(writer_ptr, entry_ptr->categories);
+  appdb_snapshot_put_list(writer_ptr, entry_ptr->only_show_in);
+  appdb_snapshot_put_list(writer_ptr, entry_ptr->not_show_in);
+
+  flags = 0;
+  flags |= entry_ptr->terminal ? SNAPSHOT_TERMINAL : 0;
+  flags |= entry_ptr->hidden ? SNAPSHOT_HIDDEN : 0;
+  flags |= entry_ptr->no_display ? SNAPSHOT_NO_DISPLAY : 0;
+  appdb_snapshot_put_uint32(writer_ptr, flags);
+  appdb_snapshot_put_uint32(writer_ptr, entry_ptr->session_protocols);
+  appdb_snapshot_put_uint64(writer_ptr, entry_ptr->content_hash);
+
+  appdb_snapshot_put_uint32(writer_ptr, entry_ptr->actions_count);
+  for (i = 0; i < entry_ptr->actions_count; i++)
+  {
+    appdb_snapshot_put_string(writer_ptr, entry_ptr->actions[i].id);
+    appdb_snapshot_put_string(writer_ptr, entry_ptr->actions[i].name);
+    appdb_snapshot_put_string(writer_ptr, entry_ptr->actions[i].icon);
+    appdb_snapshot_put_string(writer_ptr, entry_ptr->actions[i].exec);
+  }
+}
+
+static
+bool
+appdb_snapshot_write_file(
+  const char * path,
+  const struct appdb_snapshot_header * header_ptr,
+  const struct appdb_snapshot_writer * writer_ptr)
+{
+  char * tmp_path;
+  int fd;
+  const char * data;
+  size_t size;
+  ssize_t ret;
+
+  /* readers see either the old snapshot or the new one, never a partially written one */
+  tmp_path = catdup(path, ".tmp");
+  if (tmp_path == NULL)
+  {
+    log_error("catdup() failed to compose the temporary snapshot path");
+    return false;
+  }
+
+  fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd == -1)
+  {
+    log_error("Failed to create '%s': %s", tmp_path, strerror(errno));
+    goto free_path;
+  }
+
+  if (write(fd, header_ptr, sizeof(struct appdb_snapshot_header)) != sizeof(struct appdb_snapshot_header))
+  {
+    goto write_failed;
+  }
+
+  data = writer_ptr->data;
+  size = writer_ptr->size;
+  while (size > 0)
+  {
+    ret = write(fd, data, size);
+    if (ret <= 0)
+    {
+      goto write_failed;
+    }
+
+    data += ret;
+    size -= ret;
+  }
+
+  if (close(fd) != 0)
+  {
+    fd = -1;
+    goto write_failed;
+  }
+
+  if (rename(tmp_path, path) != 0)
+  {
+    log_error("Failed to rename '%s' to '%s': %s", tmp_path, path, strerror(errno));
+    unlink(tmp_path);
+    goto free_path;
+  }
+
+  free(tmp_path);
+  return true;
+
+write_failed:
+  log_error("Failed to write '%s': %s", tmp_path, strerror(errno));
+  if (fd != -1)
+  {
+    close(fd);
+  }
+
+  unlink(tmp_path);
+free_path:
+  free(tmp_path);
+  return false;
+}
+
+bool
+appdb_snapshot_save(
+  struct list_head * appdb,
+  time_t scan_time,
+  const char * path)
+{
+  struct appdb_snapshot_writer writer;
+  struct appdb_snapshot_header header;
+  struct list_head * node_ptr;
+  char ** dirs;
+  size_t count;
+  size_t i;
+  uint64_t fingerprint;
+  time_t ctime;
+  bool ret;
+
+  ret = false;
+  memset(&writer, 0, sizeof(writer));
+
+  dirs = appdb_xdg_data_dirs("/applications");
+  if (dirs == NULL)
+  {
+    return false;
+  }
+
+  for (count = 0; dirs[count] != NULL; count++);
+
+  appdb_snapshot_put_uint32(&writer, count);
+  for (i = 0; i < count; i++)
+  {
+    fingerprint = appdb_snapshot_fingerprint(dirs[i], &ctime);
+
+    /* change in the second of the scan could be after the file was read, */
+    /* and timestamps of the filesystem can be coarser than the clock */
+    if (ctime >= scan_time - 1)
+    {
+      log_info("'%s' changed since the scan, snapshot is not saved", dirs[i]);
+      goto exit;
+    }
+
+    appdb_snapshot_put_string(&writer, dirs[i]);
+    appdb_snapshot_put_uint64(&writer, fingerprint);
+  }
+
+  count = 0;
+  list_for_each(node_ptr, appdb)
+  {
+    appdb_snapshot_put_entry(&writer, list_entry(node_ptr, struct appdb_entry, siblings));
+    count++;
+  }
+
+  if (writer.failed)
+  {
+    goto exit;
+  }
+
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.entries_count = count;
+  header.size = writer.size;
+  header.checksum = appdb_digest64(writer.data, writer.size, 0);
+
+  ret = appdb_snapshot_write_file(path, &header, &writer);
+  if (ret)
+  {
+    log_info("Saved snapshot of %zu entries to '%s'", count, path);
+  }
+
+exit:
+  free(writer.data);
+  appdb_xdg_dirs_free(dirs);
+  return ret;
+}
+
+static
+bool
+appdb_snapshot_get(
+  struct appdb_snapshot_reader * reader_ptr,
+  void * value_ptr,
+  size_t size)
+{
+  if ((size_t)(reader_ptr->end - reader_ptr->data) < size)
+  {
+    return false;
+  }
+
+  memcpy(value_ptr, reader_ptr->data, size);
+  reader_ptr->data += size;
+
+  return true;
+}
+
+/* string is not copied, *string_ptr points into the snapshot and is not zero terminated */
+static
+bool
+appdb_snapshot_get_string(
+  struct appdb_snapshot_reader * reader_ptr,
+  const char ** string_ptr,
+  uint32_t * len_ptr)
+{
+  if (!appdb_snapshot_get(reader_ptr, len_ptr, sizeof(uint32_t)))
+  {
+    return false;
+  }
+
+  if (*len_ptr == SNAPSHOT_NULL)
+  {
+    *string_ptr = NULL;
+    return true;
+  }
+
+  if ((size_t)(reader_ptr->end - reader_ptr->data) < *len_ptr)
+  {
+    return false;
+  }
+
+  *string_ptr = reader_ptr->data;
+  reader_ptr->data += *len_ptr;
+
+  return true;
+}
+
+/* allocate zero terminated copy of the string, NULL strings stay NULL */
+static
+bool
+appdb_snapshot_get_string_copy(
+  struct appdb_snapshot_reader * reader_ptr,
+  char ** copy_ptr)
+{
+  const char * string;
+  uint32_t len;
+
+  if (!appdb_snapshot_get_string(reader_ptr, &string, &len))
+  {
+    return false;
+  }
+
+  if (string == NULL)
+  {
+    *copy_ptr = NULL;
+    return true;
+  }
+
+  *copy_ptr = malloc(len + 1);
+  if (*copy_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  memcpy(*copy_ptr, string, len);
+  (*copy_ptr)[len] = 0;
+
+  return true;
+}
+
+/* the pointer array and the strings are allocated as one block, as appdb_strlist_split() does */
+static
+bool
+appdb_snapshot_get_list(
+  struct appdb_snapshot_reader * reader_ptr,
+  char *** list_ptr)
+{
+  struct appdb_snapshot_reader strings;
+  const char * string;
+  uint32_t len;
+  uint32_t count;
+  uint32_t i;
+  size_t size;
+  char ** list;
+  char * dst;
+
+  if (!appdb_snapshot_get(reader_ptr, &count, sizeof(uint32_t)))
+  {
+    return false;
+  }
+
+  if (count == SNAPSHOT_NULL)
+  {
+    *list_ptr = NULL;
+    return true;
+  }
+
+  /* first pass calculates the size */
+  strings = *reader_ptr;
+  size = (count + 1) * sizeof(char *);
+  for (i = 0; i < count; i++)
+  {
+    if (!appdb_snapshot_get_string(reader_ptr, &string, &len) || string == NULL)
+    {
+      return false;
+    }
+
+    size += len + 1;
+  }
+
+  list = malloc(size);
+  if (list == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  /* second pass fills the block */
+  dst = (char *)(list + count + 1);
+  for (i = 0; i < count; i++)
+  {
+    appdb_snapshot_get_string(&strings, &string, &len);
+    list[i] = dst;
+    memcpy(dst, string, len);
+    dst[len] = 0;
+    dst += len + 1;
+  }
+
+  list[count] = NULL;
+  *list_ptr = list;
+
+  return true;
+}
+
+static
+char *
+appdb_snapshot_copy_action_string(
+  char ** dst_ptr_ptr,
+  const char * value,
+  uint32_t len)
+{
+  char * copy;
+
+  if (value == NULL)
+  {
+    return NULL;
+  }
+
+  copy = *dst_ptr_ptr;
+  memcpy(copy, value, len);
+  copy[len] = 0;
+  *dst_ptr_ptr += len + 1;
+
+  return copy;
+}
+
+/* the array and the strings are allocated as one block, as appdb_load_actions() does */
+static
+bool
+appdb_snapshot_get_actions(
+  struct appdb_snapshot_reader * reader_ptr,
+  struct appdb_entry * entry_ptr)
+{
+  struct appdb_snapshot_reader strings;
+  const char * string[4];
+  uint32_t len[4];
+  uint32_t count;
+  uint32_t i;
+  unsigned int j;
+  size_t size;
+  char * dst;
+
+  if (!appdb_snapshot_get(reader_ptr, &count, sizeof(uint32_t)))
+  {
+    return false;
+  }
+
+  if (count == 0)
+  {
+    return true;
+  }
+
+  /* first pass calculates the size */
+  strings = *reader_ptr;
+  size = count * sizeof(struct appdb_action);
+  for (i = 0; i < count; i++)
+  {
+    for (j = 0; j < 4; j++)
+    {
+      if (!appdb_snapshot_get_string(reader_ptr, &string[j], &len[j]))
+      {
+        return false;
+      }
+
+      size += string[j] != NULL ? len[j] + 1 : 0;
+    }
+
+    /* id and name are always present */
+    if (string[0] == NULL || string[1] == NULL)
+    {
+      return false;
+    }
+  }
+
+  entry_ptr->actions = malloc(size);
+  if (entry_ptr->actions == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  /* second pass fills the block */
+  dst = (char *)(entry_ptr->actions + count);
+  for (i = 0; i < count; i++)
+  {
+    for (j = 0; j < 4; j++)
+    {
+      appdb_snapshot_get_string(&strings, &string[j], &len[j]);
+    }
+
+    entry_ptr->actions[i].id = appdb_snapshot_copy_action_string(&dst, string[0], len[0]);
+    entry_ptr->actions[i].name = appdb_snapshot_copy_action_string(&dst, string[1], len[1]);
+    entry_ptr->actions[i].icon = appdb_snapshot_copy_action_string(&dst, string[2], len[2]);
+    entry_ptr->actions[i].exec = appdb_snapshot_copy_action_string(&dst, string[3], len[3]);
+  }
+
+  entry_ptr->actions_count = count;
+
+  return true;
+}
+
+/* entry is added to the list before it is read, so on failure the partially read entry is freed with the list */
+static
+bool
+appdb_snapshot_get_entry(
+  struct appdb_snapshot_reader * reader_ptr,
+  struct list_head * appdb)
+{
+  struct appdb_entry * entry_ptr;
+  uint32_t flags;
+  uint32_t session_protocols;
+
+  entry_ptr = calloc(1, sizeof(struct appdb_entry));
+  if (entry_ptr == NULL)
+  {
+    log_error("calloc() failed");
+    return false;
+  }
+
+  list_add_tail(&entry_ptr->siblings, appdb);
+
+  /* in APPDB_FIELD_xxx order */
+  if (!appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->name) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->generic_name) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->comment) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->icon) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->exec) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->path) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->try_exec))
+  {
+    return false;
+  }
+
+  if (!appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->file_path) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->desktop_id) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->lash_class) ||
+      !appdb_snapshot_get_string_copy(reader_ptr, &entry_ptr->nsm_exec) ||
+      !appdb_snapshot_get_list(reader_ptr, &entry_ptr->mime_types) ||
+      !appdb_snapshot_get_list(reader_ptr, &entry_ptr->categories) ||
+      !appdb_snapshot_get_list(reader_ptr, &entry_ptr->only_show_in) ||
+      !appdb_snapshot_get_list(reader_ptr, &entry_ptr->not_show_in))
+  {
+    return false;
+  }
+
+  if (entry_ptr->name == NULL || entry_ptr->file_path == NULL || entry_ptr->desktop_id == NULL)
+  {
+    return false;
+  }
+
+  if (!appdb_snapshot_get(reader_ptr, &flags, sizeof(uint32_t)) ||
+      !appdb_snapshot_get(reader_ptr, &session_protocols, sizeof(uint32_t)) ||
+      !appdb_snapshot_get(reader_ptr, &entry_ptr->content_hash, sizeof(uint64_t)))
+  {
+    return false;
+  }
+
+  entry_ptr->terminal = (flags & SNAPSHOT_TERMINAL) != 0;
+  entry_ptr->hidden = (flags & SNAPSHOT_HIDDEN) != 0;
+  entry_ptr->no_display = (flags & SNAPSHOT_NO_DISPLAY) != 0;
+  entry_ptr->session_protocols = session_protocols;
+
+  if (!appdb_snapshot_get_actions(reader_ptr, entry_ptr))
+  {
+    return false;
+  }
+
+  /* derived from exec, same as when the file is parsed */
+  if (entry_ptr->exec != NULL)
+  {
+    entry_ptr->exec_argv = appdb_exec_tokenize(entry_ptr->exec);
+  }
+
+  return true;
+}
+
+/* check that the applications directories are same as when the snapshot was saved */
+static
+bool
+appdb_snapshot_check_dirs(
+  struct appdb_snapshot_reader * reader_ptr)
+{
+  char ** dirs;
+  uint32_t count;
+  uint32_t i;
+  const char * dir;
+  uint32_t len;
+  uint64_t fingerprint;
+  time_t ctime;
+  bool ret;
+
+  dirs = appdb_xdg_data_dirs("/applications");
+  if (dirs == NULL)
+  {
+    return false;
+  }
+
+  ret = false;
+
+  if (!appdb_snapshot_get(reader_ptr, &count, sizeof(uint32_t)))
+  {
+    goto exit;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    if (dirs[i] == NULL)
+    {
+      log_info("Snapshot is for other XDG_DATA_DIRS");
+      goto exit;
+    }
+
+    if (!appdb_snapshot_get_string(reader_ptr, &dir, &len) ||
+        !appdb_snapshot_get(reader_ptr, &fingerprint, sizeof(uint64_t)))
+    {
+      goto exit;
+    }
+
+    if (dir == NULL || strlen(dirs[i]) != len || memcmp(dirs[i], dir, len) != 0)
+    {
+      log_info("Snapshot is for other XDG_DATA_DIRS");
+      goto exit;
+    }
+
+    if (appdb_snapshot_fingerprint(dirs[i], &ctime) != fingerprint)
+    {
+      log_info("'%s' changed since the snapshot was saved", dirs[i]);
+      goto exit;
+    }
+  }
+
+  if (dirs[i] != NULL)
+  {
+    log_info("Snapshot is for other XDG_DATA_DIRS");
+    goto exit;
+  }
+
+  ret = true;
+
+exit:
+  appdb_xdg_dirs_free(dirs);
+  return ret;
+}
+
+bool
+appdb_snapshot_load(
+  struct list_head * appdb,
+  const char * path)
+{
+  int fd;
+  struct stat st;
+  void * map;
+  struct appdb_snapshot_header header;
+  struct appdb_snapshot_reader reader;
+  uint32_t i;
+  bool ret;
+
+  INIT_LIST_HEAD(appdb);
+
+  ret = false;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+  {
+    if (errno == ENOENT)
+    {
+      log_info("No snapshot in '%s'", path);
+    }
+    else
+    {
+      log_error("Failed to open '%s': %s", path, strerror(errno));
+    }
+
+    return false;
+  }
+
+  if (fstat(fd, &st) != 0)
+  {
+    log_error("fstat('%s') failed: %s", path, strerror(errno));
+    goto close_file;
+  }
+
+  if ((size_t)st.st_size < sizeof(struct appdb_snapshot_header))
+  {
+    log_error("Snapshot '%s' is truncated", path);
+    goto close_file;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+  {
+    log_error("mmap('%s') failed: %s", path, strerror(errno));
+    goto close_file;
+  }
+
+  memcpy(&header, map, sizeof(header));
+
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION)
+  {
+    log_info("Snapshot '%s' is of other version", path);
+    goto unmap;
+  }
+
+  reader.data = (const char *)map + sizeof(header);
+  reader.end = (const char *)map + st.st_size;
+
+  if (header.size != (uint64_t)(reader.end - reader.data) ||
+      appdb_digest64(reader.data, header.size, 0) != header.checksum)
+  {
+    log_error("Snapshot '%s' is corrupted", path);
+    goto unmap;
+  }
+
+  if (!appdb_snapshot_check_dirs(&reader))
+  {
+    goto unmap;
+  }
+
+  for (i = 0; i < header.entries_count; i++)
+  {
+    if (!appdb_snapshot_get_entry(&reader, appdb))
+    {
+      log_error("Failed to read entry %u of snapshot '%s'", i, path);
+      appdb_free(appdb);
+      goto unmap;
+    }
+  }
+
+  log_info("Loaded %u entries from snapshot '%s'", header.entries_count, path);
+  ret = true;
+
+unmap:
+  munmap(map, st.st_size);
+close_file:
+  close(fd);
+  return ret;
+}
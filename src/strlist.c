@@ -0,0 +1,123 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ******************************************************************
+ * This file contains implementation of the string list functions *
+ ******************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "strlist.h"
+
+char **
+appdb_strlist_split(
+  const char * value)
+{
+  size_t len;
+  size_t count;
+  const char * src;
+  char ** list;
+  char * strings;
+  char * dst;
+  size_t i;
+
+  /* upper bound of the item count */
+  len = strlen(value);
+  count = 1;
+  for (src = value; *src != 0; src++)
+  {
+    if (*src == ';')
+    {
+      count++;
+    }
+  }
+
+  list = malloc((count + 1) * sizeof(char *) + len + 1);
+  if (list == NULL)
+  {
+    log_error("malloc() failed");
+    return NULL;
+  }
+
+  strings = (char *)(list + count + 1);
+  dst = strings;
+  i = 0;
+
+  for (src = value; ; src++)
+  {
+    if (*src == '\\' && src[1] == ';')
+    {
+      *dst++ = ';';
+      src++;
+      continue;
+    }
+
+    if (*src != ';' && *src != 0)
+    {
+      *dst++ = *src;
+      continue;
+    }
+
+    if (dst > strings)
+    {
+      *dst++ = 0;
+      list[i++] = strings;
+      strings = dst;
+    }
+
+    if (*src == 0)
+    {
+      break;
+    }
+  }
+
+  list[i] = NULL;
+
+  return list;
+}
+
+bool
+appdb_strlist_contains(
+  char ** list,
+  const char * string)
+{
+  if (list == NULL)
+  {
+    return false;
+  }
+
+  for (; *list != NULL; list++)
+  {
+    if (strcmp(*list, string) == 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+size_t
+appdb_strlist_count(
+  char ** list)
+{
+  size_t count;
+
+  count = 0;
+
+  if (list != NULL)
+  {
+    while (list[count] != NULL)
+    {
+      count++;
+    }
+  }
+
+  return count;
+}
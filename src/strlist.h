@@ -0,0 +1,34 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *************************************************************
+ * This file contains interface to the string list functions *
+ *************************************************************/
+
+#ifndef STRLIST_H__6A2F0D93_E1C7_4B58_9F34_B80C5D17A2E6__INCLUDED
+#define STRLIST_H__6A2F0D93_E1C7_4B58_9F34_B80C5D17A2E6__INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* split value of type "string(s)", like "AudioVideo;Audio;", to NULL terminated array */
+/* empty items are skipped, "\;" is unescaped to ";" */
+/* pointers and strings are in one block, to be freed with free() */
+char **
+appdb_strlist_split(
+  const char * value);
+
+bool
+appdb_strlist_contains(
+  char ** list,
+  const char * string);
+
+size_t
+appdb_strlist_count(
+  char ** list);
+
+#endif /* #ifndef STRLIST_H__6A2F0D93_E1C7_4B58_9F34_B80C5D17A2E6__INCLUDED */
@@ -0,0 +1,275 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ **************************************************************
+ * This file contains implementation of the directory watcher *
+ **************************************************************/
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_WATCHER
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "watcher.h"
+
+struct appdb_watch
+{
+  int wd;                       /* -1 for unused slot */
+  char * path;
+  appdb_watch_callback callback;
+  void * ctx;
+};
+
+static int g_inotify_fd = -1;
+
+/* workers add watches while listing $PATH directories, concurrently with the main loop,
+ * so the table is accessed with the mutex held. Watches are removed and callbacks are
+ * called only by the main loop, so path of a slot stays valid while a callback runs. */
+static pthread_mutex_t g_watches_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct appdb_watch * g_watches;
+static size_t g_watches_count;
+
+bool appdb_watcher_init(void)
+{
+  g_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (g_inotify_fd == -1)
+  {
+    log_error("inotify_init1() failed: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+void appdb_watcher_uninit(void)
+{
+  size_t i;
+
+  pthread_mutex_lock(&g_watches_mutex);
+
+  for (i = 0; i < g_watches_count; i++)
+  {
+    free(g_watches[i].path);
+  }
+
+  free(g_watches);
+  g_watches = NULL;
+  g_watches_count = 0;
+
+  pthread_mutex_unlock(&g_watches_mutex);
+
+  if (g_inotify_fd != -1)
+  {
+    close(g_inotify_fd);
+    g_inotify_fd = -1;
+  }
+}
+
+int appdb_watcher_fd(void)
+{
+  return g_inotify_fd;
+}
+
+int
+appdb_watcher_add(
+  const char * path,
+  uint32_t mask,
+  appdb_watch_callback callback,
+  void * ctx)
+{
+  int wd;
+  size_t i;
+  struct appdb_watch * watches;
+  char * path_dup;
+
+  if (g_inotify_fd == -1)
+  {
+    return -1;
+  }
+
+  path_dup = strdup(path);
+  if (path_dup == NULL)
+  {
+    log_error("strdup() failed");
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_watches_mutex);
+
+  /* IN_MASK_ADD, so watching same directory for different purposes does not reduce the mask */
+  wd = inotify_add_watch(g_inotify_fd, path, mask | IN_MASK_ADD | IN_ONLYDIR);
+  if (wd == -1)
+  {
+    log_debug("inotify_add_watch('%s') failed: %s", path, strerror(errno));
+    goto fail;
+  }
+
+  for (i = 0; i < g_watches_count; i++)
+  {
+    if (g_watches[i].wd == -1)
+    {
+      break;
+    }
+  }
+
+  if (i == g_watches_count)
+  {
+    watches = realloc(g_watches, (g_watches_count + 16) * sizeof(struct appdb_watch));
+    if (watches == NULL)
+    {
+      log_error("realloc() failed");
+      goto fail;
+    }
+
+    g_watches = watches;
+    for (; g_watches_count < i + 16; g_watches_count++)
+    {
+      g_watches[g_watches_count].wd = -1;
+      g_watches[g_watches_count].path = NULL;
+    }
+  }
+
+  g_watches[i].wd = wd;
+  g_watches[i].path = path_dup;
+  g_watches[i].callback = callback;
+  g_watches[i].ctx = ctx;
+
+  pthread_mutex_unlock(&g_watches_mutex);
+
+  log_debug("Watching '%s' (%d)", path, (int)i);
+
+  return (int)i;
+
+fail:
+  pthread_mutex_unlock(&g_watches_mutex);
+  free(path_dup);
+  return -1;
+}
+
+void appdb_watcher_remove(int handle)
+{
+  int wd;
+  size_t i;
+
+  pthread_mutex_lock(&g_watches_mutex);
+
+  if (handle < 0 || (size_t)handle >= g_watches_count || g_watches[handle].wd == -1)
+  {
+    goto unlock;
+  }
+
+  wd = g_watches[handle].wd;
+  g_watches[handle].wd = -1;
+  free(g_watches[handle].path);
+  g_watches[handle].path = NULL;
+
+  for (i = 0; i < g_watches_count; i++)
+  {
+    if (g_watches[i].wd == wd)
+    {
+      /* directory is still watched for other purpose */
+      goto unlock;
+    }
+  }
+
+  inotify_rm_watch(g_inotify_fd, wd);
+
+unlock:
+  pthread_mutex_unlock(&g_watches_mutex);
+}
+
+/* copy of slot i, so its callback is called without the mutex held; false past the last slot */
+static
+bool
+appdb_watcher_get(
+  size_t i,
+  struct appdb_watch * watch_ptr)
+{
+  bool ret;
+
+  pthread_mutex_lock(&g_watches_mutex);
+
+  ret = i < g_watches_count;
+  if (ret)
+  {
+    *watch_ptr = g_watches[i];
+  }
+
+  pthread_mutex_unlock(&g_watches_mutex);
+
+  return ret;
+}
+
+void appdb_watcher_dispatch(void)
+{
+  char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event * event_ptr;
+  struct appdb_watch watch;
+  ssize_t size;
+  char * ptr;
+  size_t i;
+
+  if (g_inotify_fd == -1)
+  {
+    return;
+  }
+
+  for (;;)
+  {
+    size = read(g_inotify_fd, buffer, sizeof(buffer));
+    if (size <= 0)
+    {
+      if (size == -1 && errno != EAGAIN && errno != EINTR)
+      {
+        log_error("read() from inotify failed: %s", strerror(errno));
+      }
+
+      return;
+    }
+
+    for (ptr = buffer; ptr < buffer + size; ptr += sizeof(struct inotify_event) + event_ptr->len)
+    {
+      event_ptr = (const struct inotify_event *)ptr;
+
+      if ((event_ptr->mask & IN_Q_OVERFLOW) != 0)
+      {
+        /* events were lost, tell everybody that everything changed */
+        log_warn("inotify queue overflow");
+        for (i = 0; appdb_watcher_get(i, &watch); i++)
+        {
+          if (watch.wd != -1)
+          {
+            watch.callback(watch.ctx, watch.path, NULL, IN_Q_OVERFLOW);
+          }
+        }
+
+        continue;
+      }
+
+      /* callbacks may add or remove watches, so compare wd on each iteration */
+      for (i = 0; appdb_watcher_get(i, &watch); i++)
+      {
+        if (watch.wd == event_ptr->wd)
+        {
+          log_debug(
+            "'%s' event 0x%X for '%s'",
+            watch.path,
+            (unsigned int)event_ptr->mask,
+            event_ptr->len > 0 ? event_ptr->name : "");
+          watch.callback(
+            watch.ctx,
+            watch.path,
+            event_ptr->len > 0 ? event_ptr->name : NULL,
+            event_ptr->mask);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,44 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *********************************************************
+ * This file contains interface to the directory watcher *
+ *********************************************************/
+
+#ifndef WATCHER_H__C81D5E2A_9B74_4F03_A6E8_15F3B0D7C942__INCLUDED
+#define WATCHER_H__C81D5E2A_9B74_4F03_A6E8_15F3B0D7C942__INCLUDED
+
+#include <stdint.h>
+#include <sys/inotify.h>
+
+#include "common.h"
+
+/* name is the name of the file within the watched directory, NULL for events about the directory itself */
+typedef void (* appdb_watch_callback)(void * ctx, const char * path, const char * name, uint32_t mask);
+
+bool appdb_watcher_init(void);
+void appdb_watcher_uninit(void);
+
+/* inotify file descriptor, readable when appdb_watcher_dispatch() has events to process */
+int appdb_watcher_fd(void);
+
+/* watch a directory, mask is set of IN_xxx flags; returns watch handle or -1 on failure */
+/* same directory can be watched more than once, with different callbacks */
+/* can be called from any thread, the other functions only from the main loop */
+int
+appdb_watcher_add(
+  const char * path,
+  uint32_t mask,
+  appdb_watch_callback callback,
+  void * ctx);
+
+void appdb_watcher_remove(int handle);
+
+/* call callbacks for pending events, does not block */
+void appdb_watcher_dispatch(void);
+
+#endif /* #ifndef WATCHER_H__C81D5E2A_9B74_4F03_A6E8_15F3B0D7C942__INCLUDED */
@@ -0,0 +1,305 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ************************************************************************
+ * This file contains implementation of the pool of method call workers *
+ ************************************************************************/
+
+#define _GNU_SOURCE              /* pipe2() */
+
+#define LOG_SUBSYSTEM LOG_SUBSYSTEM_DBUS
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "workers.h"
+#include "db.h"
+
+#define WORKERS_COUNT 4
+#define WORKERS_QUEUE_LIMIT 256  /* calls beyond it are handled by the main loop */
+
+struct appdb_workers_job
+{
+  struct list_head siblings;    /* in g_workers_pending or in g_workers_done */
+  struct cdbus_method_call call;  /* message is referenced, reply is set by the handler */
+  cdbus_method_handler handler;
+  struct appdb_workers_limit * limit_ptr;
+};
+
+static pthread_t g_workers_threads[WORKERS_COUNT];
+static size_t g_workers_count;        /* started threads */
+static int g_workers_wakeup[2] = {-1, -1};
+static pthread_mutex_t g_workers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_workers_cond = PTHREAD_COND_INITIALIZER;
+
+/* protected by the mutex */
+static struct list_head g_workers_pending;
+static size_t g_workers_pending_count;
+static struct list_head g_workers_done;
+static unsigned int g_workers_busy;   /* calls being handled */
+static bool g_workers_quit;
+
+static void appdb_workers_job_free(struct appdb_workers_job * job_ptr)
+{
+  if (job_ptr->call.reply != NULL)
+  {
+    dbus_message_unref(job_ptr->call.reply);
+  }
+
+  dbus_message_unref(job_ptr->call.message);
+  free(job_ptr);
+}
+
+/* oldest pending call whose method is below its limit; called with the mutex held */
+static struct appdb_workers_job * appdb_workers_next(void)
+{
+  struct list_head * node_ptr;
+  struct appdb_workers_job * job_ptr;
+
+  list_for_each(node_ptr, &g_workers_pending)
+  {
+    job_ptr = list_entry(node_ptr, struct appdb_workers_job, siblings);
+
+    if (job_ptr->limit_ptr->running < job_ptr->limit_ptr->max)
+    {
+      list_del(&job_ptr->siblings);
+      g_workers_pending_count--;
+      g_workers_busy++;
+      job_ptr->limit_ptr->running++;
+      return job_ptr;
+    }
+  }
+
+  return NULL;
+}
+
+static void * appdb_workers_thread(void * UNUSED(arg))
+{
+  struct appdb_workers_job * job_ptr;
+
+  pthread_mutex_lock(&g_workers_mutex);
+
+  while (!g_workers_quit)
+  {
+    job_ptr = appdb_workers_next();
+    if (job_ptr == NULL)
+    {
+      pthread_cond_wait(&g_workers_cond, &g_workers_mutex);
+      continue;
+    }
+
+    pthread_mutex_unlock(&g_workers_mutex);
+
+    /* the reply is complete before the lock is released, so it does not reference entries that a reload frees */
+    appdb_db_lock_shared();
+    job_ptr->handler(&job_ptr->call);
+    appdb_db_unlock();
+
+    pthread_mutex_lock(&g_workers_mutex);
+
+    /* this thread takes the next call of the method, if one waits for the limit */
+    job_ptr->limit_ptr->running--;
+    g_workers_busy--;
+    list_add_tail(&job_ptr->siblings, &g_workers_done);
+
+    /* pipe is nonblocking, if it is full the main loop is going to wake up anyway */
+    if (write(g_workers_wakeup[1], "", 1) != 1 && errno != EAGAIN)
+    {
+      log_error("Failed to wake up the main loop: %s", strerror(errno));
+    }
+  }
+
+  pthread_mutex_unlock(&g_workers_mutex);
+
+  return NULL;
+}
+
+static void appdb_workers_free_list(struct list_head * list)
+{
+  struct appdb_workers_job * job_ptr;
+
+  while (!list_empty(list))
+  {
+    job_ptr = list_entry(list->next, struct appdb_workers_job, siblings);
+    list_del(&job_ptr->siblings);
+    appdb_workers_job_free(job_ptr);
+  }
+}
+
+bool appdb_workers_start(void)
+{
+  int ret;
+
+  INIT_LIST_HEAD(&g_workers_pending);
+  INIT_LIST_HEAD(&g_workers_done);
+  g_workers_pending_count = 0;
+  g_workers_busy = 0;
+  g_workers_quit = false;
+
+  if (pipe2(g_workers_wakeup, O_CLOEXEC | O_NONBLOCK) != 0)
+  {
+    log_error("pipe() failed: %s", strerror(errno));
+    return false;
+  }
+
+  for (g_workers_count = 0; g_workers_count < WORKERS_COUNT; g_workers_count++)
+  {
+    ret = pthread_create(&g_workers_threads[g_workers_count], NULL, appdb_workers_thread, NULL);
+    if (ret != 0)
+    {
+      log_error("Failed to start worker thread: %s", strerror(ret));
+      break;
+    }
+  }
+
+  if (g_workers_count == 0)
+  {
+    close(g_workers_wakeup[0]);
+    close(g_workers_wakeup[1]);
+    g_workers_wakeup[0] = -1;
+    g_workers_wakeup[1] = -1;
+    return false;
+  }
+
+  log_info("%zu method call workers started", g_workers_count);
+
+  return true;
+}
+
+void appdb_workers_stop(void)
+{
+  size_t i;
+
+  /* not started */
+  if (g_workers_count == 0)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&g_workers_mutex);
+  g_workers_quit = true;
+  pthread_cond_broadcast(&g_workers_cond);
+  pthread_mutex_unlock(&g_workers_mutex);
+
+  for (i = 0; i < g_workers_count; i++)
+  {
+    pthread_join(g_workers_threads[i], NULL);
+  }
+
+  g_workers_count = 0;
+
+  appdb_workers_free_list(&g_workers_pending);
+  appdb_workers_free_list(&g_workers_done);
+
+  close(g_workers_wakeup[0]);
+  close(g_workers_wakeup[1]);
+  g_workers_wakeup[0] = -1;
+  g_workers_wakeup[1] = -1;
+}
+
+bool appdb_workers_submit(struct cdbus_method_call * call_ptr, cdbus_method_handler handler, struct appdb_workers_limit * limit_ptr)
+{
+  struct appdb_workers_job * job_ptr;
+
+  if (g_workers_count == 0)
+  {
+    return false;
+  }
+
+  job_ptr = malloc(sizeof(struct appdb_workers_job));
+  if (job_ptr == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  job_ptr->call = *call_ptr;
+  job_ptr->call.reply = NULL;
+  job_ptr->handler = handler;
+  job_ptr->limit_ptr = limit_ptr;
+
+  pthread_mutex_lock(&g_workers_mutex);
+
+  if (g_workers_pending_count >= WORKERS_QUEUE_LIMIT)
+  {
+    pthread_mutex_unlock(&g_workers_mutex);
+    log_debug("Worker queue is full, \"%s\" is handled by the main loop", call_ptr->method_name);
+    free(job_ptr);
+    return false;
+  }
+
+  /* method name points into the message */
+  dbus_message_ref(job_ptr->call.message);
+
+  list_add_tail(&job_ptr->siblings, &g_workers_pending);
+  g_workers_pending_count++;
+  pthread_cond_signal(&g_workers_cond);
+
+  pthread_mutex_unlock(&g_workers_mutex);
+
+  return true;
+}
+
+int appdb_workers_fd(void)
+{
+  return g_workers_wakeup[0];
+}
+
+void appdb_workers_dispatch(void)
+{
+  struct list_head done;
+  struct appdb_workers_job * job_ptr;
+  char buffer[64];
+
+  if (g_workers_count == 0)
+  {
+    return;
+  }
+
+  while (read(g_workers_wakeup[0], buffer, sizeof(buffer)) > 0);
+
+  INIT_LIST_HEAD(&done);
+
+  pthread_mutex_lock(&g_workers_mutex);
+  list_splice_init(&g_workers_done, &done);
+  pthread_mutex_unlock(&g_workers_mutex);
+
+  while (!list_empty(&done))
+  {
+    job_ptr = list_entry(done.next, struct appdb_workers_job, siblings);
+    list_del(&job_ptr->siblings);
+
+    /* NULL if the handler ran out of memory, the caller times out then */
+    if (job_ptr->call.reply != NULL &&
+        !dbus_connection_send(job_ptr->call.connection, job_ptr->call.reply, NULL))
+    {
+      log_error("Ran out of memory trying to queue method return");
+    }
+
+    appdb_workers_job_free(job_ptr);
+  }
+}
+
+bool appdb_workers_idle(void)
+{
+  bool idle;
+
+  if (g_workers_count == 0)
+  {
+    return true;
+  }
+
+  pthread_mutex_lock(&g_workers_mutex);
+  idle = g_workers_busy == 0 && list_empty(&g_workers_pending) && list_empty(&g_workers_done);
+  pthread_mutex_unlock(&g_workers_mutex);
+
+  return idle;
+}
@@ -0,0 +1,49 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *******************************************************************
+ * This file contains interface to the pool of method call workers *
+ *******************************************************************/
+
+#ifndef WORKERS_H__E4A81C60_3D2B_4F97_B5C8_07D9F26A13BE__INCLUDED
+#define WORKERS_H__E4A81C60_3D2B_4F97_B5C8_07D9F26A13BE__INCLUDED
+
+#include <cdbus/cdbus.h>
+
+#include "common.h"
+
+/* Method calls that scan much of the database are handled by a small pool of threads, so the
+ * main loop keeps answering the cheap ones meanwhile. Workers hold appdb_db_lock_shared() while
+ * they handle a call, so the database does not change under them. Replies are not sent by the
+ * workers, they are queued and sent by the main loop, in appdb_workers_dispatch(). */
+
+/* calls of one method share a limit, so a burst of them does not occupy all of the workers */
+struct appdb_workers_limit
+{
+  unsigned int max;             /* calls of the method handled at once */
+  unsigned int running;         /* protected by the pool */
+};
+
+bool appdb_workers_start(void);
+
+/* calls that are not handled yet are dropped, without reply */
+void appdb_workers_stop(void);
+
+/* Queue the call to be handled by handler in a worker. If false is returned,
+ * because the pool is not running or its queue is full, the caller handles it. */
+bool appdb_workers_submit(struct cdbus_method_call * call_ptr, cdbus_method_handler handler, struct appdb_workers_limit * limit_ptr);
+
+/* readable when there are replies to be sent, -1 if the pool is not running */
+int appdb_workers_fd(void);
+
+/* send replies of the handled calls, in the main loop */
+void appdb_workers_dispatch(void);
+
+/* true if there are no calls queued or being handled, and no replies to be sent */
+bool appdb_workers_idle(void);
+
+#endif /* #ifndef WORKERS_H__E4A81C60_3D2B_4F97_B5C8_07D9F26A13BE__INCLUDED */
@@ -0,0 +1,167 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ********************************************************************
+ * This file contains implementation of the XDG base directory code *
+ ********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "xdg.h"
+#include "catdup.h"
+
+static
+const char *
+appdb_xdg_get_var(
+  const char * var_name,
+  const char * default_value)
+{
+  const char * value;
+
+  value = getenv(var_name);
+
+  /* Spec says that if variable is "either not set or empty", default should be used */
+  if (value == NULL || strlen(value) == 0)
+  {
+    return default_value;
+  }
+
+  return value;
+}
+
+static
+bool
+appdb_xdg_dirs_append(
+  char *** dirs_ptr,
+  size_t * count_ptr,
+  const char * dir,
+  size_t dir_len,
+  const char * suffix)
+{
+  char ** dirs;
+  char * path;
+  size_t suffix_len;
+
+  suffix_len = strlen(suffix);
+
+  /* "/usr/share/" + "/applications" */
+  while (dir_len > 1 && dir[dir_len - 1] == '/')
+  {
+    dir_len--;
+  }
+
+  path = malloc(dir_len + suffix_len + 1);
+  if (path == NULL)
+  {
+    log_error("malloc() failed");
+    return false;
+  }
+
+  memcpy(path, dir, dir_len);
+  memcpy(path + dir_len, suffix, suffix_len + 1);
+
+  dirs = realloc(*dirs_ptr, (*count_ptr + 2) * sizeof(char *));
+  if (dirs == NULL)
+  {
+    log_error("realloc() failed");
+    free(path);
+    return false;
+  }
+
+  dirs[(*count_ptr)++] = path;
+  dirs[*count_ptr] = NULL;
+  *dirs_ptr = dirs;
+
+  return true;
+}
+
+char **
+appdb_xdg_dirs(
+  const char * home_var,
+  const char * home_default,
+  const char * dirs_var,
+  const char * dirs_default,
+  const char * suffix)
+{
+  char ** dirs;
+  size_t count;
+  const char * home_dir;
+  const char * value;
+  const char * end;
+  char * home;
+
+  dirs = NULL;
+  count = 0;
+
+  value = getenv(home_var);
+  if (value != NULL && *value != 0)
+  {
+    if (!appdb_xdg_dirs_append(&dirs, &count, value, strlen(value), suffix))
+    {
+      goto fail;
+    }
+  }
+  else
+  {
+    home_dir = getenv("HOME");
+    if (home_dir == NULL)
+    {
+      log_error("HOME environment variable is not set.");
+      goto fail;
+    }
+
+    home = catdup(home_dir, home_default);
+    if (home == NULL || !appdb_xdg_dirs_append(&dirs, &count, home, strlen(home), suffix))
+    {
+      free(home);
+      goto fail;
+    }
+
+    free(home);
+  }
+
+  for (value = appdb_xdg_get_var(dirs_var, dirs_default); *value != 0; value = *end != 0 ? end + 1 : end)
+  {
+    end = strchr(value, ':');
+    if (end == NULL)
+    {
+      end = value + strlen(value);
+    }
+
+    if (end > value && !appdb_xdg_dirs_append(&dirs, &count, value, end - value, suffix))
+    {
+      goto fail;
+    }
+  }
+
+  return dirs;
+
+fail:
+  appdb_xdg_dirs_free(dirs);
+  return NULL;
+}
+
+void
+appdb_xdg_dirs_free(
+  char ** dirs)
+{
+  char ** dir_ptr;
+
+  if (dirs == NULL)
+  {
+    return;
+  }
+
+  for (dir_ptr = dirs; *dir_ptr != NULL; dir_ptr++)
+  {
+    free(*dir_ptr);
+  }
+
+  free(dirs);
+}
@@ -0,0 +1,36 @@
+/* -*- Mode: C ; c-basic-offset: 2 -*- */
+/*
+ * appdb - Application database via .desktop files
+ *
+ * Copyright (C) 2023 Nedko Arnaudov
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ ***************************************************************
+ * This file contains interface to the XDG base directory code *
+ ***************************************************************/
+
+#ifndef XDG_H__9D84B1C6_27E0_4A3F_85BD_4E6F0A92C7D1__INCLUDED
+#define XDG_H__9D84B1C6_27E0_4A3F_85BD_4E6F0A92C7D1__INCLUDED
+
+/* NULL terminated list of directories, in order of precedence, each with suffix appended:
+ * $home_var (or $HOME followed by home_default) and then items of $dirs_var (or dirs_default).
+ * Free with appdb_xdg_dirs_free(). */
+char **
+appdb_xdg_dirs(
+  const char * home_var,
+  const char * home_default,
+  const char * dirs_var,
+  const char * dirs_default,
+  const char * suffix);
+
+void
+appdb_xdg_dirs_free(
+  char ** dirs);
+
+#define appdb_xdg_data_dirs(suffix) \
+  appdb_xdg_dirs("XDG_DATA_HOME", "/.local/share", "XDG_DATA_DIRS", "/usr/local/share/:/usr/share/", suffix)
+
+#define appdb_xdg_config_dirs(suffix) \
+  appdb_xdg_dirs("XDG_CONFIG_HOME", "/.config", "XDG_CONFIG_DIRS", "/etc/xdg", suffix)
+
+#endif /* #ifndef XDG_H__9D84B1C6_27E0_4A3F_85BD_4E6F0A92C7D1__INCLUDED */